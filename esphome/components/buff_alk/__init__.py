@@ -0,0 +1,104 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.const import (
+    CONF_ID,
+)
+from esphome import automation
+
+CODEOWNERS = ["@richievos"]
+# shares the pumps (and their libraries) set up by buff_doser
+DEPENDENCIES = ["buff_doser"]
+
+CONF_PH_I2C_ADDRESS = "ph_i2c_address"
+CONF_PH_CALIBRATION = "ph_calibration"
+CONF_LOW = "low"
+CONF_HIGH = "high"
+CONF_READ_PH = "read_ph"
+CONF_ACTUAL_PH = "actual_ph"
+CONF_TANK_WATER_VOLUME = "tank_water_volume"
+CONF_INITIAL_REAGENT_DOSE = "initial_reagent_dose"
+CONF_INCREMENTAL_REAGENT_DOSE = "incremental_reagent_dose"
+CONF_MAX_REAGENT_DOSE = "max_reagent_dose"
+CONF_REAGENT_STRENGTH = "reagent_strength"
+CONF_CALIBRATION_MULTIPLIER = "calibration_multiplier"
+CONF_TITLE = "title"
+
+buff_ns = cg.esphome_ns.namespace('::esphome::buff')
+BuffAlk = buff_ns.class_('BuffAlk', cg.PollingComponent)
+
+PH_CALIBRATION_POINT_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_READ_PH): cv.float_,
+        cv.Required(CONF_ACTUAL_PH): cv.float_,
+    }
+)
+
+CONFIG_SCHEMA = (
+    cv.Schema(
+        {
+            cv.GenerateID(): cv.declare_id(BuffAlk),
+            cv.Optional(CONF_PH_I2C_ADDRESS, default=98): cv.i2c_address,
+            cv.Optional(CONF_PH_CALIBRATION): cv.Schema(
+                {
+                    cv.Required(CONF_LOW): PH_CALIBRATION_POINT_SCHEMA,
+                    cv.Required(CONF_HIGH): PH_CALIBRATION_POINT_SCHEMA,
+                }
+            ),
+            # volumes in ml, defaults match AlkMeasurementConfig
+            cv.Optional(CONF_TANK_WATER_VOLUME, default=200.0): cv.positive_float,
+            cv.Optional(CONF_INITIAL_REAGENT_DOSE, default=4.0): cv.positive_float,
+            cv.Optional(CONF_INCREMENTAL_REAGENT_DOSE, default=0.1): cv.positive_float,
+            cv.Optional(CONF_MAX_REAGENT_DOSE, default=11.0): cv.positive_float,
+            # molarity of the acid
+            cv.Optional(CONF_REAGENT_STRENGTH, default=0.1): cv.positive_float,
+            cv.Optional(CONF_CALIBRATION_MULTIPLIER, default=1.0): cv.positive_float,
+        }
+    )
+    .extend(cv.COMPONENT_SCHEMA)
+    .extend(cv.polling_component_schema("10s"))
+)
+
+
+async def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    await cg.register_component(var, config)
+
+    cg.add(var.set_ph_i2c_address(config[CONF_PH_I2C_ADDRESS]))
+    if CONF_PH_CALIBRATION in config:
+        low = config[CONF_PH_CALIBRATION][CONF_LOW]
+        high = config[CONF_PH_CALIBRATION][CONF_HIGH]
+        cg.add(var.set_ph_low_point(low[CONF_READ_PH], low[CONF_ACTUAL_PH]))
+        cg.add(var.set_ph_high_point(high[CONF_READ_PH], high[CONF_ACTUAL_PH]))
+
+    cg.add(var.set_tank_water_volume(config[CONF_TANK_WATER_VOLUME]))
+    cg.add(var.set_initial_reagent_dose(config[CONF_INITIAL_REAGENT_DOSE]))
+    cg.add(var.set_incremental_reagent_dose(config[CONF_INCREMENTAL_REAGENT_DOSE]))
+    cg.add(var.set_max_reagent_dose(config[CONF_MAX_REAGENT_DOSE]))
+    cg.add(var.set_reagent_strength(config[CONF_REAGENT_STRENGTH]))
+    cg.add(var.set_calibration_multiplier(config[CONF_CALIBRATION_MULTIPLIER]))
+
+
+# Actions
+
+BuffAlkMeasureAction = buff_ns.class_("BuffAlkMeasureAction", automation.Action)
+
+BUFF_ALK_MEASURE_ACTION_SCHEMA = cv.All(
+    {
+        cv.Required(CONF_ID): cv.use_id(BuffAlk),
+        # matched against the sample sources, eg to measure a second tank
+        cv.Optional(CONF_TITLE, default=""): cv.templatable(cv.string),
+    }
+)
+
+
+@automation.register_action(
+    "buff_alk.measure", BuffAlkMeasureAction, BUFF_ALK_MEASURE_ACTION_SCHEMA
+)
+async def buff_alk_measure_to_code(config, action_id, template_arg, args):
+    paren = await cg.get_variable(config[CONF_ID])
+    var = cg.new_Pvariable(action_id, template_arg, paren)
+
+    template_ = await cg.templatable(config[CONF_TITLE], args, cg.std_string)
+    cg.add(var.set_title(template_))
+
+    return var
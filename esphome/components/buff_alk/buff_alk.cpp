@@ -0,0 +1,195 @@
+#include "buff_alk.h"
+
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+
+#include "esphome/components/buff_doser/buff_doser.h"
+#include "robotank/ph-robotank-sensor.h"
+
+namespace esphome {
+namespace buff {
+
+static const char *const TAG = "buff-alk";
+
+// Same core as ESPHome's loop task, so the busy-waiting steppers only ever
+// share time with it rather than starving the radio on core 0.
+static const BaseType_t MEASUREMENT_CORE = 1;
+static const uint32_t MEASUREMENT_TASK_STACK = 8192;
+static const TickType_t MEASUREMENT_TASK_DELAY = pdMS_TO_TICKS(10);
+
+static const float ALK_TARGET_PH = 4.5;
+static const unsigned long PH_READ_INTERVAL_MS = 500;
+
+// Results come back through the step results rather than a publisher, this
+// just satisfies AlkMeasurer
+class NullPublisher : public ::buff::mqtt::Publisher {
+   public:
+    void publishPH(const ::buff::ph::PHReading &phReading) override {}
+    void publishAlkReading(const ::buff::alk_measure::AlkReading &alkReading) override {}
+    void publishMeasurementTrace(const ::buff::alk_measure::AlkReading &alkReading, const ::buff::alk_measure::MeasurementTrace &trace) override {}
+    void publishMeasureAlk(const std::string &title, const unsigned long asOfMS) override {}
+    void publishCalibratePH(const float actualPH, const unsigned long asOfMS) override {}
+    void publishPHCalibration(const ::buff::ph::PHCalibrator &calibrator) override {}
+};
+
+static const std::shared_ptr<::buff::mqtt::Publisher> null_publisher = std::make_shared<NullPublisher>();
+static const std::shared_ptr<::buff::buff_time::TimeWrapper> time_wrapper = std::make_shared<::buff::buff_time::TimeWrapper>();
+
+void BuffAlk::dump_config() {
+    ESP_LOGCONFIG(TAG, "Buff-Alk:");
+    ESP_LOGCONFIG(TAG, "  pH I2C address: %u", this->ph_i2c_address_);
+    ESP_LOGCONFIG(TAG, "  tank water volume: %.1fml", this->alk_measure_conf_.measurementTankWaterVolumeML);
+    ESP_LOGCONFIG(TAG, "  reagent strength: %.3fM", this->alk_measure_conf_.reagentStrengthMoles);
+    LOG_UPDATE_INTERVAL(this);
+}
+
+void BuffAlk::setup() {
+    ::buff::sensors::setupI2CBuses(::buff::inputs::PIN_CONFIG.I2C_SDA, ::buff::inputs::PIN_CONFIG.I2C_SCL);
+    this->sensor_registry_ = std::make_shared<::buff::sensors::SensorRegistry>();
+    this->sensor_registry_->add(std::make_shared<::buff::robotank::RoboTankPHSensor>(this->ph_i2c_address_), PH_READ_INTERVAL_MS);
+
+    const ::buff::ph::PHReadConfig ph_read_config = {
+        .readIntervalMS = ALK_STEP_INTERVAL_MS,
+        .phReadFunc = this->sensor_registry_->latestValueFunc(::buff::sensors::PH)};
+    this->ph_calibrator_ = std::make_shared<::buff::ph::PHCalibrator>(this->ph_low_point_, this->ph_high_point_);
+    this->ph_reader_ = std::make_shared<::buff::ph::controller::PHReader>(ph_read_config, *this->ph_calibrator_);
+
+    this->alk_measurer_ = std::make_shared<::buff::alk_measure::AlkMeasurer>(shared_buff_dosers(), this->alk_measure_conf_, this->ph_reader_);
+
+    if (xTaskCreatePinnedToCore(measurement_task_, "BuffAlk", MEASUREMENT_TASK_STACK, this, 1, nullptr, MEASUREMENT_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the measurement task");
+        this->mark_failed();
+    }
+}
+
+void BuffAlk::update() {
+#ifdef USE_SENSOR
+    if (this->ph_ && this->sensor_registry_->hasReading(::buff::sensors::PH)) {
+        const float raw_ph = this->sensor_registry_->find(::buff::sensors::PH)->lastValue();
+        this->ph_->publish_state(this->ph_calibrator_->convert(raw_ph));
+    }
+#endif
+}
+
+void BuffAlk::loop() {
+    this->sensor_registry_->loop(time_wrapper->getMonotonicMS());
+
+    AlkMeasureProgress progress;
+    while (this->progress_queue_.tryPop(progress)) {
+        this->publish_progress_(progress);
+    }
+}
+
+void BuffAlk::measure(const std::string &title) {
+    AlkMeasureRequest request;
+    if (!::buff::concurrency::copyBounded(request.title, title.c_str(), title.size())) {
+        ESP_LOGW(TAG, "Title too long: %s", title.c_str());
+        return;
+    }
+    if (!this->requests_.tryPush(request)) {
+        ESP_LOGW(TAG, "Too many pending measurements, ignoring %s", title.c_str());
+    }
+}
+
+/*******************************
+ * Measurement task
+ *******************************/
+void BuffAlk::measurement_task_(void *arg) {
+    auto *self = static_cast<BuffAlk *>(arg);
+    while (true) {
+        self->loop_measurement_();
+        vTaskDelay(MEASUREMENT_TASK_DELAY);
+    }
+}
+
+void BuffAlk::loop_measurement_() {
+    if (this->looper_ == nullptr) {
+        AlkMeasureRequest request;
+        if (!this->requests_.tryPop(request)) {
+            return;
+        }
+        ESP_LOGI(TAG, "Starting measurement title=%s", request.title);
+        this->start_ph_ = NAN;
+        this->looper_ = ::buff::alk_measure::beginAlkMeasureLoop<ALK_PH_MAVG_LENGTH>(
+            this->alk_measurer_, null_publisher, time_wrapper, this->alk_measure_conf_, request.title);
+        this->send_progress_(this->looper_->getLastStepResult());
+        return;
+    }
+
+    if (!this->looper_->getLastStepResult().nextStepDue(time_wrapper->getMonotonicMS(), ALK_STEP_INTERVAL_MS)) {
+        return;
+    }
+
+    const auto prev_action = this->looper_->getLastStepResult().nextAction;
+    const auto &result = this->looper_->nextStep();
+    this->send_progress_(result);
+
+    if (result.nextAction == ::buff::alk_measure::MEASURE_DONE) {
+        if (prev_action == ::buff::alk_measure::CLEANUP) {
+            ESP_LOGI(TAG, "Measured alk=%.2fdKH", result.alkReading.alkReadingDKH);
+        }
+        this->looper_.reset();
+    }
+}
+
+void BuffAlk::send_progress_(const ::buff::alk_measure::MeasurementStepResult<ALK_PH_MAVG_LENGTH> &result) {
+    AlkMeasureProgress progress{
+        .action = result.nextAction,
+        .progress_percent = 0,
+        .reagent_volume_ml = result.alkReading.reagentVolumeML,
+        .calibrated_ph = result.alkReading.phReading.calibratedPH_mavg,
+        .alk_reading_dkh = result.alkReading.alkReadingDKH,
+        .has_result = false};
+
+    // rough, by phase, with the titration itself going by how far the pH has
+    // dropped towards the endpoint
+    switch (result.nextAction) {
+        case ::buff::alk_measure::PRIME:
+            progress.progress_percent = 0;
+            break;
+        case ::buff::alk_measure::CLEAN_AND_FILL:
+            progress.progress_percent = 10;
+            break;
+        case ::buff::alk_measure::MEASURE: {
+            const float ph = result.alkReading.phReading.calibratedPH_mavg;
+            if (std::isnan(this->start_ph_) && ph > ALK_TARGET_PH) {
+                this->start_ph_ = ph;
+            }
+            float titrated = 0;
+            if (!std::isnan(this->start_ph_) && this->start_ph_ > ALK_TARGET_PH) {
+                titrated = (this->start_ph_ - ph) / (this->start_ph_ - ALK_TARGET_PH);
+            }
+            progress.progress_percent = 20 + 70 * std::min(1.0f, std::max(0.0f, titrated));
+            break;
+        }
+        case ::buff::alk_measure::CLEANUP:
+            progress.progress_percent = 90;
+            // the reading is final once it's handed to cleanup
+            progress.has_result = true;
+            break;
+        case ::buff::alk_measure::ABORT_CLEANUP:
+            progress.progress_percent = 90;
+            break;
+        case ::buff::alk_measure::MEASURE_DONE:
+            progress.progress_percent = 100;
+            break;
+    }
+
+    if (!this->progress_queue_.tryPush(progress)) {
+        // loop() has fallen behind, the next step's progress supersedes this one
+        ESP_LOGD(TAG, "Progress queue full");
+    }
+}
+
+void BuffAlk::publish_progress_(const AlkMeasureProgress &progress) {
+#ifdef USE_SENSOR
+    if (this->progress_) this->progress_->publish_state(progress.progress_percent);
+    if (this->alkalinity_ && progress.has_result) this->alkalinity_->publish_state(progress.alk_reading_dkh);
+#endif
+#ifdef USE_TEXT_SENSOR
+    if (this->phase_) this->phase_->publish_state(::buff::alk_measure::MEASUREMENT_ACTION_TO_NAME.at(progress.action));
+#endif
+}
+
+}  // namespace buff
+}  // namespace esphome
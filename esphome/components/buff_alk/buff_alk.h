@@ -0,0 +1,141 @@
+#pragma once
+
+#include "esphome/core/automation.h"
+#include "esphome/core/component.h"
+#include "esphome/core/defines.h"
+
+#ifdef USE_SENSOR
+#include "esphome/components/sensor/sensor.h"
+#endif
+
+#ifdef USE_TEXT_SENSOR
+#include "esphome/components/text_sensor/text_sensor.h"
+#endif
+
+#include <memory>
+#include <string>
+
+#include "concurrency/rings.h"
+#include "concurrency/task-messages.h"
+#include "readings/alk-measure.h"
+#include "readings/ph-controller.h"
+#include "sensors/sensor-registry.h"
+
+namespace esphome {
+namespace buff {
+
+const size_t ALK_PH_MAVG_LENGTH = 30;
+const unsigned long ALK_STEP_INTERVAL_MS = 1000;
+
+struct AlkMeasureRequest {
+    char title[32];
+};
+
+// sent by the measurement task after every step
+struct AlkMeasureProgress {
+    ::buff::alk_measure::MeasurementAction action;
+    float progress_percent;
+    float reagent_volume_ml;
+    float calibrated_ph;
+    float alk_reading_dkh;
+    // alk_reading_dkh is the published result, not a running estimate
+    bool has_result;
+};
+
+/*******************************
+ * BuffAlk
+ * Runs the alk titration from ESPHome. AlkMeasurer's steps dose synchronously
+ * (a drain/fill can take a minute), so measurements run on their own task
+ * pinned next to ESPHome's loop task. loop() only hands over requests and
+ * publishes whatever progress has come back, so it never blocks.
+ *
+ * The pH probe is read split-phase from loop() through a SensorRegistry, the
+ * measurement task only ever picks up the latest value.
+ *******************************/
+class BuffAlk : public PollingComponent {
+   public:
+    void dump_config() override;
+    float get_setup_priority() const override { return setup_priority::DATA; };
+
+    void setup() override;
+    void loop() override;
+    void update() override;
+
+    void set_ph_i2c_address(uint8_t ph_i2c_address) { ph_i2c_address_ = ph_i2c_address; }
+    void set_ph_low_point(float read_ph, float actual_ph) { ph_low_point_ = {.actualPH = actual_ph, .readPH = read_ph}; }
+    void set_ph_high_point(float read_ph, float actual_ph) { ph_high_point_ = {.actualPH = actual_ph, .readPH = read_ph}; }
+
+    void set_tank_water_volume(float volume_ml) { alk_measure_conf_.measurementTankWaterVolumeML = volume_ml; }
+    void set_initial_reagent_dose(float volume_ml) { alk_measure_conf_.initialReagentDoseVolumeML = volume_ml; }
+    void set_incremental_reagent_dose(float volume_ml) { alk_measure_conf_.incrementalReagentDoseVolumeML = volume_ml; }
+    void set_max_reagent_dose(float volume_ml) { alk_measure_conf_.maxReagentDoseML = volume_ml; }
+    void set_reagent_strength(float moles) { alk_measure_conf_.reagentStrengthMoles = moles; }
+    void set_calibration_multiplier(float multiplier) { alk_measure_conf_.calibrationMultiplier = multiplier; }
+
+#ifdef USE_SENSOR
+    void set_alkalinity(sensor::Sensor *alkalinity) { alkalinity_ = alkalinity; }
+    void set_ph(sensor::Sensor *ph) { ph_ = ph; }
+    void set_progress(sensor::Sensor *progress) { progress_ = progress; }
+#endif
+
+#ifdef USE_TEXT_SENSOR
+    void set_phase(text_sensor::TextSensor *phase) { phase_ = phase; }
+#endif
+
+    // Action
+    void measure(const std::string &title);
+
+   protected:
+    static const size_t REQUEST_QUEUE_DEPTH = 4;
+    static const size_t PROGRESS_QUEUE_DEPTH = 16;
+
+    static void measurement_task_(void *arg);
+    void loop_measurement_();
+    void send_progress_(const ::buff::alk_measure::MeasurementStepResult<ALK_PH_MAVG_LENGTH> &result);
+    void publish_progress_(const AlkMeasureProgress &progress);
+
+    uint8_t ph_i2c_address_ = 98;
+    ::buff::ph::PHCalibrator::CalibrationPoint ph_low_point_ = {.actualPH = 4.0, .readPH = 4.0};
+    ::buff::ph::PHCalibrator::CalibrationPoint ph_high_point_ = {.actualPH = 7.0, .readPH = 7.0};
+    ::buff::alk_measure::AlkMeasurementConfig alk_measure_conf_;
+
+    std::shared_ptr<::buff::sensors::SensorRegistry> sensor_registry_ = nullptr;
+    std::shared_ptr<::buff::ph::PHCalibrator> ph_calibrator_ = nullptr;
+    std::shared_ptr<::buff::ph::controller::PHReader> ph_reader_ = nullptr;
+    std::shared_ptr<::buff::alk_measure::AlkMeasurer> alk_measurer_ = nullptr;
+
+    // ESPHome loop -> measurement task
+    ::buff::concurrency::SPSCRing<AlkMeasureRequest, REQUEST_QUEUE_DEPTH> requests_;
+    // measurement task -> ESPHome loop
+    ::buff::concurrency::SPSCRing<AlkMeasureProgress, PROGRESS_QUEUE_DEPTH> progress_queue_;
+
+    // only touched by the measurement task
+    std::unique_ptr<::buff::alk_measure::AlkMeasureLooper<ALK_PH_MAVG_LENGTH>> looper_ = nullptr;
+    float start_ph_ = NAN;
+
+#ifdef USE_SENSOR
+    sensor::Sensor *alkalinity_{nullptr};
+    sensor::Sensor *ph_{nullptr};
+    sensor::Sensor *progress_{nullptr};
+#endif
+
+#ifdef USE_TEXT_SENSOR
+    text_sensor::TextSensor *phase_{nullptr};
+#endif
+};
+
+// Action Templates
+template <typename... Ts>
+class BuffAlkMeasureAction : public Action<Ts...> {
+   public:
+    BuffAlkMeasureAction(BuffAlk *buff_alk) : buff_alk_(buff_alk) {}
+
+    void play(Ts... x) override { this->buff_alk_->measure(this->title_.value(x...)); }
+    TEMPLATABLE_VALUE(std::string, title)
+
+   protected:
+    BuffAlk *buff_alk_;
+};
+
+}  // namespace buff
+}  // namespace esphome
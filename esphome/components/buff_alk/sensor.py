@@ -0,0 +1,65 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import sensor
+from esphome.const import (
+    ENTITY_CATEGORY_NONE,
+    DEVICE_CLASS_EMPTY,
+    STATE_CLASS_MEASUREMENT,
+    CONF_ID,
+    UNIT_PERCENT,
+)
+
+from . import BuffAlk
+
+
+DEPENDENCIES = ["buff_alk"]
+
+CONF_ALKALINITY = "alkalinity"
+CONF_PH = "ph"
+CONF_PROGRESS = "progress"
+
+UNIT_DKH = "dKH"
+UNIT_PH = "pH"
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.use_id(BuffAlk),
+        cv.Optional(CONF_ALKALINITY): sensor.sensor_schema(
+            unit_of_measurement=UNIT_DKH,
+            accuracy_decimals=2,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_NONE,
+        ),
+        cv.Optional(CONF_PH): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PH,
+            accuracy_decimals=2,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_NONE,
+        ),
+        cv.Optional(CONF_PROGRESS): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            accuracy_decimals=0,
+            device_class=DEVICE_CLASS_EMPTY,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_NONE,
+        ),
+    }
+)
+
+
+async def to_code(config):
+    parent = await cg.get_variable(config[CONF_ID])
+
+    if CONF_ALKALINITY in config:
+        sens = await sensor.new_sensor(config[CONF_ALKALINITY])
+        cg.add(parent.set_alkalinity(sens))
+
+    if CONF_PH in config:
+        sens = await sensor.new_sensor(config[CONF_PH])
+        cg.add(parent.set_ph(sens))
+
+    if CONF_PROGRESS in config:
+        sens = await sensor.new_sensor(config[CONF_PROGRESS])
+        cg.add(parent.set_progress(sens))
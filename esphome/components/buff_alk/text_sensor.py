@@ -0,0 +1,30 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import text_sensor
+from esphome.const import (
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    CONF_ID,
+)
+
+from . import BuffAlk
+
+DEPENDENCIES = ["buff_alk"]
+
+CONF_PHASE = "phase"
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.use_id(BuffAlk),
+        cv.Optional(CONF_PHASE): text_sensor.text_sensor_schema(
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+    }
+)
+
+
+async def to_code(config):
+    parent = await cg.get_variable(config[CONF_ID])
+
+    if CONF_PHASE in config:
+        sens = await text_sensor.new_text_sensor(config[CONF_PHASE])
+        cg.add(parent.set_phase(sens))
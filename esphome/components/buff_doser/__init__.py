@@ -14,6 +14,10 @@ DEPENDENCIES = []
 MULTI_CONF = True
 
 CONF_VOLUME_PER_MINUTE = "volume_per_minute"
+CONF_DOSER_TYPE = "doser_type"
+CONF_PERSIST_INTERVAL_VOLUME = "persist_interval_volume"
+# matches MEASUREMENT_DOSER_TYPE_NAME_TO_MEASUREMENT_DOSER
+DOSER_TYPES = ["fill", "drain", "reagent"]
 
 buff_ns = cg.esphome_ns.namespace('::esphome::buff')
 BuffDoser = buff_ns.class_('BuffDoser', cg.Component)
@@ -117,6 +121,11 @@ CONFIG_SCHEMA = (
     cv.Schema(
         {
             cv.GenerateID(): cv.declare_id(BuffDoser),
+            cv.Optional(CONF_DOSER_TYPE, default="reagent"): cv.one_of(
+                *DOSER_TYPES, lower=True
+            ),
+            # dosing totals are saved to flash when a dose finishes, or after this many ml
+            cv.Optional(CONF_PERSIST_INTERVAL_VOLUME, default=5.0): cv.positive_float,
         }
     )
     .extend(cv.COMPONENT_SCHEMA)
@@ -127,6 +136,8 @@ CONFIG_SCHEMA = (
 async def to_code(config):
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
+    cg.add(var.set_doser_type(config[CONF_DOSER_TYPE]))
+    cg.add(var.set_persist_interval_volume(config[CONF_PERSIST_INTERVAL_VOLUME]))
 
 
 BUFF_DOSER_NO_ARGS_ACTION_SCHEMA = maybe_simple_id(
@@ -14,208 +14,441 @@ static const std::string DOSING_MODE_VOLUME_OVER_TIME = "Volume/Time";
 static const std::string DOSING_MODE_CONSTANT_FLOW_RATE = "Constant Flow Rate";
 static const std::string DOSING_MODE_CONTINUOUS = "Continuous";
 
+static const std::string CALIBRATION_STATUS_UNCALIBRATED = "Uncalibrated";
+static const std::string CALIBRATION_STATUS_FIXED_VOLUME = "Fixed Volume";
+
+/*******************************
+ * Shared dosers
+ * Every buff_doser instance drives a pump on the same board, so the steppers
+ * (and the shared enable pin) are set up once and handed out by doser type.
+ *******************************/
+std::shared_ptr<::buff::doser::BuffDosers> shared_buff_dosers() {
+    static std::shared_ptr<::buff::doser::BuffDosers> buff_dosers = nullptr;
+    if (buff_dosers != nullptr) {
+        return buff_dosers;
+    }
+
+    const auto &pins = ::buff::inputs::PIN_CONFIG;
+    const std::map<::buff::MeasurementDoserType, std::shared_ptr<AccelStepper>> steppers = {
+        {::buff::FILL, std::make_shared<AccelStepper>(AccelStepper::DRIVER, pins.FILL_WATER_STEP_PIN, pins.FILL_WATER_DIR_PIN)},
+        {::buff::REAGENT, std::make_shared<AccelStepper>(AccelStepper::DRIVER, pins.REAGENT_STEP_PIN, pins.REAGENT_DIR_PIN)},
+        {::buff::DRAIN, std::make_shared<AccelStepper>(AccelStepper::DRIVER, pins.DRAIN_WATER_STEP_PIN, pins.DRAIN_WATER_DIR_PIN)},
+    };
+    const std::map<::buff::MeasurementDoserType, std::shared_ptr<::buff::doser::Doser>> dosers = {
+        {::buff::FILL, std::make_shared<::buff::doser::AccelStepperDoser>(::buff::inputs::fillDoserConfig, steppers.at(::buff::FILL))},
+        {::buff::REAGENT, std::make_shared<::buff::doser::AccelStepperDoser>(::buff::inputs::reagentDoserConfig, steppers.at(::buff::REAGENT))},
+        {::buff::DRAIN, std::make_shared<::buff::doser::AccelStepperDoser>(::buff::inputs::drainDoserConfig, steppers.at(::buff::DRAIN))},
+    };
+
+#ifdef BOARD_MKS_DLC32
+    setup_mks();
+#endif
+    buff_dosers = ::buff::doser::setupDosers(pins.STEPPER_DISABLE_PIN, dosers, steppers);
+    return buff_dosers;
+}
+
 void BuffDoser::dump_config() {
+    ESP_LOGCONFIG(TAG, "Buff-Doser:");
     if (this->is_failed()) {
         ESP_LOGE(TAG, "Communication with Buff-Doser circuit failed!");
     }
+    if (this->doser_ != nullptr) {
+        ESP_LOGCONFIG(TAG, "  ml per rotation: %.3f", this->doser_->calibrator->getMlPerFullRotation());
+        ESP_LOGCONFIG(TAG, "  motor RPM: %d", this->doser_->config.motorRPM);
+    }
     LOG_UPDATE_INTERVAL(this);
 }
 
 void BuffDoser::setup() {
-    Serial.begin(115200);
-    Wire.begin(inputs::PIN_CONFIG.I2C_SDA, inputs::PIN_CONFIG.I2C_SCL);
-
-    _buffDosers = std::move(doser::setupDosers(inputs::PIN_CONFIG.STEPPER_DISABLE_PIN, inputs::doserInstances, inputs::doserSteppers));
-    // TODO: make this configurable
-    setupPH_RoboTankPHBoard();
+    this->buff_dosers_ = shared_buff_dosers();
+    this->doser_ = this->buff_dosers_->selectDoser(this->doser_type_);
+    this->executor_ = std::make_unique<::buff::doser::DoseExecutor>(this->doser_);
 
-    // trigger a NTP refresh
-    _ntpClient = std::move(ntp::setupNTP());
-    _timeClient = std::make_shared<ntp::NTPTimeWrapper>(_ntpClient);
+    // one slot per doser type, so multiple instances don't share totals
+    this->pref_ = global_preferences->make_preference<BuffDoserState>(fnv1_hash("buff_doser_" + this->doser_type_name_));
+    this->load_state_();
 
-    // controller::setupController(mqttBroker, mqttClient, buffDosers, phReader, inputs::alkMeasureConf, publisher, timeClient);
-      // monitoring_display::setupDisplay(readingStore, publisher);
-
-
-    // if (this->is_waiting_) {
-    //   return;
-    // }
+    this->publish_volumes_();
+    this->publish_calibration_();
 }
 
 void BuffDoser::update() {
-    // if (this->is_waiting_) {
-    //   return;
-    // }
+    this->publish_dosing_();
+    this->publish_volumes_();
 }
 
-void BuffDoser::loop() {
-    auto phReadingPtr = phReader->readNewPHSignalIfTimeAndUpdate<STANDARD_PH_MAVG_LENGTH>(phReadingStats);
-    if (phReadingPtr != nullptr) {
-        phReadingPtr->asOfAdjustedSec = timeClient->getAdjustedTimeSeconds();
-        // publisher->publishPH(*phReadingPtr);
+void BuffDoser::on_shutdown() {
+    this->account_dosed_();
+    if (this->state_dirty_) {
+        this->save_state_();
     }
+}
 
-    ntp::loopNTP(_ntpClient);
+void BuffDoser::loop() {
+    // everything is applied straight away, so one command per loop keeps it short
+    QueueableCommand command;
+    if (this->queue_.tryPop(command)) {
+        this->handle_command_(command);
+    }
 
-    // controller::loopController();
-        // monitoring_display::loopDisplay();
+    if (this->pending_ml_per_rotation_ > 0 && this->replace_calibrator_(this->pending_ml_per_rotation_)) {
+        this->pending_ml_per_rotation_ = 0;
+        this->publish_calibration_();
+    }
 
+    if (!this->executor_->active()) {
+        return;
+    }
 
-    // TODO: this all is not thread safe
-    auto current_command = this->current_command_;
-    if (this->current_command_.command == Command::None) {
-        if (!this->queue_.empty()) {
-            current_command = this->queue_.front();
-            this->queue_.pop();
-            this->current_command_ = current_command;
-        }
+    // step until the dose is waiting on its next chunk, or the budget is used up
+    const uint32_t started_us = micros();
+    bool active;
+    do {
+        active = this->executor_->loop(millis());
+    } while (active && this->executor_->stepping() && micros() - started_us < STEP_BUDGET_US);
+
+    const uint32_t now = millis();
+    if (!active) {
+        this->finish_dosing_();
+    } else if (now - this->last_progress_publish_ms_ >= PROGRESS_PUBLISH_INTERVAL_MS) {
+        this->last_progress_publish_ms_ = now;
+        this->account_dosed_();
+        this->publish_volumes_();
     }
+}
 
-    switch (current_command.command) {
+void BuffDoser::handle_command_(const QueueableCommand &command) {
+    const uint32_t now = millis();
+    // a new dose replaces the current one, count what that got out first
+    this->account_dosed_();
+
+    switch (command.command) {
         case Command::ClearCalibration:
-            ESP_LOGI("Command", "Received ClearCalibration command");
+            if (!this->replace_calibrator_(this->doser_->config.mlPerFullRotation)) {
+                ESP_LOGW(TAG, "Alk measurement running, ignoring calibration change");
+                break;
+            }
+            ESP_LOGI(TAG, "Clearing calibration");
+            this->pending_ml_per_rotation_ = 0;
+            this->is_calibrated_flag_ = false;
+            this->save_state_();
             break;
 
         case Command::ClearTotalVolumeDosed:
-            ESP_LOGI("Command", "Received ClearTotalVolumeDosed command");
+            ESP_LOGI(TAG, "Clearing total volume dosed");
+            this->account_dosed_();
+            this->total_volume_dosed_ml_ = 0;
+            this->save_state_();
             break;
 
         case Command::DoseContinuously:
-            ESP_LOGI("Command", "Received DoseContinuously command");
+            if (!this->hold_dosers_()) break;
+            ESP_LOGI(TAG, "Dosing continuously");
+            this->last_volume_requested_ml_ = 0;
+            this->executor_->doseContinuously(now);
+            this->start_dosing_();
+#ifdef USE_TEXT_SENSOR
+            if (this->dosing_mode_) this->dosing_mode_->publish_state(DOSING_MODE_CONTINUOUS);
+#endif
             break;
 
         case Command::DoseVolume:
-            ESP_LOGI("Command", "Received DoseVolume command");
+            if (!this->hold_dosers_()) break;
+            ESP_LOGI(TAG, "Dosing volume=%.2fml", command.volume);
+            this->last_volume_requested_ml_ = command.volume;
+            this->executor_->doseVolume(command.volume, now);
+            this->start_dosing_();
+#ifdef USE_TEXT_SENSOR
+            if (this->dosing_mode_) this->dosing_mode_->publish_state(DOSING_MODE_VOLUME);
+#endif
             break;
 
         case Command::DoseVolumeOverTime:
-            ESP_LOGI("Command", "Received DoseVolumeOverTime command");
+            if (!this->hold_dosers_()) break;
+            ESP_LOGI(TAG, "Dosing volume=%.2fml over duration=%dmin", command.volume, command.duration);
+            this->last_volume_requested_ml_ = command.volume;
+            this->executor_->doseVolumeOverTime(command.volume, command.duration * 60000UL, now);
+            this->start_dosing_();
+#ifdef USE_TEXT_SENSOR
+            if (this->dosing_mode_) this->dosing_mode_->publish_state(DOSING_MODE_VOLUME_OVER_TIME);
+#endif
             break;
 
         case Command::DoseWithConstantFlowRate:
-            ESP_LOGI("Command", "Received DoseWithConstantFlowRate command");
+            if (!this->hold_dosers_()) break;
+            ESP_LOGI(TAG, "Dosing rate=%.2fml/min for duration=%dmin", command.volume, command.duration);
+            this->executor_->doseConstantFlowRate(command.volume, command.duration * 60000UL, now);
+            this->last_volume_requested_ml_ = this->executor_->requestedML();
+            this->start_dosing_();
+#ifdef USE_TEXT_SENSOR
+            if (this->dosing_mode_) this->dosing_mode_->publish_state(DOSING_MODE_CONSTANT_FLOW_RATE);
+#endif
             break;
 
         case Command::None:
-            ESP_LOGD("Command", "Received None command");
             break;
 
         case Command::PauseDosing:
-            ESP_LOGI("Command", "Received PauseDosing command");
+            // toggles, like the EZO-PMP
+            if (this->executor_->paused()) {
+                ESP_LOGI(TAG, "Resuming dosing");
+                this->executor_->resume(now);
+                this->high_freq_.start();
+            } else if (this->executor_->active()) {
+                ESP_LOGI(TAG, "Pausing dosing");
+                this->executor_->pause(now);
+                this->account_dosed_();
+                this->high_freq_.stop();
+            }
+            this->is_paused_flag_ = this->executor_->paused();
             break;
 
-        case Command::ReadAbsoluteTotalVolumeDosed:
-            ESP_LOGI("Command", "Received ReadAbsoluteTotalVolumeDosed command");
+        case Command::StopDosing:
+            ESP_LOGI(TAG, "Stopping dosing");
+            this->executor_->stop();
+            this->finish_dosing_();
             break;
 
-        case Command::ReadCalibrationStatus:
-            ESP_LOGI("Command", "Received ReadCalibrationStatus command");
+        case Command::SetCalibrationVolume:
+            // volume is what actually came out of the last fixed volume dose
+            if (this->last_volume_requested_ml_ <= 0 || command.volume <= 0) {
+                ESP_LOGW(TAG, "Calibrating needs a volume dose first, then the volume that came out");
+                break;
+            }
+            {
+                const float ml_per_rotation = this->doser_->calibrator->getMlPerFullRotation() * command.volume / this->last_volume_requested_ml_;
+                if (!this->replace_calibrator_(ml_per_rotation)) {
+                    ESP_LOGW(TAG, "Alk measurement running, ignoring calibration change");
+                    break;
+                }
+                ESP_LOGI(TAG, "Calibrating ml per rotation=%.4f", ml_per_rotation);
+                this->pending_ml_per_rotation_ = 0;
+                this->is_calibrated_flag_ = true;
+                this->save_state_();
+            }
             break;
 
         case Command::ReadDosing:
-            ESP_LOGI("Command", "Received ReadDosing command");
+            this->publish_dosing_();
+            break;
 
-            // TODO: this logic is weird
-            // if (parsed_third_parameter.has_value())
-            //   this->is_dosing_flag_ = parsed_third_parameter.value_or(0) == 1;
-#ifdef USE_BINARY_SENSOR
-            if (this->is_dosing_)
-                this->is_dosing_->publish_state(this->is_dosing_flag_);
-#endif
-#ifdef USE_SENSOR
-            // TODO:
-            float last_volume_requested = 0.0f;
-            this->last_volume_requested_->publish_state(last_volume_requested);
-#endif
-#ifdef USE_TEXT_SENSOR
-            if (!this->is_dosing_flag_ && !this->is_paused_flag_) {
-                // If pump is not paused and not dispensing
-                if (this->dosing_mode_ && this->dosing_mode_->state != DOSING_MODE_NONE)
-                    this->dosing_mode_->publish_state(DOSING_MODE_NONE);
-            }
-#endif
+        case Command::ReadAbsoluteTotalVolumeDosed:
+        case Command::ReadTotalVolumeDosed:
+            this->account_dosed_();
+            this->publish_volumes_();
             break;
 
+        case Command::ReadCalibrationStatus:
         case Command::ReadMaxFlowRate:
-            ESP_LOGI("Command", "Received ReadMaxFlowRate command");
+            this->publish_calibration_();
             break;
 
         case Command::ReadPauseStatus:
-            ESP_LOGI("Command", "Received ReadPauseStatus command");
+#ifdef USE_BINARY_SENSOR
+            if (this->is_paused_) this->is_paused_->publish_state(this->is_paused_flag_);
+#endif
             break;
 
         case Command::ReadPumpVoltage:
-            ESP_LOGI("Command", "Received ReadPumpVoltage command");
+            // steppers run off the board supply, there's nothing to read
             break;
 
-        case Command::ReadTotalVolumeDosed:
-            ESP_LOGI("Command", "Received ReadTotalVolumeDosed command");
+        default:
+            ESP_LOGE(TAG, "Unknown command received");
             break;
+    }
+}
 
-        case Command::SetCalibrationVolume:
-            ESP_LOGI("Command", "Received SetCalibrationVolume command");
-            break;
+bool BuffDoser::hold_dosers_() {
+    // a new dose replacing a running one keeps its hold
+    if (this->is_dosing_flag_) return true;
+    if (!this->buff_dosers_->tryHoldForDose()) {
+        ESP_LOGW(TAG, "Alk measurement running, ignoring dose");
+        return false;
+    }
+    return true;
+}
 
-        case Command::StopDosing:
-            ESP_LOGI("Command", "Received StopDosing command");
-            break;
+// with the dosers held
+void BuffDoser::start_dosing_() {
+    this->is_dosing_flag_ = true;
+    this->is_paused_flag_ = false;
+    this->accounted_dose_ml_ = 0;
+    this->last_progress_publish_ms_ = millis();
+    this->high_freq_.start();
+}
 
-        default:
-            ESP_LOGE("Command", "Unknown command received");
-            break;
+void BuffDoser::finish_dosing_() {
+    this->account_dosed_();
+    this->high_freq_.stop();
+    // the enable pin's shared, it's only let go of once nothing holds the dosers
+    if (this->is_dosing_flag_) this->buff_dosers_->releaseDose();
+    this->is_dosing_flag_ = false;
+    this->is_paused_flag_ = false;
+
+    // idle now, so a good time to write
+    if (this->state_dirty_) {
+        this->save_state_();
+    }
+
+    ESP_LOGI(TAG, "Dosed %.2fml", this->executor_->dosedML());
+    this->publish_dosing_();
+    this->publish_volumes_();
+}
+
+void BuffDoser::account_dosed_() {
+    const float dosed_ml = this->executor_->dosedML();
+    const float delta_ml = dosed_ml - this->accounted_dose_ml_;
+    this->accounted_dose_ml_ = dosed_ml;
+
+    this->total_volume_dosed_ml_ += delta_ml;
+    this->absolute_total_volume_dosed_ml_ += fabs(delta_ml);
+
+    if (delta_ml != 0) {
+        this->state_dirty_ = true;
+        this->unsaved_volume_ml_ += fabs(delta_ml);
+    }
+    // long or continuous doses still get saved every so often
+    if (this->unsaved_volume_ml_ >= this->persist_interval_volume_ml_) {
+        this->save_state_();
+    }
+}
+
+bool BuffDoser::replace_calibrator_(const float ml_per_rotation) {
+    // the measurement task holds a raw pointer to the calibrator for a whole dose
+    return this->buff_dosers_->tryUnlessMeasuring([&]() {
+        this->doser_->calibrator = std::make_shared<::buff::doser::Calibrator>(ml_per_rotation);
+    });
+}
+
+float BuffDoser::calibrated_ml_per_rotation_() {
+    if (this->pending_ml_per_rotation_ > 0) return this->pending_ml_per_rotation_;
+    return this->doser_->calibrator->getMlPerFullRotation();
+}
+
+void BuffDoser::load_state_() {
+    BuffDoserState state{};
+    if (!this->pref_.load(&state)) {
+        ESP_LOGD(TAG, "No saved state, starting from zero");
+        return;
+    }
+
+    this->total_volume_dosed_ml_ = state.total_volume_dosed_ml;
+    this->absolute_total_volume_dosed_ml_ = state.absolute_total_volume_dosed_ml;
+    if (state.ml_per_full_rotation > 0) {
+        if (!this->replace_calibrator_(state.ml_per_full_rotation)) {
+            ESP_LOGD(TAG, "Alk measurement running, calibration applied once it's done");
+            this->pending_ml_per_rotation_ = state.ml_per_full_rotation;
+        }
+        this->is_calibrated_flag_ = true;
     }
+    ESP_LOGD(TAG, "Loaded total=%.2fml absolute=%.2fml ml per rotation=%.4f", state.total_volume_dosed_ml,
+             state.absolute_total_volume_dosed_ml, state.ml_per_full_rotation);
+}
 
-    // this->is_waiting_ = true;
-    // this->start_time_ = millis();
-    // this->wait_time_ = wait_time_for_command;
+void BuffDoser::save_state_() {
+    BuffDoserState state{
+        .total_volume_dosed_ml = this->total_volume_dosed_ml_,
+        .absolute_total_volume_dosed_ml = this->absolute_total_volume_dosed_ml_,
+        .ml_per_full_rotation = this->is_calibrated_flag_ ? this->calibrated_ml_per_rotation_() : 0.0f,
+    };
+    if (!this->pref_.save(&state)) {
+        ESP_LOGW(TAG, "Failed to save state");
+        return;
+    }
+    this->state_dirty_ = false;
+    this->unsaved_volume_ml_ = 0;
+}
+
+void BuffDoser::publish_dosing_() {
+#ifdef USE_BINARY_SENSOR
+    if (this->is_dosing_) this->is_dosing_->publish_state(this->is_dosing_flag_);
+    if (this->is_paused_) this->is_paused_->publish_state(this->is_paused_flag_);
+#endif
+#ifdef USE_SENSOR
+    if (this->last_volume_requested_) this->last_volume_requested_->publish_state(this->last_volume_requested_ml_);
+#endif
+#ifdef USE_TEXT_SENSOR
+    if (!this->is_dosing_flag_ && !this->is_paused_flag_) {
+        // If pump is not paused and not dispensing
+        if (this->dosing_mode_ && this->dosing_mode_->state != DOSING_MODE_NONE)
+            this->dosing_mode_->publish_state(DOSING_MODE_NONE);
+    }
+#endif
+}
+
+void BuffDoser::publish_volumes_() {
+#ifdef USE_SENSOR
+    if (this->current_volume_dosed_) this->current_volume_dosed_->publish_state(this->executor_->dosedML());
+    if (this->total_volume_dosed_) this->total_volume_dosed_->publish_state(this->total_volume_dosed_ml_);
+    if (this->absolute_total_volume_dosed_)
+        this->absolute_total_volume_dosed_->publish_state(this->absolute_total_volume_dosed_ml_);
+#endif
+}
+
+void BuffDoser::publish_calibration_() {
+#ifdef USE_SENSOR
+    if (this->max_flow_rate_)
+        this->max_flow_rate_->publish_state(this->doser_->calibrator->getMlPerFullRotation() * this->doser_->config.motorRPM);
+#endif
+#ifdef USE_TEXT_SENSOR
+    if (this->calibration_status_)
+        this->calibration_status_->publish_state(this->is_calibrated_flag_ ? CALIBRATION_STATUS_FIXED_VOLUME : CALIBRATION_STATUS_UNCALIBRATED);
+#endif
+}
+
+void BuffDoser::enqueue_(const QueueableCommand &command) {
+    if (!this->queue_.tryPush(command)) {
+        ESP_LOGW(TAG, "Command queue full, dropping command");
+    }
 }
 
 // Actions
 void BuffDoser::dose_continuously() {
-    this->queue_.push({Command::DoseContinuously, 0, 0});
-    this->queue_.push({Command::ReadDosing});
+    this->enqueue_({Command::DoseContinuously, 0, 0});
+    this->enqueue_({Command::ReadDosing});
 }
 
 void BuffDoser::dose_volume(double volume) {
-    this->queue_.push({Command::DoseVolume, volume, 0});
-    this->queue_.push({Command::ReadDosing});
+    this->enqueue_({Command::DoseVolume, volume, 0});
+    this->enqueue_({Command::ReadDosing});
 }
 
 void BuffDoser::dose_volume_over_time(double volume, int duration) {
-    this->queue_.push({Command::DoseVolumeOverTime, volume, duration});
-    this->queue_.push({Command::ReadDosing});
+    this->enqueue_({Command::DoseVolumeOverTime, volume, duration});
+    this->enqueue_({Command::ReadDosing});
 }
 
 void BuffDoser::dose_with_constant_flow_rate(double volume, int duration) {
-    this->queue_.push({Command::DoseWithConstantFlowRate, volume, duration});
-    this->queue_.push({Command::ReadDosing});
+    this->enqueue_({Command::DoseWithConstantFlowRate, volume, duration});
+    this->enqueue_({Command::ReadDosing});
 }
 
 void BuffDoser::set_calibration_volume(double volume) {
-    this->queue_.push({Command::SetCalibrationVolume, volume, 0});
-    this->queue_.push({Command::ReadCalibrationStatus});
-    this->queue_.push({Command::ReadMaxFlowRate});
+    this->enqueue_({Command::SetCalibrationVolume, volume, 0});
+    this->enqueue_({Command::ReadCalibrationStatus});
+    this->enqueue_({Command::ReadMaxFlowRate});
 }
 
 void BuffDoser::clear_total_volume_dosed() {
-    this->queue_.push({Command::ClearTotalVolumeDosed});
-    this->queue_.push({Command::ReadTotalVolumeDosed});
-    this->queue_.push({Command::ReadAbsoluteTotalVolumeDosed});
+    this->enqueue_({Command::ClearTotalVolumeDosed});
+    this->enqueue_({Command::ReadTotalVolumeDosed});
+    this->enqueue_({Command::ReadAbsoluteTotalVolumeDosed});
 }
 
 void BuffDoser::clear_calibration() {
-    this->queue_.push({Command::ClearCalibration});
-    this->queue_.push({Command::ReadCalibrationStatus});
-    this->queue_.push({Command::ReadMaxFlowRate});
+    this->enqueue_({Command::ClearCalibration});
+    this->enqueue_({Command::ReadCalibrationStatus});
+    this->enqueue_({Command::ReadMaxFlowRate});
 }
 
 void BuffDoser::pause_dosing() {
-    this->queue_.push({Command::PauseDosing});
-    this->queue_.push({Command::ReadPauseStatus});
+    this->enqueue_({Command::PauseDosing});
+    this->enqueue_({Command::ReadPauseStatus});
 }
 
 void BuffDoser::stop_dosing() {
-    this->queue_.push({Command::StopDosing});
+    this->enqueue_({Command::StopDosing});
 }
 
 }  // namespace buff
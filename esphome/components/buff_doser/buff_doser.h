@@ -1,10 +1,10 @@
 #pragma once
 
-#include <queue>
-
 #include "esphome/core/automation.h"
 #include "esphome/core/component.h"
 #include "esphome/core/defines.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/preferences.h"
 
 #ifdef USE_BINARY_SENSOR
 #include "esphome/components/binary_sensor/binary_sensor.h"
@@ -26,6 +26,8 @@
 // #include <TinyMqtt.h>
 // #include <nvs_flash.h>
 
+#include "concurrency/rings.h"
+#include "doser/dose-executor.h"
 #include "doser/doser.h"
 #include "inputs-dosers.h"
 
@@ -57,6 +59,17 @@ enum class Command {
     TypeRead
 };
 
+// Set up on first use, and shared with every other component driving pumps on this board
+std::shared_ptr<::buff::doser::BuffDosers> shared_buff_dosers();
+
+// what survives a reboot, saved in the ESPHome preferences
+struct BuffDoserState {
+    float total_volume_dosed_ml;
+    float absolute_total_volume_dosed_ml;
+    // 0 when uncalibrated
+    float ml_per_full_rotation;
+};
+
 struct QueueableCommand {
     Command command;
     double volume = -1;
@@ -71,6 +84,15 @@ class BuffDoser : public PollingComponent {
     void setup() override;
     void loop() override;
     void update() override;
+    void on_shutdown() override;
+
+    void set_doser_type(const std::string &doser_type) {
+        doser_type_ = ::buff::doser::lookupMeasurementDoserType(doser_type);
+        doser_type_name_ = doser_type;
+    }
+    void set_persist_interval_volume(float persist_interval_volume_ml) {
+        persist_interval_volume_ml_ = persist_interval_volume_ml;
+    }
 
 #ifdef USE_SENSOR
     void set_current_volume_dosed(sensor::Sensor *current_volume_dosed) { current_volume_dosed_ = current_volume_dosed; }
@@ -107,21 +129,63 @@ class BuffDoser : public PollingComponent {
     void stop_dosing();
 
    protected:
-    std::queue<QueueableCommand> queue_;
-    QueueableCommand current_command_ = {Command::None};
-
-    // uint32_t start_time_ = 0;
-    // uint32_t wait_time_ = 0;
-    // bool is_waiting_ = false;
-    // bool is_first_read_ = true;
+    static const size_t COMMAND_QUEUE_DEPTH = 16;
+    // ESPHome warns about components that hold loop() for more than ~30ms
+    static const uint32_t STEP_BUDGET_US = 5000;
+    static const uint32_t PROGRESS_PUBLISH_INTERVAL_MS = 1000;
+
+    // actions can come in from API callbacks while loop() is draining
+    ::buff::concurrency::MPSCRing<QueueableCommand, COMMAND_QUEUE_DEPTH> queue_;
+
+    void enqueue_(const QueueableCommand &command);
+    void handle_command_(const QueueableCommand &command);
+    // false, with a warning, while a measurement has the dosers
+    bool hold_dosers_();
+    void start_dosing_();
+    void finish_dosing_();
+    // folds what the executor has output since the last call into the totals
+    void account_dosed_();
+
+    void publish_dosing_();
+    void publish_volumes_();
+    void publish_calibration_();
+
+    // false while a measurement has the dosers, it could be mid dose with the old one
+    bool replace_calibrator_(float ml_per_rotation);
+    // what's saved, including a calibration still waiting on a measurement
+    float calibrated_ml_per_rotation_();
+
+    void load_state_();
+    void save_state_();
+
+    // totals are saved when a dose finishes, or after this much has been
+    // dosed since the last save, rather than on every progress update
+    float persist_interval_volume_ml_ = 5.0;
+    float unsaved_volume_ml_ = 0;
+    bool state_dirty_ = false;
+    ESPPreferenceObject pref_;
+
+    ::buff::MeasurementDoserType doser_type_ = ::buff::REAGENT;
+    std::string doser_type_name_ = "reagent";
+    std::shared_ptr<::buff::doser::BuffDosers> buff_dosers_ = nullptr;
+    std::shared_ptr<::buff::doser::Doser> doser_ = nullptr;
+    std::unique_ptr<::buff::doser::DoseExecutor> executor_ = nullptr;
+
+    // keeps loop() being called back to back while the motor is stepping
+    HighFrequencyLoopRequester high_freq_;
 
     bool is_paused_flag_ = false;
     bool is_dosing_flag_ = false;
-
-    std::shared_ptr<::buff::doser::BuffDosers> _buffDosers = nullptr;
-
-    // std::shared_ptr<NTPClient> _ntpClient;
-    // std::shared_ptr<buff_time::TimeWrapper> _timeClient;
+    bool is_calibrated_flag_ = false;
+    // loaded while a measurement had the dosers, applied once it's done
+    float pending_ml_per_rotation_ = 0;
+
+    float last_volume_requested_ml_ = 0;
+    float total_volume_dosed_ml_ = 0;
+    float absolute_total_volume_dosed_ml_ = 0;
+    // executor output already folded into the totals
+    float accounted_dose_ml_ = 0;
+    uint32_t last_progress_publish_ms_ = 0;
 
 #ifdef USE_SENSOR
     sensor::Sensor *current_volume_dosed_{nullptr};
@@ -5,6 +5,13 @@
 #include <Adafruit_SSD1306.h>
 #include <Wire.h>
 
+#include <algorithm>
+#include <atomic>
+
+#include "buff-displays/display-cache.h"
+#include "buff_time/monotonic-clock.h"
+#include "sensors/i2c-buses.h"
+
 namespace buff {
 namespace monitoring_display {
 
@@ -13,51 +20,194 @@ const uint SCREEN_HEIGHT = 64;  // OLED display height, in pixels
 
 const uint8_t DISPLAY_I2C_ADDRESS = 0x3c;
 
+// each text line (size 1) is exactly one of the controller's 8 pixel pages
+const uint8_t PAGE_HEIGHT = 8;
+const uint8_t PAGE_COUNT = SCREEN_HEIGHT / PAGE_HEIGHT;
+
+// every I2C byte is bus time the pH sensor waits for
+const unsigned long PH_REFRESH_INTERVAL_MS = 2000;
+
 #define OLED_RESET -1  // Reset pin # (or -1 if sharing Arduino reset pin)
-::Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
+
+/*******************************
+ * PagedSSD1306
+ * display() always pushes the full 1KB frame, this only pushes the pages
+ * that were redrawn, the same way display() does.
+ *
+ * Everything goes through the display's bus at low priority, one transaction
+ * per page, so on a shared bus a pH read waits for at most a page (~3ms at
+ * 400kHz), never a frame.
+ *******************************/
+class PagedSSD1306 : public ::Adafruit_SSD1306 {
+   private:
+    sensors::WireBus &_bus;
+
+   public:
+    // the bus already sets the clock, so the library's own switching is a no-op
+    PagedSSD1306(sensors::WireBus &bus)
+        : Adafruit_SSD1306(SCREEN_WIDTH, SCREEN_HEIGHT, &bus.wire(), OLED_RESET, sensors::DISPLAY_I2C_CLOCK_HZ, sensors::DISPLAY_I2C_CLOCK_HZ), _bus(bus) {}
+
+    // begin & clear, the bus is already started by setupI2CBuses
+    bool beginOnBus() {
+        sensors::WireBus::Transaction transaction(_bus, concurrency::I2C_LOW_PRIORITY, sensors::DISPLAY_I2C_CLOCK_HZ);
+        // SSD1306_SWITCHCAPVCC = generate display voltage from 3.3V internally
+        if (!begin(SSD1306_SWITCHCAPVCC, DISPLAY_I2C_ADDRESS, true, false)) {
+            return false;
+        }
+        clearDisplay();
+        display();
+        return true;
+    }
+
+    void setPower(const bool on, const bool dimmed) {
+        sensors::WireBus::Transaction transaction(_bus, concurrency::I2C_LOW_PRIORITY, sensors::DISPLAY_I2C_CLOCK_HZ);
+        ssd1306_command(on ? SSD1306_DISPLAYON : SSD1306_DISPLAYOFF);
+        dim(dimmed);
+    }
+
+    // bit n set for page n
+    void displayPages(const uint8_t pageMask) {
+        for (uint8_t page = 0; page < PAGE_COUNT; page++) {
+            if (!(pageMask & (1 << page))) continue;
+            sensors::WireBus::Transaction transaction(_bus, concurrency::I2C_LOW_PRIORITY, sensors::DISPLAY_I2C_CLOCK_HZ);
+
+            const uint8_t window[] = {SSD1306_PAGEADDR, page, page, SSD1306_COLUMNADDR, 0, (uint8_t)(WIDTH - 1)};
+            ssd1306_commandList(window, sizeof(window));
+
+            const uint8_t* ptr = getBuffer() + page * WIDTH;
+            uint16_t count = WIDTH;
+            // same chunking as display(), the data prefix counts towards it
+            const uint16_t wireMax = 32;
+            while (count > 0) {
+                const uint16_t chunk = std::min<uint16_t>(count, wireMax - 1);
+                wire->beginTransmission(i2caddr);
+                wire->write((uint8_t)0x40);
+                wire->write(ptr, chunk);
+                wire->endTransmission();
+                ptr += chunk;
+                count -= chunk;
+            }
+        }
+    }
+};
+
+// on whichever bus setupI2CBuses gave the display
+static std::unique_ptr<PagedSSD1306> display;
 
 static bool displaySetupFully = false;
 
+enum PHLine {
+    PH_LINE,
+    PH_MAVG_LINE,
+    CALIBRATED_LINE,
+    CALIBRATED_MAVG_LINE,
+    AS_OF_LINE,
+    PH_LINE_COUNT
+};
+
+struct PendingPH {
+    float pH;
+    float convertedPH;
+    float rawPH_mvag;
+    float calibratedPH_mvag;
+    uint64_t asOfMS;
+};
+
+// set on the control task (eg going idle), applied by loopDisplay, -1 when there's nothing to apply
+static std::atomic<int> pendingBrightness{-1};
+
+static PendingPH pendingPH;
+static TextCache phLines(PH_LINE_COUNT);
+static RefreshLimiter phRefreshLimiter(PH_REFRESH_INTERVAL_MS);
+
 void setupDisplay(std::shared_ptr<reading_store::ReadingStore> readingStore, std::shared_ptr<mqtt::Publisher> publisher) {
-    // SSD1306_SWITCHCAPVCC = generate display voltage from 3.3V internally
-    if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) {
+    display = std::unique_ptr<PagedSSD1306>(new PagedSSD1306(sensors::displayBus()));
+    if (!display->beginOnBus()) {
         Serial.println(F("SSD1306 allocation failed"));
     } else {
+        display->setTextSize(1);       // Normal 1:1 pixel scale
+        display->setTextColor(WHITE);  // Draw white text
+        display->cp437(true);          // Use full 256 char 'Code Page 437' font
         displaySetupFully = true;
     }
 }
 
-void displayPH(const float pH, const float convertedPH, const float rawPH_mvag, const float calibratedPH_mvag, const ulong asOfMS, const unsigned long asOfAdjustedSec) {
+// returns the line's page bit when it changed, after redrawing it
+uint8_t drawLineIfChanged(const PHLine line, const char* text) {
+    if (!phLines.changed(line, text)) {
+        return 0;
+    }
+
+    const int16_t y = line * PAGE_HEIGHT;
+    display->fillRect(0, y, SCREEN_WIDTH, PAGE_HEIGHT, BLACK);
+    display->setCursor(0, y);
+    display->print(text);
+    return 1 << line;
+}
+
+void renderPHIfDue() {
+    if (!phRefreshLimiter.shouldRefresh(buff_time::monotonicMS())) {
+        return;
+    }
+
+    const size_t bufSize = 32;
+    char buf[bufSize];
+    uint8_t dirtyPages = 0;
+
+    snprintf(buf, bufSize, "pH=%.3f", pendingPH.pH);
+    dirtyPages |= drawLineIfChanged(PH_LINE, buf);
+    snprintf(buf, bufSize, "mavg(pH)=%.3f", pendingPH.rawPH_mvag);
+    dirtyPages |= drawLineIfChanged(PH_MAVG_LINE, buf);
+
+    snprintf(buf, bufSize, "calib=%.3f", pendingPH.convertedPH);
+    dirtyPages |= drawLineIfChanged(CALIBRATED_LINE, buf);
+    snprintf(buf, bufSize, "mvag(calib)=%.3f", pendingPH.calibratedPH_mvag);
+    dirtyPages |= drawLineIfChanged(CALIBRATED_MAVG_LINE, buf);
+
+    snprintf(buf, bufSize, "asOf=%llu", (unsigned long long)pendingPH.asOfMS);
+    dirtyPages |= drawLineIfChanged(AS_OF_LINE, buf);
+
+    display->displayPages(dirtyPages);
+}
+
+void displayPH(const float pH, const float convertedPH, const float rawPH_mvag, const float calibratedPH_mvag, const uint64_t asOfMS, const unsigned long asOfAdjustedSec) {
     if (!displaySetupFully) {
         return;
     }
-    display.clearDisplay();
 
-    display.setTextSize(1);       // Normal 1:1 pixel scale
-    display.setTextColor(WHITE);  // Draw white text
-    display.setCursor(0, 0);      // Start at top-left corner
-    display.cp437(true);          // Use full 256 char 'Code Page 437' font
+    pendingPH = {pH, convertedPH, rawPH_mvag, calibratedPH_mvag, asOfMS};
+    phRefreshLimiter.markPending();
+    renderPHIfDue();
+}
 
-    display.print(F("pH="));
-    display.println(pH, 3);
-    display.print(F("mavg(pH)="));
-    display.println(rawPH_mvag, 3);
+// An OLED, so no backlight: anything under full brightness is dimmed, 0 is off
+void applyPendingBrightness() {
+    const int brightness = pendingBrightness.exchange(-1);
+    if (brightness < 0) return;
 
-    display.print(F("calib="));
-    display.println(convertedPH, 3);
-    display.print(F("mvag(calib)="));
-    display.println(calibratedPH_mvag, 3);
+    display->setPower(brightness > 0, brightness < 255);
+}
 
-    display.print(F("asOf="));
-    display.println(asOfMS);
+void loopDisplay() {
+    if (displaySetupFully) {
+        applyPendingBrightness();
+        renderPHIfDue();
+    }
+}
 
-    display.display();
+// only the display's task talks to it, the change goes over with the next loopDisplay
+void setBacklight(const uint8_t brightness) {
+    pendingBrightness = brightness;
 }
 
-void loopDisplay() {}
+// no touch screen
+void setTouchCallback(std::function<void()> callback) {}
 
 void updateDisplay(std::shared_ptr<reading_store::ReadingStore> readingStore) {}
 
+// no room for charts
+void recordTitrationPoint(const reading_store::TitrationPoint& point) {}
+
 }  // namespace monitoring_display
 }  // namespace buff
 
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace buff {
+namespace monitoring_display {
+
+/*******************************
+ * TextCache
+ * The last text rendered to each of a display's fields (labels, lines), so
+ * only the ones that actually changed get redrawn.
+ *******************************/
+class TextCache {
+   private:
+    std::vector<std::string> _texts;
+    std::vector<bool> _rendered;
+
+   public:
+    TextCache(const size_t fields) : _texts(fields), _rendered(fields, false) {}
+
+    // true, and remembered, when text differs from what the field shows
+    bool changed(const size_t field, const char* text) {
+        if (_rendered[field] && _texts[field] == text) return false;
+        _texts[field] = text;
+        _rendered[field] = true;
+        return true;
+    }
+
+    // eg after the display was cleared
+    void invalidate() {
+        for (size_t i = 0; i < _rendered.size(); i++) {
+            _rendered[i] = false;
+        }
+    }
+
+    const std::string& text(const size_t field) const { return _texts[field]; }
+};
+
+/*******************************
+ * RefreshLimiter
+ * Caps how often a display redraws. Updates that come in faster are held as
+ * pending and picked up once the interval's passed, so the latest values
+ * always end up on screen.
+ *******************************/
+class RefreshLimiter {
+   private:
+    const unsigned long _minIntervalMS;
+    uint64_t _lastRefreshMS = 0;
+    bool _refreshed = false;
+    bool _pending = false;
+
+   public:
+    RefreshLimiter(const unsigned long minIntervalMS) : _minIntervalMS(minIntervalMS) {}
+
+    void markPending() { _pending = true; }
+    bool pending() const { return _pending; }
+
+    // true when there's something to draw and it's been long enough, the
+    // caller is expected to draw it
+    bool shouldRefresh(const uint64_t nowMS) {
+        if (!_pending) return false;
+        if (_refreshed && nowMS - _lastRefreshMS < _minIntervalMS) return false;
+
+        _pending = false;
+        _refreshed = true;
+        _lastRefreshMS = nowMS;
+        return true;
+    }
+};
+
+}  // namespace monitoring_display
+}  // namespace buff
@@ -74,7 +74,7 @@ void setupDisplay(std::shared_ptr<reading_store::ReadingStore> readingStore, std
     // #endif
 }
 
-void displayPH(const float pH, const float convertedPH, const float rawPH_mvag, const float calibratedPH_mvag, const ulong asOfMS, const ulong asOfAdjustedSec) {
+void displayPH(const float pH, const float convertedPH, const float rawPH_mvag, const float calibratedPH_mvag, const uint64_t asOfMS, const ulong asOfAdjustedSec) {
     if (!displaySetupFully) {
         return;
     }
@@ -117,6 +117,17 @@ void displayPH(const float pH, const float convertedPH, const float rawPH_mvag,
 void loopDisplay() {}
 void updateDisplay(std::shared_ptr<reading_store::ReadingStore> readingStore) {}
 
+// text only, no charts
+void recordTitrationPoint(const reading_store::TitrationPoint& point) {}
+
+// LCD_EN drives the backlight, active low
+void setBacklight(const uint8_t brightness) {
+    analogWrite(LCD_EN, 255 - brightness);
+}
+
+// no touch screen
+void setTouchCallback(std::function<void()> callback) {}
+
 }  // namespace monitoring_display
 }  // namespace buff
 
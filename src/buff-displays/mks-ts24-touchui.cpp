@@ -3,19 +3,30 @@
 #include <SPI.h>
 
 #include "buff-displays/monitoring-display.h"
+#include "buff-displays/display-cache.h"
+#include "buff-displays/reading-list-pool.h"
+#include "buff-displays/touch-sampler.h"
 
 // TODO: move this out
 #define LCD_EN GPIO_NUM_5
 #define TOUCH_CS GPIO_NUM_26
+// define TOUCH_IRQ (eg in build_flags) when the panel's T_IRQ is wired to a
+// GPIO, otherwise the touch controller is polled
 #include "TFT_eSPI.h"
 #include "lvgl.h"
+#include <esp_attr.h>
 
 // stdlib
+#include <algorithm>
+#include <atomic>
 #include <memory>
 
 // My Libs
+#include "buff_time/monotonic-clock.h"
+#include "concurrency/rings.h"
 #include "mqtt-common.h"
 #include "readings/alk-measure-common.h"
+#include "readings/reading-series.h"
 #include "readings/reading-store.h"
 
 namespace buff {
@@ -41,47 +52,143 @@ auto static tft = TFT_eSPI(SCREEN_WIDTH, TS24_HEIGHT);
 
 static bool displaySetupFully = false;
 
+// LVGL renders one band while the other is going out over SPI DMA
+static const uint16_t DRAW_BAND_LINES = 20;
 static lv_disp_draw_buf_t drawBuf;
-static lv_color_t buf[SCREEN_WIDTH * 10];
+DMA_ATTR static lv_color_t drawBand1[SCREEN_WIDTH * DRAW_BAND_LINES];
+DMA_ATTR static lv_color_t drawBand2[SCREEN_WIDTH * DRAW_BAND_LINES];
+// set while a band's DMA is in flight
+static lv_disp_drv_t* flushingDisp = nullptr;
 
 lv_obj_t* timeLabel;
 lv_obj_t* phLabel;
 
 lv_obj_t* triggerRoller;
+lv_obj_t* calibrateRoller;
 lv_obj_t* readingsList;
 
+// created once, then recycled by readingListPool
+static const size_t READING_ROWS = 10;
+lv_obj_t* readingButtons[READING_ROWS];
+lv_obj_t* readingLabels[READING_ROWS];
+
+// dKH of the roller's title, decimated down to TREND_POINTS
+static const size_t TREND_POINTS = 24;
+lv_obj_t* trendChart;
+lv_chart_series_t* trendSeries;
+
+// pH vs reagent ml of the running measurement
+static const size_t TITRATION_POINTS = 64;
+lv_obj_t* titrationChart;
+lv_chart_series_t* titrationSeries;
+
+// for redrawing the trend when the roller moves
+std::shared_ptr<reading_store::ReadingStore> chartReadingStore;
+
 lv_obj_t* debugRawPHLabel;
 
 std::shared_ptr<mqtt::Publisher> publisher;
 
-/* Display flushing */
+std::function<void()> touchCallback;
+// touches on a blanked screen only wake it, so they don't press whatever's under them.
+// Set on the control task, read on the network task.
+static std::atomic<bool> backlightOff{false};
+
+/* Display flushing
+ * TFT_eSPI has no DMA completion callback, so the in-flight band is polled:
+ * from LVGL's wait_cb when it wants the buffer back, and before anything
+ * else needs the SPI bus (the touch controller shares it).
+ */
+void finishFlush(const bool wait) {
+    if (flushingDisp == nullptr) {
+        return;
+    }
+    if (wait) {
+        tft.dmaWait();
+    } else if (tft.dmaBusy()) {
+        return;
+    }
+    tft.endWrite();
+
+    auto disp = flushingDisp;
+    flushingDisp = nullptr;
+    lv_disp_flush_ready(disp);
+}
+
 void flushCB(lv_disp_drv_t* disp, const lv_area_t* area, lv_color_t* color_p) {
     uint32_t w = (area->x2 - area->x1 + 1);
     uint32_t h = (area->y2 - area->y1 + 1);
 
+    // LVGL's already waited for the previous band, this is just in case
+    finishFlush(true);
+
+    // LV_COLOR_16_SWAP has LVGL render in the panel's byte order, so no swap here
     tft.startWrite();
     tft.setAddrWindow(area->x1, area->y1, w, h);
-    tft.pushColors((uint16_t*)&color_p->full, w * h, true);
-    tft.endWrite();
+    tft.pushPixelsDMA((uint16_t*)&color_p->full, w * h);
+    flushingDisp = disp;
+}
 
-    lv_disp_flush_ready(disp);
+void flushWaitCB(lv_disp_drv_t* disp) {
+    finishFlush(false);
 }
 
-void touchReadCB(lv_indev_drv_t* indev_driver, lv_indev_data_t* data) {
-    uint16_t touchX, touchY;
+/* Touch sampling
+ * LVGL polls every 30ms, but the touch controller's only read when it could
+ * be pressed, and TouchSampler caches & debounces what it reads. So nobody
+ * touching the screen costs the display's flushes no SPI time (with
+ * TOUCH_IRQ), or one short read every 100ms (without).
+ */
+// under this pressure it's not a touch, as for getTouch
+static const uint16_t TOUCH_PRESSURE_THRESHOLD = 600;
 
-    bool touched = tft.getTouch(&touchX, &touchY, 600);
+static TouchSampler touchSampler;
 
-    touchX = tft.width() - touchX;
-    touchY = tft.height() - touchY;
+#ifdef TOUCH_IRQ
+// latched by the pen IRQ, so a tap between polls still gets read
+static std::atomic<bool> touchIrqLatched{false};
+
+void IRAM_ATTR touchIrqISR() {
+    touchIrqLatched = true;
+}
+#endif
 
-    if (!touched) {
+bool penMaybeDown() {
+#ifdef TOUCH_IRQ
+    // low while pressed
+    return touchIrqLatched.exchange(false) || digitalRead(TOUCH_IRQ) == LOW;
+#else
+    return true;
+#endif
+}
+
+bool readTouch(uint16_t& x, uint16_t& y) {
+    // the touch controller's on the same SPI bus
+    finishFlush(true);
+
+    // a single transfer for the pressure, before getTouch's several
+    const bool touched = tft.getTouchRawZ() > TOUCH_PRESSURE_THRESHOLD && tft.getTouch(&x, &y, TOUCH_PRESSURE_THRESHOLD);
+#ifdef TOUCH_IRQ
+    // the line drops while the controller's being read
+    touchIrqLatched = false;
+#endif
+    return touched;
+}
+
+void touchReadCB(lv_indev_drv_t* indev_driver, lv_indev_data_t* data) {
+    const auto& touch = touchSampler.sample(buff_time::monotonicMS(), penMaybeDown(), readTouch);
+
+    if (touch.pressed && touchCallback) {
+        touchCallback();
+    }
+
+    if (!touch.pressed || backlightOff) {
         data->state = LV_INDEV_STATE_REL;
     } else {
         data->state = LV_INDEV_STATE_PR;
 
-        data->point.x = touchX;
-        data->point.y = touchY;
+        data->point.x = tft.width() - touch.x;
+        data->point.y = tft.height() - touch.y;
     }
 }
 
@@ -100,6 +207,19 @@ void event_handler(lv_event_t* e) {
     }
 }
 
+// buffer solutions offered for calibration, in the same order as the roller
+static const float CALIBRATION_BUFFERS[] = {4.0, 4.5, 7.0, 10.0};
+static const char* CALIBRATION_BUFFER_OPTIONS = "pH 4.0\npH 4.5\npH 7.0\npH 10.0";
+
+void calibrateEventHandler(lv_event_t* e) {
+    if (lv_event_get_code(e) != LV_EVENT_CLICKED) {
+        return;
+    }
+
+    const auto selected = lv_roller_get_selected(calibrateRoller);
+    publisher->publishCalibratePH(CALIBRATION_BUFFERS[selected], millis());
+}
+
 void tftSetup() {
     tft.begin();
 #ifdef MKS_DISPLAY_TS35
@@ -146,12 +266,17 @@ void tftSetup() {
 
     uint16_t calData[5] = {275, 3620, 264, 3532, 1};
     tft.setTouch(calData);
+
+#ifdef TOUCH_IRQ
+    pinMode(TOUCH_IRQ, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(TOUCH_IRQ), touchIrqISR, FALLING);
+#endif
 }
 
 void lvSetup() {
     lv_init();
 
-    lv_disp_draw_buf_init(&drawBuf, buf, NULL, SCREEN_WIDTH * 10);
+    lv_disp_draw_buf_init(&drawBuf, drawBand1, drawBand2, SCREEN_WIDTH * DRAW_BAND_LINES);
 
     /*Initialize the display*/
     static lv_disp_drv_t disp_drv;
@@ -160,6 +285,7 @@ void lvSetup() {
     disp_drv.hor_res = SCREEN_WIDTH;
     disp_drv.ver_res = SCREEN_HEIGHT;
     disp_drv.flush_cb = flushCB;
+    disp_drv.wait_cb = flushWaitCB;
     disp_drv.draw_buf = &drawBuf;
     lv_disp_drv_register(&disp_drv);
 
@@ -176,6 +302,8 @@ void enableDisplayHardware() {
     digitalWrite(LCD_EN, LOW);
 }
 
+void triggerRollerEventHandler(lv_event_t* e);
+
 void createMainPage() {
     lv_obj_t* mainPage = lv_obj_create(lv_scr_act());
     lv_obj_set_flex_flow(mainPage, LV_FLEX_FLOW_COLUMN);
@@ -224,7 +352,7 @@ void createMainPage() {
     lv_roller_set_visible_row_count(triggerRoller, 3);
     lv_obj_center(triggerRoller);
     lv_obj_set_size(triggerRoller, LV_PCT(65), 70);
-    // lv_obj_add_event_cb(triggerRoller, event_handler, LV_EVENT_ALL, NULL);
+    lv_obj_add_event_cb(triggerRoller, triggerRollerEventHandler, LV_EVENT_VALUE_CHANGED, NULL);
 
     // trigger button
     lv_obj_t* triggerBtn = lv_btn_create(triggerRow);
@@ -238,16 +366,73 @@ void createMainPage() {
     lv_obj_set_size(triggerLabel, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
 
     /***************
-     * List of readings
+     * Calibration row
+     * With the probe in the chosen buffer, records the current reading for it
+     ***************/
+    lv_obj_t* calibrateRow = lv_obj_create(mainPage);
+    lv_obj_set_size(calibrateRow, LV_PCT(100), LV_SIZE_CONTENT);
+    lv_obj_set_flex_flow(calibrateRow, LV_FLEX_FLOW_ROW);
+    lv_obj_set_flex_align(calibrateRow, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+    lv_obj_set_style_pad_column(calibrateRow, 5, 0);
+
+    calibrateRoller = lv_roller_create(calibrateRow);
+    lv_roller_set_options(calibrateRoller, CALIBRATION_BUFFER_OPTIONS, LV_ROLLER_MODE_NORMAL);
+    lv_roller_set_visible_row_count(calibrateRoller, 1);
+    lv_obj_set_size(calibrateRoller, LV_PCT(65), LV_SIZE_CONTENT);
+
+    lv_obj_t* calibrateBtn = lv_btn_create(calibrateRow);
+    lv_obj_set_size(calibrateBtn, LV_PCT(35), 40);
+    lv_obj_add_event_cb(calibrateBtn, calibrateEventHandler, LV_EVENT_CLICKED, NULL);
+
+    lv_obj_t* calibrateLabel = lv_label_create(calibrateBtn);
+    lv_label_set_text(calibrateLabel, "Calibrate");
+    lv_obj_set_align(calibrateLabel, LV_ALIGN_CENTER);
+
+    /***************
+     * Readings, as a list & as charts
      ***************/
-    readingsList = lv_obj_create(mainPage);
-    lv_obj_set_width(readingsList, LV_PCT(100));
-    // lv_obj_set_height(readingsList, 175);
-    lv_obj_align_to(readingsList, triggerRow, LV_ALIGN_OUT_BOTTOM_MID, 0, 5);
+    lv_obj_t* readingTabs = lv_tabview_create(mainPage, LV_DIR_TOP, 30);
+    lv_obj_set_width(readingTabs, LV_PCT(100));
+    lv_obj_set_flex_grow(readingTabs, 1);
+
+    lv_obj_t* listTab = lv_tabview_add_tab(readingTabs, "Readings");
+    lv_obj_t* trendTab = lv_tabview_add_tab(readingTabs, "Trend");
+    lv_obj_t* titrationTab = lv_tabview_add_tab(readingTabs, "Titration");
+
+    readingsList = lv_obj_create(listTab);
+    lv_obj_set_size(readingsList, LV_PCT(100), LV_SIZE_CONTENT);
     lv_obj_set_flex_flow(readingsList, LV_FLEX_FLOW_COLUMN);
-    lv_obj_set_flex_grow(readingsList, 1);
     lv_obj_set_style_pad_row(readingsList, 5, 0);
 
+    for (size_t i = 0; i < READING_ROWS; i++) {
+        readingButtons[i] = lv_btn_create(readingsList);
+        lv_obj_set_size(readingButtons[i], LV_PCT(100), LV_SIZE_CONTENT);
+        lv_obj_add_flag(readingButtons[i], LV_OBJ_FLAG_HIDDEN);
+
+        readingLabels[i] = lv_label_create(readingButtons[i]);
+        lv_label_set_text(readingLabels[i], "");
+    }
+
+    // new points shift in from the right, so updates only draw what's new
+    trendChart = lv_chart_create(trendTab);
+    lv_obj_set_size(trendChart, LV_PCT(100), LV_PCT(100));
+    lv_chart_set_type(trendChart, LV_CHART_TYPE_LINE);
+    lv_chart_set_update_mode(trendChart, LV_CHART_UPDATE_MODE_SHIFT);
+    lv_chart_set_point_count(trendChart, TREND_POINTS);
+    trendSeries = lv_chart_add_series(trendChart, lv_palette_main(LV_PALETTE_BLUE), LV_CHART_AXIS_PRIMARY_Y);
+    lv_chart_set_all_value(trendChart, trendSeries, LV_CHART_POINT_NONE);
+
+    titrationChart = lv_chart_create(titrationTab);
+    lv_obj_set_size(titrationChart, LV_PCT(100), LV_PCT(100));
+    lv_chart_set_type(titrationChart, LV_CHART_TYPE_SCATTER);
+    lv_chart_set_update_mode(titrationChart, LV_CHART_UPDATE_MODE_SHIFT);
+    lv_chart_set_point_count(titrationChart, TITRATION_POINTS);
+    // pH 3 - 9, the x axis grows with the reagent
+    lv_chart_set_range(titrationChart, LV_CHART_AXIS_PRIMARY_Y, 3 * reading_store::SERIES_SCALE, 9 * reading_store::SERIES_SCALE);
+    lv_chart_set_range(titrationChart, LV_CHART_AXIS_PRIMARY_X, 0, reading_store::SERIES_SCALE);
+    titrationSeries = lv_chart_add_series(titrationChart, lv_palette_main(LV_PALETTE_RED), LV_CHART_AXIS_PRIMARY_Y);
+    lv_chart_set_all_value(titrationChart, titrationSeries, LV_CHART_POINT_NONE);
+
     /***************
      * Debug bar
      ***************/
@@ -269,6 +454,38 @@ void createMainPage() {
     lv_obj_add_style(debugRawPHLabel, &smallLabelStyle, 0);
 }
 
+/***************
+ * Reading list widgets
+ ***************/
+class LvReadingRows : public RowWidgets {
+   public:
+    void moveToTop(const size_t slot) override {
+        lv_obj_move_to_index(readingButtons[slot], 0);
+    }
+
+    void setText(const size_t slot, const std::string& text) override {
+        lv_label_set_text(readingLabels[slot], text.c_str());
+    }
+
+    void setVisible(const size_t slot, const bool visible) override {
+        if (visible) {
+            lv_obj_clear_flag(readingButtons[slot], LV_OBJ_FLAG_HIDDEN);
+        } else {
+            lv_obj_add_flag(readingButtons[slot], LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+};
+
+static LvReadingRows readingRows;
+static ReadingListPool readingListPool(READING_ROWS);
+static ChangedOptions triggerOptions;
+
+std::string selectedTriggerTitle() {
+    char selected[reading_store::MAX_TITLE_LEN + 1] = "";
+    lv_roller_get_selected_str(triggerRoller, selected, sizeof(selected));
+    return selected;
+}
+
 void refreshTriggerList(const std::set<std::string>& titles) {
     std::string concatTitle = "";
     for (auto title : titles) {
@@ -278,26 +495,108 @@ void refreshTriggerList(const std::set<std::string>& titles) {
         concatTitle += title;
     }
 
+    if (!triggerOptions.update(concatTitle)) return;
+
+    // setting options resets the selection, keep it on the same title
+    const std::string selected = selectedTriggerTitle();
+
     lv_roller_set_options(triggerRoller,
                           concatTitle.c_str(),
                           LV_ROLLER_MODE_NORMAL);
-}
 
-void refreshReadingList(const std::vector<std::reference_wrapper<alk_measure::PersistedAlkReading>> alkReadings) {
-    lv_obj_clean(readingsList);
+    auto found = titles.find(selected);
+    if (found != titles.end()) {
+        lv_roller_set_selected(triggerRoller, std::distance(titles.begin(), found), LV_ANIM_OFF);
+    }
+}
 
+void refreshReadingList(const std::vector<std::reference_wrapper<alk_measure::PersistedAlkReading>>& alkReadings, const size_t tipIndex, const size_t storeSize) {
     const size_t bufferSize = 256;
     char printBuff[bufferSize];
 
-    for (int i = 0; i < std::min(alkReadings.size(), static_cast<size_t>(10)); i++) {
-        auto readingRef = alkReadings[i];
-        auto reading = readingRef.get();
-        lv_obj_t* btn = lv_btn_create(readingsList);
-
-        lv_obj_t* label = lv_label_create(btn);
+    std::vector<std::string> rows;
+    rows.reserve(READING_ROWS);
+    for (size_t i = 0; i < std::min(alkReadings.size(), READING_ROWS); i++) {
+        const auto& reading = alkReadings[i].get();
         snprintf(printBuff, bufferSize, "%s: %.1f dkh", reading.title.c_str(), reading.alkReadingDKH);
-        lv_label_set_text(label, printBuff);
-        lv_obj_set_size(btn, LV_PCT(100), LV_SIZE_CONTENT);
+        rows.push_back(printBuff);
+    }
+
+    readingListPool.update(rows, tipIndex, storeSize, readingRows);
+}
+
+/***************
+ * Charts
+ * Both only push the points they don't already show, a full redraw is only
+ * for a different title or when the decimation buckets move.
+ ***************/
+static std::vector<int16_t> trendValues;
+static std::string trendTitle;
+static lv_coord_t trendMin = 0;
+static lv_coord_t trendMax = 0;
+
+void refreshTrendChart(const std::vector<std::reference_wrapper<alk_measure::PersistedAlkReading>>& alkReadings) {
+    const std::string title = selectedTriggerTitle();
+    const auto values = reading_store::decimatedTitleSeries(alkReadings, title, TREND_POINTS);
+
+    int appended = title == trendTitle ? reading_store::appendedPoints(trendValues, values) : -1;
+    if (appended == 0) return;
+    if (appended < 0) {
+        lv_chart_set_all_value(trendChart, trendSeries, LV_CHART_POINT_NONE);
+        appended = values.size();
+    }
+
+    if (!values.empty()) {
+        // half a dKH either side
+        const lv_coord_t pad = reading_store::SERIES_SCALE / 2;
+        const lv_coord_t min = *std::min_element(values.begin(), values.end()) - pad;
+        const lv_coord_t max = *std::max_element(values.begin(), values.end()) + pad;
+        if (min != trendMin || max != trendMax) {
+            lv_chart_set_range(trendChart, LV_CHART_AXIS_PRIMARY_Y, min, max);
+            trendMin = min;
+            trendMax = max;
+        }
+    }
+
+    for (size_t i = values.size() - appended; i < values.size(); i++) {
+        lv_chart_set_next_value(trendChart, trendSeries, values[i]);
+    }
+    trendValues = values;
+    trendTitle = title;
+}
+
+void triggerRollerEventHandler(lv_event_t* e) {
+    if (chartReadingStore) {
+        refreshTrendChart(chartReadingStore->getReadingsSortedByAsOf());
+    }
+}
+
+// control task in, display out
+static concurrency::SPSCRing<reading_store::TitrationPoint, 16> titrationPoints;
+static reading_store::TitrationCurve titrationCurve(TITRATION_POINTS);
+static lv_coord_t titrationMaxML = reading_store::SERIES_SCALE;
+
+void recordTitrationPoint(const reading_store::TitrationPoint& point) {
+    // a point's only dropped if the display's a dozen steps behind
+    titrationPoints.tryPush(point);
+}
+
+void drainTitrationPoints() {
+    reading_store::TitrationPoint point;
+    while (titrationPoints.tryPop(point)) {
+        if (titrationCurve.add(point)) {
+            lv_chart_set_all_value(titrationChart, titrationSeries, LV_CHART_POINT_NONE);
+        }
+
+        // the x axis grows a ml at a time
+        const lv_coord_t maxML = (titrationCurve.maxReagentML() / reading_store::SERIES_SCALE + 1) * reading_store::SERIES_SCALE;
+        if (maxML != titrationMaxML) {
+            lv_chart_set_range(titrationChart, LV_CHART_AXIS_PRIMARY_X, 0, maxML);
+            titrationMaxML = maxML;
+        }
+
+        const auto& added = titrationCurve.points().back();
+        lv_chart_set_next_value2(titrationChart, titrationSeries, added.reagentML, added.pH);
     }
 }
 
@@ -305,11 +604,13 @@ void updateDisplay(std::shared_ptr<reading_store::ReadingStore> readingStore) {
     auto alkReadings = readingStore->getReadingsSortedByAsOf();
 
     refreshTriggerList(readingStore->getRecentTitles(alkReadings));
-    refreshReadingList(alkReadings);
+    refreshReadingList(alkReadings, readingStore->getTipIndex(), readingStore->getReadingsToKeep());
+    refreshTrendChart(alkReadings);
 }
 
 void setupDisplay(std::shared_ptr<reading_store::ReadingStore> readingStore, std::shared_ptr<mqtt::Publisher> pub) {
     publisher = pub;
+    chartReadingStore = readingStore;
 
     enableDisplayHardware();
     tftSetup();
@@ -334,8 +635,40 @@ void renderTime(char* temp, size_t bufferSize, const unsigned long timeInSec) {
     strftime(temp, bufferSize, "%H:%M:%S", dt);
 }
 
-void displayPH(const float rawPH, const float calibratedPH, const float rawPH_mvag, const float calibratedPH_mvag, const ulong asOfMS, const unsigned long asOfAdjustedSec) {
-    if (!displaySetupFully) {
+/***************
+ * pH
+ * Readings come in every second, they're kept as pending and drawn at most
+ * every PH_REFRESH_INTERVAL_MS, only touching the labels whose text changed.
+ ***************/
+static const unsigned long PH_REFRESH_INTERVAL_MS = 1000;
+
+enum PHField {
+    PH_FIELD,
+    DEBUG_PH_FIELD,
+    TIME_FIELD,
+    PH_FIELD_COUNT
+};
+
+struct PendingPH {
+    float rawPH;
+    float calibratedPH;
+    float rawPH_mvag;
+    float calibratedPH_mvag;
+    unsigned long asOfAdjustedSec;
+};
+
+static PendingPH pendingPH;
+static TextCache phTexts(PH_FIELD_COUNT);
+static RefreshLimiter phRefreshLimiter(PH_REFRESH_INTERVAL_MS);
+
+void setLabelIfChanged(lv_obj_t* label, const PHField field, const char* text) {
+    if (phTexts.changed(field, text)) {
+        lv_label_set_text(label, text);
+    }
+}
+
+void renderPHIfDue() {
+    if (!phRefreshLimiter.shouldRefresh(buff_time::monotonicMS())) {
         return;
     }
 
@@ -343,20 +676,46 @@ void displayPH(const float rawPH, const float calibratedPH, const float rawPH_mv
     char buf[bufSize];
 
     // ph
-    sprintf(buf, "ph: %2.1f", calibratedPH_mvag);
-    lv_label_set_text(phLabel, buf);
+    snprintf(buf, bufSize, "ph: %2.1f", pendingPH.calibratedPH_mvag);
+    setLabelIfChanged(phLabel, PH_FIELD, buf);
 
     // debug ph 🕑
-    sprintf(buf, "ph: %2.1f (%2.1f), rawPH: %2.1f (%2.1f)", calibratedPH, calibratedPH_mvag, rawPH, rawPH_mvag);
-    lv_label_set_text(debugRawPHLabel, buf);
+    snprintf(buf, bufSize, "ph: %2.1f (%2.1f), rawPH: %2.1f (%2.1f)", pendingPH.calibratedPH, pendingPH.calibratedPH_mvag, pendingPH.rawPH, pendingPH.rawPH_mvag);
+    setLabelIfChanged(debugRawPHLabel, DEBUG_PH_FIELD, buf);
 
     // time
-    renderTime(buf, bufSize, asOfAdjustedSec);
-    lv_label_set_text(timeLabel, buf);
+    renderTime(buf, bufSize, pendingPH.asOfAdjustedSec);
+    setLabelIfChanged(timeLabel, TIME_FIELD, buf);
+}
+
+void displayPH(const float rawPH, const float calibratedPH, const float rawPH_mvag, const float calibratedPH_mvag, const uint64_t asOfMS, const unsigned long asOfAdjustedSec) {
+    if (!displaySetupFully) {
+        return;
+    }
+
+    pendingPH = {rawPH, calibratedPH, rawPH_mvag, calibratedPH_mvag, asOfAdjustedSec};
+    phRefreshLimiter.markPending();
+    renderPHIfDue();
 }
 
 void loopDisplay() {
+    if (displaySetupFully) {
+        renderPHIfDue();
+        drainTitrationPoints();
+    }
     lv_timer_handler();
+    // the last band of a refresh finishes while the task sleeps, hand it back
+    finishFlush(false);
+}
+
+// LCD_EN drives the backlight, active low
+void setBacklight(const uint8_t brightness) {
+    analogWrite(LCD_EN, 255 - brightness);
+    backlightOff = brightness == 0;
+}
+
+void setTouchCallback(std::function<void()> callback) {
+    touchCallback = callback;
 }
 
 }  // namespace monitoring_display
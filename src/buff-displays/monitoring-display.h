@@ -1,7 +1,9 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 
+#include "readings/reading-series.h"
 #include "readings/reading-store.h"
 #include "mqtt-publish.h"
 
@@ -9,10 +11,17 @@ namespace buff {
 namespace monitoring_display {
 
 void setupDisplay(std::shared_ptr<reading_store::ReadingStore> readingStore, std::shared_ptr<mqtt::Publisher> publisher);
-void displayPH(const float pH, const float convertedPH, const float rawPH_mvag, const float calibratedPH_mvag, const ulong asOfMS, const unsigned long asOfAdjustedSec);
+void displayPH(const float pH, const float convertedPH, const float rawPH_mvag, const float calibratedPH_mvag, const uint64_t asOfMS, const unsigned long asOfAdjustedSec);
 void loopDisplay();
+// 0 is off, 255 full brightness. Safe to call from the control task, a
+// display on a shared bus picks it up in loopDisplay
+void setBacklight(const uint8_t brightness);
+// called from loopDisplay on each touch, eg to wake up from idle
+void setTouchCallback(std::function<void()> callback);
 
 void updateDisplay(std::shared_ptr<reading_store::ReadingStore> readingStore);
+// safe to call from the control task, picked up by loopDisplay
+void recordTitrationPoint(const reading_store::TitrationPoint& point);
 
 }  // namespace monitoring_display
 }  // namespace buff
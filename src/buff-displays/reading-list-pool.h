@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace buff {
+namespace monitoring_display {
+
+/*******************************
+ * RowWidgets
+ * The display side of a ReadingListPool, one widget per slot, all created up
+ * front. Slots are indexes into that fixed set, not positions on screen.
+ *******************************/
+class RowWidgets {
+   public:
+    // makes the slot's widget the first row
+    virtual void moveToTop(const size_t slot) = 0;
+    virtual void setText(const size_t slot, const std::string& text) = 0;
+    virtual void setVisible(const size_t slot, const bool visible) = 0;
+
+    virtual ~RowWidgets() {}
+};
+
+/*******************************
+ * ReadingListPool
+ * Keeps a newest-first list of rows on a fixed pool of widgets, so updates
+ * never create or delete objects (LVGL's fixed heap fragments after weeks of
+ * that). Rows are diffed against what's already on screen: new readings,
+ * counted from the ReadingStore's tip index, recycle the bottom widgets to the
+ * top and everything else only gets text it didn't already have.
+ *
+ * The tip index only saves work; the text diff alone keeps the screen right,
+ * eg after the store is reloaded.
+ *******************************/
+class ReadingListPool {
+   private:
+    const size_t _slots;
+    // on screen order, _order[row] is the slot showing that row
+    std::vector<size_t> _order;
+    std::vector<std::string> _slotText;
+    std::vector<bool> _slotVisible;
+
+    bool _rendered = false;
+    size_t _lastTipIndex = 0;
+
+   public:
+    ReadingListPool(const size_t slots) : _slots(slots), _order(slots), _slotText(slots), _slotVisible(slots, false) {
+        for (size_t i = 0; i < slots; i++) {
+            _order[i] = i;
+        }
+    }
+
+    // rows newest first, anything past the pool size is dropped
+    void update(const std::vector<std::string>& rows, const size_t tipIndex, const size_t storeSize, RowWidgets& widgets) {
+        if (_rendered && storeSize > 0) {
+            const size_t added = (tipIndex + storeSize - _lastTipIndex) % storeSize;
+            // the oldest rows scroll off, so their widgets take the new ones
+            if (added > 0 && added < _slots) {
+                for (size_t i = 0; i < added; i++) {
+                    const size_t slot = _order.back();
+                    widgets.moveToTop(slot);
+                    std::rotate(_order.rbegin(), _order.rbegin() + 1, _order.rend());
+                }
+            }
+        }
+
+        const size_t shown = std::min(rows.size(), _slots);
+        for (size_t row = 0; row < _slots; row++) {
+            const size_t slot = _order[row];
+            const bool visible = row < shown;
+            if (visible && _slotText[slot] != rows[row]) {
+                _slotText[slot] = rows[row];
+                widgets.setText(slot, rows[row]);
+            }
+            if (_slotVisible[slot] != visible) {
+                _slotVisible[slot] = visible;
+                widgets.setVisible(slot, visible);
+            }
+        }
+
+        _lastTipIndex = tipIndex;
+        _rendered = true;
+    }
+
+    size_t slotForRow(const size_t row) const { return _order[row]; }
+    const std::string& rowText(const size_t row) const { return _slotText[_order[row]]; }
+};
+
+/*******************************
+ * ChangedOptions
+ * Remembers the last options string given to a roller (or the like), so it's
+ * only rebuilt when they actually change.
+ *******************************/
+class ChangedOptions {
+   private:
+    std::string _options;
+    bool _set = false;
+
+   public:
+    // true when options differ from last time
+    bool update(const std::string& options) {
+        if (_set && options == _options) return false;
+        _options = options;
+        _set = true;
+        return true;
+    }
+};
+
+}  // namespace monitoring_display
+}  // namespace buff
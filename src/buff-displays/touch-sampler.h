@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+
+namespace buff {
+namespace monitoring_display {
+
+struct TouchSample {
+    bool pressed = false;
+    // the last pressed position, kept through the release like LVGL wants
+    uint16_t x = 0;
+    uint16_t y = 0;
+};
+
+struct TouchSamplerConfig {
+    // between reads while nothing's pressed, when there's no pen IRQ to say so
+    unsigned long idleIntervalMS = 100;
+    // between reads while pressed, for dragging
+    unsigned long pressedIntervalMS = 20;
+    // consecutive reads before a press or a release counts
+    unsigned int pressSamples = 2;
+    unsigned int releaseSamples = 2;
+};
+
+/*******************************
+ * TouchSampler
+ * Sits between LVGL's input polling and the touch controller, which shares
+ * the SPI bus with the display. LVGL gets the cached, filtered result on
+ * every poll; the controller's only read when it could be pressed (the pen
+ * IRQ's down, or latched since the last read) and no faster than the
+ * interval for the current state. Presses & releases are debounced and
+ * positions smoothed, so a noisy read doesn't turn into a click.
+ *
+ * Without an IRQ pin penMaybeDown is just always true.
+ *******************************/
+class TouchSampler {
+   public:
+    // true & the position when pressed
+    typedef std::function<bool(uint16_t &x, uint16_t &y)> ReadFunc;
+
+   private:
+    const TouchSamplerConfig _config;
+
+    TouchSample _current;
+    uint64_t _lastReadMS = 0;
+    bool _read = false;
+
+    unsigned int _pressStreak = 0;
+    unsigned int _releaseStreak = 0;
+    // smoothed position of the touch in progress
+    uint32_t _filteredX = 0;
+    uint32_t _filteredY = 0;
+
+    unsigned int _reads = 0;
+
+    void addSample(const bool pressed, const uint16_t x, const uint16_t y) {
+        if (pressed) {
+            if (_pressStreak == 0) {
+                _filteredX = x;
+                _filteredY = y;
+            } else {
+                _filteredX = (_filteredX + x) / 2;
+                _filteredY = (_filteredY + y) / 2;
+            }
+            _pressStreak++;
+            _releaseStreak = 0;
+
+            if (_current.pressed || _pressStreak >= _config.pressSamples) {
+                _current.pressed = true;
+                _current.x = _filteredX;
+                _current.y = _filteredY;
+            }
+        } else {
+            _releaseStreak++;
+            _pressStreak = 0;
+            if (_releaseStreak >= _config.releaseSamples) {
+                _current.pressed = false;
+            }
+        }
+    }
+
+    // anything part way through a press or a release
+    bool settling() const {
+        return _pressStreak > 0 && !_current.pressed;
+    }
+
+   public:
+    TouchSampler(const TouchSamplerConfig config = TouchSamplerConfig()) : _config(config) {}
+
+    const TouchSample &sample(const uint64_t nowMS, const bool penMaybeDown, ReadFunc read) {
+        if (!penMaybeDown) {
+            // the IRQ says it's up, no need to ask over SPI
+            if (_current.pressed || settling()) {
+                addSample(false, 0, 0);
+            }
+            return _current;
+        }
+
+        const unsigned long intervalMS = _current.pressed || settling() ? _config.pressedIntervalMS : _config.idleIntervalMS;
+        if (_read && nowMS - _lastReadMS < intervalMS) {
+            return _current;
+        }
+
+        uint16_t x = 0;
+        uint16_t y = 0;
+        const bool pressed = read(x, y);
+        _lastReadMS = nowMS;
+        _read = true;
+        _reads++;
+
+        addSample(pressed, x, y);
+        return _current;
+    }
+
+    const TouchSample &current() const { return _current; }
+    // how often the controller was actually read
+    unsigned int reads() const { return _reads; }
+};
+
+}  // namespace monitoring_display
+}  // namespace buff
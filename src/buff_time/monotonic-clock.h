@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <Arduino.h>
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <esp_timer.h>
+#endif
+
+namespace buff {
+namespace buff_time {
+
+/*******************************
+ * MillisExtender
+ * Widens a wrapping 32-bit millisecond counter to 64 bits, by counting how
+ * many times it's gone backwards. Has to be fed at least once per wrap
+ * (~49.7 days), and from one task.
+ *******************************/
+class MillisExtender {
+   private:
+    uint32_t _lastMS = 0;
+    uint32_t _wraps = 0;
+
+   public:
+    uint64_t extend(const uint32_t nowMS) {
+        if (nowMS < _lastMS) {
+            _wraps++;
+        }
+        _lastMS = nowMS;
+        return ((uint64_t)_wraps << 32) | nowMS;
+    }
+};
+
+/*******************************
+ * monotonicMS
+ * Milliseconds since boot, without millis()'s 32-bit wrap. Use it for
+ * anything scheduled or compared across loops; millis() is still fine for
+ * short durations measured with unsigned subtraction.
+ *******************************/
+inline uint64_t monotonicMS() {
+#ifdef ARDUINO_ARCH_ESP32
+    // 64-bit microseconds, doesn't wrap for ~292k years
+    return esp_timer_get_time() / 1000;
+#else
+    static MillisExtender extender;
+    return extender.extend(millis());
+#endif
+}
+
+}  // namespace buff_time
+}  // namespace buff
@@ -1,50 +1,106 @@
-// based on https://github.com/PaulStoffregen/Time/blob/master/examples/TimeNTP_ESP8266WiFi/TimeNTP_ESP8266WiFi.ino
 #pragma once
 
-#include <NTPClient.h>
-#include "time-common.h"
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <lwip/dns.h>
 
+#include <atomic>
 #include <memory>
 
+// Buff Libraries
+#include "sntp-client.h"
+#include "time-common.h"
+
 namespace ntp {
 
-WiFiUDP ntpUDP;
+const char *const NTP_SERVER = "pool.ntp.org";
+const uint16_t NTP_PORT = 123;
+const uint16_t NTP_LOCAL_PORT = 2390;
 
-std::unique_ptr<NTPClient> setupNTP() {
-    auto timeClient = std::make_unique<NTPClient>(ntpUDP);
+/*******************************
+ * WiFiUDPTransport
+ * WiFiUDP's hostname beginPacket does a blocking DNS lookup, so the server
+ * is resolved through lwIP's async dns_gethostbyname instead and sends are
+ * refused until the answer's in.
+ *******************************/
+class WiFiUDPTransport : public buff::buff_time::SNTPTransport {
+   private:
+    const char *_host;
+    WiFiUDP _udp;
+    bool _begun = false;
 
-    Serial.println("Setting up ntp client");
-    timeClient->setUpdateInterval(1000 * 60 * 30);
-    timeClient->begin();
-    timeClient->setTimeOffset(0);
-
-    const int num_tries = 5;
-    for (int i = 0; i < num_tries && !timeClient->update(); i++) {
-        timeClient->forceUpdate();
-        delay(1000);
+    ip_addr_t _resolved;
+    std::atomic<bool> _resolving{false};
+    std::atomic<bool> _hasAddress{false};
+
+    // on the lwIP task
+    static void onResolved(const char *name, const ip_addr_t *ipaddr, void *arg) {
+        auto *self = static_cast<WiFiUDPTransport *>(arg);
+        if (ipaddr != nullptr) {
+            self->_resolved = *ipaddr;
+            self->_hasAddress = true;
+        }
+        self->_resolving = false;
     }
 
-    Serial.println("Current time: ");
-    Serial.println(timeClient->getFormattedTime());
+    bool resolve() {
+        if (_hasAddress) return true;
+        if (_resolving) return false;
 
-    return std::move(timeClient);
-}
+        _resolving = true;
+        const err_t err = dns_gethostbyname(_host, &_resolved, onResolved, this);
+        if (err == ERR_OK) {
+            // cached
+            _hasAddress = true;
+            _resolving = false;
+        } else if (err != ERR_INPROGRESS) {
+            _resolving = false;
+        }
+        return _hasAddress;
+    }
 
-void loopNTP(std::shared_ptr<NTPClient> timeClient) {
-    // this will trigger a time refresh if needed
-    // WARNING: this is sync and blocking
-    timeClient->update();
-}
+   public:
+    WiFiUDPTransport(const char *host) : _host(host) {}
 
-class NTPTimeWrapper : public buff::buff_time::TimeWrapper {
-   private:
-    const std::shared_ptr<NTPClient> _timeClient;
+    bool send(const uint8_t *packet, const size_t len) override {
+        if (WiFi.status() != WL_CONNECTED || !resolve()) return false;
+        if (!_begun) {
+            _begun = _udp.begin(NTP_LOCAL_PORT);
+            if (!_begun) return false;
+        }
 
-   public:
-    NTPTimeWrapper(std::shared_ptr<NTPClient> timeClient): _timeClient(timeClient) {}
-    virtual unsigned long getAdjustedTimeSeconds() {
-        return _timeClient->getEpochTime();
+        _udp.beginPacket(IPAddress(ip_addr_get_ip4_u32(&_resolved)), NTP_PORT);
+        _udp.write(packet, len);
+        if (!_udp.endPacket()) {
+            // eg the address went stale, look it up again next time
+            _hasAddress = false;
+            return false;
+        }
+        return true;
+    }
+
+    size_t receive(uint8_t *packet, const size_t maxLen) override {
+        if (!_begun || _udp.parsePacket() <= 0) return 0;
+        const int len = _udp.read(packet, maxLen);
+        return len > 0 ? len : 0;
     }
 };
 
+// Doesn't touch the network, the first request goes out from loopNTP
+std::shared_ptr<buff::buff_time::AsyncSNTPClock> setupNTP() {
+    Serial.println("Setting up ntp client");
+    return std::make_shared<buff::buff_time::AsyncSNTPClock>(std::make_shared<WiFiUDPTransport>(NTP_SERVER));
+}
+
+void loopNTP(std::shared_ptr<buff::buff_time::AsyncSNTPClock> clock) {
+    const bool wasSynced = clock->synced();
+    clock->loop(millis());
+    if (!wasSynced && clock->synced()) {
+        Serial.print("NTP synced, epochSec=");
+        Serial.print(clock->getAdjustedTimeSeconds());
+        Serial.print(", roundTripMS=");
+        Serial.println(clock->lastRoundTripMS());
+    }
+}
+
 }  // namespace ntp
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+
+// Buff Libraries
+#include "time-common.h"
+
+namespace buff {
+namespace buff_time {
+
+const size_t SNTP_PACKET_SIZE = 48;
+// 1900-01-01 (NTP era 0) -> 1970-01-01
+const uint64_t NTP_UNIX_OFFSET_SEC = 2208988800ULL;
+
+/*******************************
+ * SNTPTransport
+ * A non-blocking UDP socket to the time server. Neither call may wait on
+ * the network: send returns false if it can't go out right now (eg the
+ * server name hasn't resolved yet), receive returns 0 if nothing's arrived.
+ *******************************/
+class SNTPTransport {
+   public:
+    virtual bool send(const uint8_t *packet, const size_t len) = 0;
+    // bytes read into packet
+    virtual size_t receive(uint8_t *packet, const size_t maxLen) = 0;
+
+    virtual ~SNTPTransport() {}
+};
+
+struct SNTPConfig {
+    // between successful syncs
+    unsigned long syncIntervalMS = 30 * 60 * 1000;
+    // after a failed or timed out request, and until the first sync
+    unsigned long retryIntervalMS = 5000;
+    unsigned long responseTimeoutMS = 2000;
+    // weight of each new drift measurement
+    float driftSmoothing = 0.3;
+};
+
+/*******************************
+ * AsyncSNTPClock
+ * Keeps wall clock time without ever blocking: loop() sends an SNTP request
+ * when one's due and picks up the response on a later pass. Each response
+ * re-anchors a millis() -> wall clock mapping, and consecutive syncs give
+ * an estimate of how fast millis() drifts, so getAdjustedTimeSeconds is just
+ * arithmetic on the cached mapping.
+ *
+ * Until the first sync, time is seconds since boot.
+ *
+ * loop() is for one task, reads are safe from any: the mapping is double
+ * buffered and swapped atomically.
+ *******************************/
+class AsyncSNTPClock : public TimeWrapper {
+   private:
+    struct Mapping {
+        bool synced = false;
+        uint32_t localAtSyncMS = 0;
+        int64_t wallAtSyncMS = 0;
+        // how far off millis() runs, in parts per million (+ve is millis() slow)
+        float driftPPM = 0;
+    };
+
+    enum State {
+        IDLE,
+        AWAITING_RESPONSE,
+    };
+
+    const std::shared_ptr<SNTPTransport> _transport;
+    const SNTPConfig _config;
+
+    Mapping _mappings[2];
+    std::atomic<uint8_t> _activeMapping{0};
+
+    State _state = IDLE;
+    bool _everAttempted = false;
+    unsigned long _nextAttemptAtMS = 0;
+    uint32_t _sentAtMS = 0;
+    // echoed back by the server as the originate timestamp, so stale or
+    // spoofed responses can be told apart from the one we're waiting on
+    uint8_t _requestTransmitTimestamp[8] = {};
+    uint32_t _requestCount = 0;
+
+    unsigned int _syncCount = 0;
+    unsigned int _failureCount = 0;
+    uint32_t _lastRoundTripMS = 0;
+
+    static uint32_t readUint32(const uint8_t *bytes) {
+        return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+    }
+
+    static void writeUint32(uint8_t *bytes, const uint32_t value) {
+        bytes[0] = value >> 24;
+        bytes[1] = value >> 16;
+        bytes[2] = value >> 8;
+        bytes[3] = value;
+    }
+
+    const Mapping &activeMapping() const {
+        return _mappings[_activeMapping.load(std::memory_order_acquire)];
+    }
+
+    void publishMapping(const Mapping &mapping) {
+        const uint8_t next = 1 - _activeMapping.load(std::memory_order_relaxed);
+        _mappings[next] = mapping;
+        _activeMapping.store(next, std::memory_order_release);
+    }
+
+    void sendRequest(const unsigned long nowMS) {
+        uint8_t packet[SNTP_PACKET_SIZE] = {};
+        // LI = 0, version 4, mode 3 (client)
+        packet[0] = 0b00100011;
+
+        // not a real timestamp, just has to be unique per request
+        _requestCount++;
+        writeUint32(_requestTransmitTimestamp, nowMS);
+        writeUint32(_requestTransmitTimestamp + 4, _requestCount);
+        memcpy(packet + 40, _requestTransmitTimestamp, sizeof(_requestTransmitTimestamp));
+
+        _everAttempted = true;
+        if (!_transport->send(packet, sizeof(packet))) {
+            _nextAttemptAtMS = nowMS + _config.retryIntervalMS;
+            return;
+        }
+        _sentAtMS = nowMS;
+        _state = AWAITING_RESPONSE;
+    }
+
+    void fail(const unsigned long nowMS) {
+        _failureCount++;
+        _state = IDLE;
+        _nextAttemptAtMS = nowMS + _config.retryIntervalMS;
+    }
+
+    // false if it isn't a usable reply to the outstanding request
+    bool handleResponse(const uint8_t *packet, const size_t len, const unsigned long nowMS) {
+        if (len < SNTP_PACKET_SIZE) return false;
+
+        const uint8_t leapIndicator = packet[0] >> 6;
+        const uint8_t mode = packet[0] & 0b111;
+        const uint8_t stratum = packet[1];
+        // 3 is unsynchronized, stratum 0 is a kiss-o'-death
+        if (leapIndicator == 3 || mode != 4 || stratum == 0) return false;
+        if (memcmp(packet + 24, _requestTransmitTimestamp, sizeof(_requestTransmitTimestamp)) != 0) return false;
+
+        const uint32_t seconds = readUint32(packet + 40);
+        const uint32_t fraction = readUint32(packet + 44);
+        // anything before 1970 has to be past the 2036 rollover (era 1)
+        const uint64_t unixSeconds = seconds >= NTP_UNIX_OFFSET_SEC ? seconds - NTP_UNIX_OFFSET_SEC : seconds + (1ULL << 32) - NTP_UNIX_OFFSET_SEC;
+
+        const int64_t serverTransmitMS = (int64_t)unixSeconds * 1000 + (((uint64_t)fraction * 1000 + (1ULL << 31)) >> 32);
+        // assume the reply took half the round trip to get back
+        _lastRoundTripMS = nowMS - _sentAtMS;
+        const int64_t wallNowMS = serverTransmitMS + _lastRoundTripMS / 2;
+
+        const Mapping &previous = activeMapping();
+        Mapping next;
+        next.synced = true;
+        next.localAtSyncMS = nowMS;
+        next.wallAtSyncMS = wallNowMS;
+        next.driftPPM = previous.driftPPM;
+        if (previous.synced) {
+            const uint32_t elapsedLocalMS = nowMS - previous.localAtSyncMS;
+            const int64_t elapsedWallMS = wallNowMS - previous.wallAtSyncMS;
+            if (elapsedLocalMS > 0) {
+                const float measuredPPM = (float)(elapsedWallMS - (int64_t)elapsedLocalMS) * 1e6f / elapsedLocalMS;
+                next.driftPPM = previous.driftPPM + _config.driftSmoothing * (measuredPPM - previous.driftPPM);
+            }
+        }
+        publishMapping(next);
+
+        _syncCount++;
+        _state = IDLE;
+        _nextAttemptAtMS = nowMS + _config.syncIntervalMS;
+        return true;
+    }
+
+   public:
+    AsyncSNTPClock(std::shared_ptr<SNTPTransport> transport, const SNTPConfig config = SNTPConfig()) : _transport(transport), _config(config) {}
+
+    // Never blocks, call every loop
+    void loop(const unsigned long nowMS) {
+        if (_state == AWAITING_RESPONSE) {
+            uint8_t packet[SNTP_PACKET_SIZE + 16];
+            size_t len;
+            while ((len = _transport->receive(packet, sizeof(packet))) > 0) {
+                if (handleResponse(packet, len, nowMS)) return;
+            }
+            if (nowMS - _sentAtMS >= _config.responseTimeoutMS) {
+                fail(nowMS);
+            }
+            return;
+        }
+
+        if (!_everAttempted || (long)(nowMS - _nextAttemptAtMS) >= 0) {
+            sendRequest(nowMS);
+        }
+    }
+
+    // Unix time in ms as of nowMS (a millis() value)
+    int64_t adjustedTimeMS(const unsigned long nowMS) const {
+        const Mapping &mapping = activeMapping();
+        if (!mapping.synced) {
+            return nowMS;
+        }
+        const uint32_t elapsedMS = nowMS - mapping.localAtSyncMS;
+        return mapping.wallAtSyncMS + elapsedMS + (int64_t)(elapsedMS * mapping.driftPPM / 1e6f);
+    }
+
+    unsigned long getAdjustedTimeSeconds() override {
+        return adjustedTimeMS(millis()) / 1000;
+    }
+
+    bool synced() const { return activeMapping().synced; }
+    float driftPPM() const { return activeMapping().driftPPM; }
+    unsigned int syncCount() const { return _syncCount; }
+    unsigned int failureCount() const { return _failureCount; }
+    uint32_t lastRoundTripMS() const { return _lastRoundTripMS; }
+};
+
+}  // namespace buff_time
+}  // namespace buff
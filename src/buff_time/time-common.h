@@ -2,6 +2,9 @@
 
 #include <Arduino.h>
 
+// Buff Libraries
+#include "monotonic-clock.h"
+
 namespace buff {
 namespace buff_time {
 class TimeWrapper {
@@ -9,6 +12,11 @@ class TimeWrapper {
     virtual unsigned long getAdjustedTimeSeconds() {
         return millis();
     }
+
+    // for scheduling & ordering, see monotonicMS
+    virtual uint64_t getMonotonicMS() {
+        return monotonicMS();
+    }
 };
 
 }
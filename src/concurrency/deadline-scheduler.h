@@ -0,0 +1,131 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace buff {
+namespace concurrency {
+
+/*******************************
+ * DeadlineScheduler
+ * Runs a task's subsystems off a min-heap of deadlines instead of polling
+ * each one every loop. A job returns how long until it next wants to run
+ * (fixed delay, from when it ran), so the task can sleep until
+ * nextDeadlineMS() and be woken early by I/O through wake().
+ *
+ * Time is passed in, so tests can drive it from a virtual clock. Not thread
+ * safe, one scheduler per task.
+ *******************************/
+class DeadlineScheduler {
+   public:
+    // ms until the job next wants to run, 0 for the next runDue
+    typedef std::function<unsigned long(const uint64_t nowMS)> Job;
+
+   private:
+    struct Entry {
+        const char *name;
+        Job job;
+        uint64_t deadlineMS;
+        // bumped when the deadline moves, so the old heap item is skipped
+        uint32_t generation;
+    };
+
+    struct HeapItem {
+        uint64_t deadlineMS;
+        size_t id;
+        uint32_t generation;
+
+        // earliest on top, ties in the order jobs were added
+        bool operator>(const HeapItem &other) const {
+            if (deadlineMS != other.deadlineMS) return deadlineMS > other.deadlineMS;
+            return id > other.id;
+        }
+    };
+
+    std::vector<Entry> _entries;
+    std::vector<HeapItem> _heap;
+    std::vector<size_t> _ranThisPass;
+
+    void schedule(const size_t id, const uint64_t deadlineMS) {
+        auto &entry = _entries[id];
+        entry.deadlineMS = deadlineMS;
+        entry.generation++;
+        _heap.push_back({deadlineMS, id, entry.generation});
+        std::push_heap(_heap.begin(), _heap.end(), std::greater<HeapItem>());
+    }
+
+    bool isStale(const HeapItem &item) const {
+        return item.generation != _entries[item.id].generation;
+    }
+
+    void dropStale() {
+        while (!_heap.empty() && isStale(_heap.front())) {
+            std::pop_heap(_heap.begin(), _heap.end(), std::greater<HeapItem>());
+            _heap.pop_back();
+        }
+    }
+
+   public:
+    // name has to outlive the scheduler (a literal), returns the job's id
+    size_t add(const char *name, Job job, const uint64_t firstRunAtMS = 0) {
+        _entries.push_back({name, job, 0, 0});
+        const size_t id = _entries.size() - 1;
+        schedule(id, firstRunAtMS);
+        return id;
+    }
+
+    // Pulls a job forward to atMS, eg when a message arrives for it. A job
+    // already due sooner is left alone.
+    void wake(const size_t id, const uint64_t atMS) {
+        if (id >= _entries.size() || _entries[id].deadlineMS <= atMS) return;
+        schedule(id, atMS);
+    }
+
+    // Runs every job due by nowMS, earliest deadline first. Each runs at most
+    // once per call, so a job that always returns 0 can't starve the rest.
+    // Returns how many ran.
+    size_t runDue(const uint64_t nowMS) {
+        _ranThisPass.clear();
+        while (true) {
+            dropStale();
+            if (_heap.empty() || _heap.front().deadlineMS > nowMS) break;
+
+            const size_t id = _heap.front().id;
+            std::pop_heap(_heap.begin(), _heap.end(), std::greater<HeapItem>());
+            _heap.pop_back();
+
+            const unsigned long delayMS = _entries[id].job(nowMS);
+            _entries[id].deadlineMS = nowMS + delayMS;
+            _ranThisPass.push_back(id);
+        }
+
+        for (const auto id : _ranThisPass) {
+            schedule(id, _entries[id].deadlineMS);
+        }
+        return _ranThisPass.size();
+    }
+
+    // UINT64_MAX with nothing scheduled
+    uint64_t nextDeadlineMS() {
+        dropStale();
+        return _heap.empty() ? UINT64_MAX : _heap.front().deadlineMS;
+    }
+
+    // how long the task can sleep for, capped at maxMS
+    unsigned long msUntilNextDeadline(const uint64_t nowMS, const unsigned long maxMS) {
+        const uint64_t deadlineMS = nextDeadlineMS();
+        if (deadlineMS <= nowMS) return 0;
+        return std::min<uint64_t>(deadlineMS - nowMS, maxMS);
+    }
+
+    size_t jobCount() const { return _entries.size(); }
+    const char *jobName(const size_t id) const { return _entries[id].name; }
+    uint64_t jobDeadlineMS(const size_t id) const { return _entries[id].deadlineMS; }
+};
+
+}  // namespace concurrency
+}  // namespace buff
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+
+namespace buff {
+namespace concurrency {
+
+enum I2CPriority {
+    // eg display frames, happy to wait
+    I2C_LOW_PRIORITY,
+    // sensor reads, let in ahead of anything low priority that's waiting
+    I2C_HIGH_PRIORITY,
+    I2C_PRIORITY_COUNT
+};
+
+/*******************************
+ * I2CBus
+ * Arbitrates one I2C controller between tasks. Each transaction holds the bus
+ * at its own clock, so a 10kHz sensor and a 400kHz display can share it. When
+ * the bus frees up, a waiting high priority transaction always goes before
+ * the low priority ones; big low priority transfers should be split (eg a
+ * display page per transaction) so a sensor read never waits behind a whole
+ * frame.
+ *
+ * WireT is TwoWire on the board, only setClock is used here, the rest goes
+ * through wire() while a Transaction is held.
+ *******************************/
+template <typename WireT>
+class I2CBus {
+   private:
+    WireT &_wire;
+
+    std::mutex _mutex;
+    std::condition_variable _freed;
+    bool _held = false;
+    unsigned int _waiting[I2C_PRIORITY_COUNT] = {};
+
+    // 0 until the first transaction sets it
+    uint32_t _clockHz = 0;
+
+    unsigned int _transactions = 0;
+    unsigned int _contended = 0;
+
+    void acquire(const I2CPriority priority, const uint32_t clockHz) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _transactions++;
+        if (_held) _contended++;
+
+        _waiting[priority]++;
+        _freed.wait(lock, [&]() {
+            return !_held && (priority == I2C_HIGH_PRIORITY || _waiting[I2C_HIGH_PRIORITY] == 0);
+        });
+        _waiting[priority]--;
+        _held = true;
+
+        if (clockHz != _clockHz) {
+            _wire.setClock(clockHz);
+            _clockHz = clockHz;
+        }
+    }
+
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _held = false;
+        }
+        _freed.notify_all();
+    }
+
+   public:
+    /*******************************
+     * Transaction
+     * Holds the bus for its scope.
+     *******************************/
+    class Transaction {
+       private:
+        I2CBus &_bus;
+
+       public:
+        Transaction(I2CBus &bus, const I2CPriority priority, const uint32_t clockHz) : _bus(bus) {
+            _bus.acquire(priority, clockHz);
+        }
+        ~Transaction() { _bus.release(); }
+
+        Transaction(const Transaction &) = delete;
+        Transaction &operator=(const Transaction &) = delete;
+
+        WireT &wire() { return _bus._wire; }
+    };
+
+    I2CBus(WireT &wire) : _wire(wire) {}
+
+    // only to set it up, eg begin(), transfers go through a Transaction
+    WireT &wire() { return _wire; }
+
+    unsigned int waiting(const I2CPriority priority) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _waiting[priority];
+    }
+
+    uint32_t clockHz() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _clockHz;
+    }
+
+    unsigned int transactions() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _transactions;
+    }
+
+    // transactions that found the bus busy
+    unsigned int contended() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _contended;
+    }
+};
+
+}  // namespace concurrency
+}  // namespace buff
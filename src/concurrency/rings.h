@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+namespace buff {
+namespace concurrency {
+
+// keeps the producer & consumer indexes out of each other's cache line
+const size_t RING_INDEX_ALIGNMENT = 64;
+
+/*******************************
+ * SPSCRing
+ * Fixed capacity single producer / single consumer ring. The producer only
+ * writes _tail and the consumer only writes _head, so neither side ever
+ * waits on the other or takes a lock. Items are copied in & out by value.
+ *
+ * CAPACITY must be a power of 2, all of it is usable.
+ *******************************/
+template <typename T, size_t CAPACITY>
+class SPSCRing {
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of 2");
+
+   private:
+    static const size_t MASK = CAPACITY - 1;
+
+    T _items[CAPACITY];
+
+    // free running, wrap via MASK
+    alignas(RING_INDEX_ALIGNMENT) std::atomic<size_t> _head{0};
+    alignas(RING_INDEX_ALIGNMENT) std::atomic<size_t> _tail{0};
+
+   public:
+    // producer only
+    bool tryPush(const T &item) {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        _items[tail & MASK] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only
+    bool tryPop(T &item) {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = _items[head & MASK];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // only a snapshot when the other side is active
+    size_t size() const {
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return CAPACITY; }
+};
+
+/*******************************
+ * MPSCRing
+ * Fixed capacity multi producer / single consumer ring, for when several
+ * tasks or callbacks feed one consumer. Each slot carries a
+ * sequence number so a producer can claim a slot with one CAS on _tail and
+ * publish it without blocking the others (Vyukov's bounded queue).
+ *
+ * CAPACITY must be a power of 2, all of it is usable.
+ *******************************/
+template <typename T, size_t CAPACITY>
+class MPSCRing {
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of 2");
+
+   private:
+    static const size_t MASK = CAPACITY - 1;
+
+    struct Slot {
+        // == position: free for the producer claiming position
+        // == position + 1: holds the item for position
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    Slot _slots[CAPACITY];
+
+    alignas(RING_INDEX_ALIGNMENT) size_t _head = 0;
+    alignas(RING_INDEX_ALIGNMENT) std::atomic<size_t> _tail{0};
+
+   public:
+    MPSCRing() {
+        for (size_t i = 0; i < CAPACITY; i++) {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // any number of producers
+    bool tryPush(const T &item) {
+        size_t position = _tail.load(std::memory_order_relaxed);
+        Slot *slot;
+        while (true) {
+            slot = &_slots[position & MASK];
+            const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)sequence - (intptr_t)position;
+            if (diff == 0) {
+                if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // the consumer hasn't freed this slot yet
+                return false;
+            } else {
+                position = _tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->item = item;
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only
+    bool tryPop(T &item) {
+        Slot &slot = _slots[_head & MASK];
+        if (slot.sequence.load(std::memory_order_acquire) != _head + 1) {
+            // empty, or a producer has claimed the slot but not finished writing it
+            return false;
+        }
+        item = slot.item;
+        slot.sequence.store(_head + CAPACITY, std::memory_order_release);
+        _head++;
+        return true;
+    }
+
+    static constexpr size_t capacity() { return CAPACITY; }
+};
+
+}  // namespace concurrency
+}  // namespace buff
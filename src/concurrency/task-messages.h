@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+
+// Buff Libraries
+#include "concurrency/rings.h"
+
+namespace buff {
+namespace concurrency {
+
+/*******************************
+ * Messages between tasks
+ * Fixed size so they can be copied through a queue without touching the heap.
+ *******************************/
+const size_t MAX_TOPIC_LEN = 48;
+const size_t MAX_COMMAND_PAYLOAD_LEN = 384;
+const size_t MAX_OUTBOUND_PAYLOAD_LEN = 512;
+
+// copies src into dest, false if it didn't fit
+template <size_t N>
+static bool copyBounded(char (&dest)[N], const char *src, const size_t srcLen) {
+    if (srcLen >= N) {
+        return false;
+    }
+    memcpy(dest, src, srcLen);
+    dest[srcLen] = '\0';
+    return true;
+}
+
+// An MQTT message (or web trigger) for the control task to handle
+struct ControlCommand {
+    char topic[MAX_TOPIC_LEN];
+    char payload[MAX_COMMAND_PAYLOAD_LEN];
+
+    bool set(const std::string &t, const std::string &p) {
+        return copyBounded(topic, t.c_str(), t.size()) && copyBounded(payload, p.c_str(), p.size());
+    }
+};
+
+// A message for the network task to publish
+struct OutboundMessage {
+    char topic[MAX_TOPIC_LEN];
+    char payload[MAX_OUTBOUND_PAYLOAD_LEN];
+};
+
+const size_t CONTROL_COMMAND_QUEUE_DEPTH = 8;
+const size_t OUTBOUND_QUEUE_DEPTH = 16;
+
+// filled from MQTT callbacks & the web server, drained by the control task
+using ControlCommandQueue = MPSCRing<ControlCommand, CONTROL_COMMAND_QUEUE_DEPTH>;
+// filled by the control task, drained by the network task
+using OutboundQueue = SPSCRing<OutboundMessage, OUTBOUND_QUEUE_DEPTH>;
+
+}  // namespace concurrency
+}  // namespace buff
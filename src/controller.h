@@ -1,7 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <map>
 #include <memory>
+#include <set>
 // Arduino Libraries
 #include <ArduinoJson.h>
 #include <TinyMqtt.h>
@@ -9,9 +11,12 @@
 
 // Buff Libraries
 #include "buff-displays/monitoring-display.h"
+#include "concurrency/task-messages.h"
 #include "doser/doser.h"
 #include "inputs.h"
 #include "readings/alk-measure.h"
+#include "readings/alk-measure-checkpoint.h"
+#include "readings/ph-calibration-store.h"
 
 #ifdef BOARD_MKS_DLC32
 #include "mks-bridge.h"
@@ -19,6 +24,7 @@
 
 #include "mqtt-common.h"
 #include "mqtt.h"
+#include "power/idle-power.h"
 #include "readings/reading-store.h"
 #include "time-common.h"
 #include "web-server.h"
@@ -30,6 +36,11 @@ const unsigned int AUTO_PH_SAMPLE_COUNT = 15;
 const unsigned int MANUAL_PH_SAMPLE_COUNT = 10;
 const unsigned int ALK_STEP_INTERVAL_MS = 1000;
 
+const size_t MAX_CONTROL_COMMANDS_PER_LOOP = 2;
+// between loopControl passes with no measurement running, queued commands
+// wake the control task sooner
+const unsigned long CONTROL_IDLE_INTERVAL_MS = 1000;
+
 /*******************************
  * Handlers
  *******************************/
@@ -39,6 +50,7 @@ TopicProcessorMap topicsToProcessor;
 
 std::shared_ptr<alk_measure::AlkMeasurer> alkMeasurer = nullptr;
 std::shared_ptr<doser::BuffDosers> buffDosersPtr = nullptr;
+std::shared_ptr<ph::controller::PHReader> phReaderPtr = nullptr;
 std::shared_ptr<mqtt::Publisher> publisher = nullptr;
 std::shared_ptr<buff_time::TimeWrapper> timeClient = nullptr;
 
@@ -48,6 +60,28 @@ std::shared_ptr<reading_store::ReadingStore> readingStore;
 std::unique_ptr<alk_measure::AlkMeasureLooper<AUTO_PH_SAMPLE_COUNT>> autoMeasureLooper = nullptr;
 std::unique_ptr<alk_measure::AlkMeasureLooper<MANUAL_PH_SAMPLE_COUNT>> manualMeasureLooper = nullptr;
 
+/*******************************
+ * Tasks
+ * loopControl runs on the control task (dosers, sensors, measurement state),
+ * loopNetwork on the network task (MQTT, web, display). MQTT handlers that
+ * touch control state are queued over to the control task, the rest only
+ * touch the reading store & display and run where they're received.
+ *******************************/
+const std::set<std::string> NETWORK_TASK_TOPICS = {mqtt::phRead, mqtt::alkRead, mqtt::alkTraceRead};
+
+std::shared_ptr<concurrency::ControlCommandQueue> controlCommands = nullptr;
+richiev::mqtt::TopicProcessorMap controlHandlers;
+// notified whenever a command is queued, so it can sleep between deadlines
+TaskHandle_t controlTaskHandle = nullptr;
+// woken by queued commands, if set
+std::shared_ptr<power::IdlePowerManager> powerManager = nullptr;
+
+// written by the control task, read by the web server
+std::atomic<unsigned long> currentMeasurementDurationMS(0);
+
+// most recent pH read on the control task, used for calibration
+ph::PHReading latestPHReading;
+
 StaticJsonDocument<200> parseInput(const std::string payload) {
     StaticJsonDocument<200> doc;
     DeserializationError error = deserializeJson(doc, payload);
@@ -61,7 +95,7 @@ StaticJsonDocument<200> parseInput(const std::string payload) {
 
 ph::PHReading parsePH(const StaticJsonDocument<200> doc) {
     ph::PHReading reading = {
-        .asOfMS = doc["asOf"].as<ulong>(),
+        .asOfMS = doc["asOf"].as<uint64_t>(),
         .asOfAdjustedSec = doc["asOfAdjustedSec"].as<ulong>(),
 
         .rawPH = doc["rawPH"].as<float>(),
@@ -69,10 +103,44 @@ ph::PHReading parsePH(const StaticJsonDocument<200> doc) {
 
         .calibratedPH = doc["calibratedPH"].as<float>(),
         .calibratedPH_mavg = doc["calibratedPH_mavg"].as<float>()};
+    if (doc.containsKey("temperatureC")) {
+        reading.temperatureC = doc["temperatureC"].as<float>();
+    }
 
     return reading;
 }
 
+// The inverse of MQTTPublisher::publishMeasurementTrace
+alk_measure::MeasurementTrace parseMeasurementTrace(const JsonDocument& doc) {
+    alk_measure::MeasurementTrace trace;
+    trace.endedAtMS = doc["totalMS"].as<unsigned long>();
+
+    for (JsonPairConst phaseDoc : doc["phases"].as<JsonObjectConst>()) {
+        for (auto& actionAndName : alk_measure::MEASUREMENT_ACTION_TO_NAME) {
+            if (actionAndName.second != phaseDoc.key().c_str()) continue;
+            auto& phase = trace.phases[actionAndName.first];
+            phase.durationMS = phaseDoc.value()[0].as<unsigned long>();
+            phase.busyMS = phaseDoc.value()[1].as<unsigned long>();
+            phase.steps = phaseDoc.value()[2].as<unsigned int>();
+        }
+    }
+    trace.measureSteps[alk_measure::DOSE] = doc["doseSteps"].as<unsigned int>();
+    trace.measureSteps[alk_measure::MEASURE_PH] = doc["measurePHSteps"].as<unsigned int>();
+
+    trace.doserCalls = doc["doser"]["calls"].as<unsigned int>();
+    trace.doserBusyTotalMS = doc["doser"]["totalMS"].as<unsigned long>();
+    trace.doserBusyMaxMS = doc["doser"]["maxMS"].as<unsigned long>();
+    for (size_t bucket = 0; bucket < alk_measure::DOSER_BUSY_BUCKETS; bucket++) {
+        trace.doserBusyBuckets[bucket] = doc["doser"]["buckets"][bucket].as<unsigned int>();
+    }
+
+    trace.decisions = doc["phSamples"]["decisions"].as<unsigned int>();
+    trace.phSamplesPerDecisionMin = doc["phSamples"]["min"].as<unsigned int>();
+    trace.phSamplesPerDecisionMax = doc["phSamples"]["max"].as<unsigned int>();
+    trace.phSamplesTotal = doc["phSamples"]["total"].as<unsigned int>();
+    return trace;
+}
+
 void debugOutputPH(const ph::PHReading& reading) {
     monitoring_display::displayPH(reading.rawPH, reading.calibratedPH, reading.rawPH_mavg, reading.calibratedPH_mavg, reading.asOfMS, reading.asOfAdjustedSec);
 }
@@ -116,9 +184,9 @@ std::shared_ptr<doser::Doser> selectDoser(doser::BuffDosers& buffDosers, const S
     return buffDosers.selectDoser(measurementDoserType);
 }
 
-unsigned long lastMeasureAsOf = 0;
+uint64_t lastMeasureAsOf = 0;
 
-void runAfterIdempotenceCheck(const unsigned long asOf, std::function<void()> f) {
+void runAfterIdempotenceCheck(const uint64_t asOf, std::function<void()> f) {
     if (asOf <= lastMeasureAsOf) {
         Serial.print("Refusing to trigger because of time mismatch (idempotence check). asOf=");
         Serial.print(asOf);
@@ -130,6 +198,39 @@ void runAfterIdempotenceCheck(const unsigned long asOf, std::function<void()> f)
     }
 }
 
+// the manual looper's kept around once it's done, so check where it's at
+bool manualMeasurementInProgress() {
+    return manualMeasureLooper != nullptr && manualMeasureLooper->getLastStepResult().nextAction != alk_measure::MEASURE_DONE;
+}
+
+void beginAutoMeasurement(const alk_measure::AlkMeasurementConfig& alkMeasureConf, const std::string& title) {
+    autoMeasureLooper = std::move(alk_measure::beginAlkMeasureLoop<AUTO_PH_SAMPLE_COUNT>(alkMeasurer, publisher, timeClient, alkMeasureConf, title));
+    alk_measure::persistCheckpoint(alk_measure::checkpointFromStep(autoMeasureLooper->getLastStepResult()));
+}
+
+// Picks back up a measurement that was interrupted by a reboot (OTA, brownout,
+// debug/restart), rather than leaving acidified sample sitting in the vessel
+void resumeInterruptedMeasurement() {
+    auto checkpoint = alk_measure::readCheckpoint();
+    if (checkpoint == nullptr) return;
+
+    auto resumedStep = alk_measure::resumeFromCheckpoint<AUTO_PH_SAMPLE_COUNT>(*alkMeasurer, *checkpoint, timeClient->getMonotonicMS(), timeClient->getAdjustedTimeSeconds());
+    Serial.print("Resuming interrupted measurement title=");
+    Serial.print(checkpoint->title.c_str());
+    Serial.print(", checkpointAction=");
+    Serial.print(alk_measure::MEASUREMENT_ACTION_TO_NAME.at(checkpoint->nextAction).c_str());
+    Serial.print(", ");
+    debugOutputAction(resumedStep);
+    Serial.println();
+
+    if (resumedStep.nextAction == alk_measure::MeasurementAction::MEASURE_DONE) {
+        alk_measure::clearCheckpoint();
+        return;
+    }
+    autoMeasureLooper = std::make_unique<alk_measure::AlkMeasureLooper<AUTO_PH_SAMPLE_COUNT>>(alkMeasurer, publisher, timeClient, resumedStep);
+    alk_measure::persistCheckpoint(alk_measure::checkpointFromStep(resumedStep));
+}
+
 #define LOAD_FROM_DOC(target, name, type)    \
     if (doc.containsKey(#name)) {            \
         target.name = doc[#name].as<type>(); \
@@ -153,6 +254,38 @@ alk_measure::AlkMeasurementConfig buildAlkMeasureConfig(const StaticJsonDocument
     return beginAlkMeasureConf;
 }
 
+// The measure_alk handlers: config & asOf from the payload, then begins an
+// auto measurement of title if nothing's in the way. true when it began.
+bool requestAutoMeasurement(const StaticJsonDocument<200>& doc, const std::string& title) {
+    if (alkMeasurer == nullptr) return false;        // TODO: raise
+    if (autoMeasureLooper != nullptr) return false;  // TODO: should this work this way? Should I reset?
+    if (manualMeasurementInProgress()) {
+        // both runs would want the dosers to themselves
+        Serial.println("Manual measurement in progress, ignoring");
+        return false;
+    }
+
+    auto beginAlkMeasureConf = buildAlkMeasureConfig(doc);
+
+    uint64_t asOf = timeClient->getMonotonicMS();
+    if (doc.containsKey("asOf")) {
+        asOf = doc["asOf"].as<uint64_t>();
+    }
+
+    bool began = false;
+    runAfterIdempotenceCheck(asOf, [&]() {
+        beginAutoMeasurement(beginAlkMeasureConf, title);
+        began = true;
+    });
+    return began;
+}
+
+void applyPHCalibration(const ph::PHCalibrator& calibrator) {
+    phReaderPtr->updateCalibrator(calibrator);
+    ph::persistPHCalibration(calibrator);
+    publisher->publishPHCalibration(calibrator);
+}
+
 std::unique_ptr<richiev::mqtt::TopicProcessorMap> buildHandlers(doser::BuffDosers& buffDosers) {
     auto topicsToProcessorPtr = std::make_unique<richiev::mqtt::TopicProcessorMap>();
     auto& topicsToProcessor = *topicsToProcessorPtr;
@@ -251,27 +384,34 @@ std::unique_ptr<richiev::mqtt::TopicProcessorMap> buildHandlers(doser::BuffDoser
 
     topicsToProcessor[mqtt::measureAlk] = [&](const std::string& payload) {
         Serial.println("Executing an alk measurement");
-        if (alkMeasurer == nullptr) return;        // TODO: raise
-        if (autoMeasureLooper != nullptr) return;  // TODO: should this work this way? Should I reset?
-
         auto doc = parseInput(payload);
-        auto beginAlkMeasureConf = buildAlkMeasureConfig(doc);
 
         auto title = doc["title"].as<std::string>();
-        title = title.substr(0, reading_store::MAX_TITLE_LEN);
+        requestAutoMeasurement(doc, title.substr(0, reading_store::MAX_TITLE_LEN));
+    };
+
+    topicsToProcessor["execute/measure_alk/next_source"] = [&](const std::string& payload) {
+        // only moved on to the source after this one once its measurement's begun
+        auto sampleSource = buffDosersPtr->peekNextSampleSource();
+        if (sampleSource == nullptr) {
+            Serial.println("No sample sources configured, ignoring");
+            return;
+        }
+        Serial.print("Executing an alk measurement for sample source title=");
+        Serial.println(sampleSource->title.c_str());
 
-        auto asOf = millis();
-        if (doc.containsKey("asOf")) {
-            asOf = doc["asOf"].as<unsigned long>();
+        if (requestAutoMeasurement(parseInput(payload), sampleSource->title)) {
+            buffDosersPtr->nextSampleSource();
         }
-        runAfterIdempotenceCheck(asOf, [&]() {
-            autoMeasureLooper = std::move(alk_measure::beginAlkMeasureLoop<AUTO_PH_SAMPLE_COUNT>(alkMeasurer, publisher, timeClient, beginAlkMeasureConf, title));
-        });
     };
 
     topicsToProcessor["execute/measure_alk/manual/begin"] = [&](const std::string& payload) {
         Serial.println("Preparing to begin a manual alk measurement");
         if (alkMeasurer == nullptr) return;  // TODO: raise
+        if (autoMeasureLooper != nullptr) {
+            Serial.println("Auto measurement in progress, ignoring");
+            return;
+        }
 
         auto doc = parseInput(payload);
         auto beginAlkMeasureConf = buildAlkMeasureConfig(doc);
@@ -279,6 +419,8 @@ std::unique_ptr<richiev::mqtt::TopicProcessorMap> buildHandlers(doser::BuffDoser
         auto title = doc["title"].as<std::string>();
         title = title.substr(0, reading_store::MAX_TITLE_LEN);
 
+        // a run being replaced part way through lets go of the dosers with it
+        manualMeasureLooper.reset();
         manualMeasureLooper = std::move(alk_measure::beginAlkMeasureLoop<MANUAL_PH_SAMPLE_COUNT>(alkMeasurer, publisher, timeClient, beginAlkMeasureConf, title));
 
         Serial.print("Alk measurement begin completed, ");
@@ -288,6 +430,14 @@ std::unique_ptr<richiev::mqtt::TopicProcessorMap> buildHandlers(doser::BuffDoser
         Serial.println();
     };
 
+    topicsToProcessor["execute/measure_alk/manual/cancel"] = [&](const std::string& payload) {
+        if (manualMeasureLooper == nullptr) return;
+
+        // eg abandoned part way through, the vessel's left as it is
+        Serial.println("Cancelling the manual alk measurement");
+        manualMeasureLooper.reset();
+    };
+
     topicsToProcessor["execute/measure_alk/manual/next_step"] = [&](const std::string& payload) {
         if (manualMeasureLooper == nullptr) return;  // TODO: raise
 
@@ -312,6 +462,52 @@ std::unique_ptr<richiev::mqtt::TopicProcessorMap> buildHandlers(doser::BuffDoser
         doser->calibrator = std::move(calibr);
     };
 
+    topicsToProcessor[mqtt::phCalibration] = [&](const std::string& payload) {
+        // 5 points doesn't fit in parseInput's doc
+        StaticJsonDocument<512> doc;
+        DeserializationError error = deserializeJson(doc, payload);
+        if (error || !doc["points"].is<JsonArray>()) {
+            Serial.println("Invalid pH calibration, ignoring");
+            return;
+        }
+
+        std::vector<ph::PHCalibrator::CalibrationPoint> points;
+        for (JsonObject pointDoc : doc["points"].as<JsonArray>()) {
+            points.push_back({.actualPH = pointDoc["actualPH"].as<float>(), .readPH = pointDoc["readPH"].as<float>()});
+        }
+        float calibrationTempC = ph::DEFAULT_CALIBRATION_TEMP_C;
+        if (doc.containsKey("calibrationTempC")) {
+            calibrationTempC = doc["calibrationTempC"].as<float>();
+        }
+
+        applyPHCalibration(ph::PHCalibrator(points, calibrationTempC));
+    };
+
+    // Records the current raw pH as the reading for a buffer solution, eg with
+    // the probe sitting in pH 4.0 buffer: {"actualPH": 4.0}
+    topicsToProcessor[mqtt::phCalibrate] = [&](const std::string& payload) {
+        auto doc = parseInput(payload);
+        if (!doc.containsKey("actualPH")) return;  // TODO: raise
+
+        const auto& phReading = latestPHReading;
+        auto& calibrator = phReaderPtr->calibrator();
+
+        ph::PHCalibrator::CalibrationPoint point = {
+            .actualPH = doc["actualPH"].as<float>(),
+            // points are kept at the calibration temperature
+            .readPH = calibrator.compensate(phReading.rawPH_mavg, phReading.temperatureC)};
+        if (doc.containsKey("readPH")) {
+            point.readPH = doc["readPH"].as<float>();
+        }
+
+        Serial << "Calibrating pH actualPH=" << point.actualPH << " readPH=" << point.readPH << endl;
+        if (doc["reset"].as<bool>()) {
+            applyPHCalibration(ph::PHCalibrator(std::vector<ph::PHCalibrator::CalibrationPoint>({point}), calibrator.calibrationTempC()));
+        } else {
+            applyPHCalibration(calibrator.withPoint(point));
+        }
+    };
+
     topicsToProcessor[mqtt::phRead] = [](const std::string& payload) {
         auto doc = parseInput(payload);
 
@@ -335,21 +531,77 @@ std::unique_ptr<richiev::mqtt::TopicProcessorMap> buildHandlers(doser::BuffDoser
         monitoring_display::updateDisplay(readingStore);
     };
 
+    topicsToProcessor[mqtt::alkTraceRead] = [](const std::string& payload) {
+        // bigger than parseInput's doc
+        StaticJsonDocument<1024> doc;
+        DeserializationError error = deserializeJson(doc, payload);
+        if (error) {
+            Serial.println("Invalid measurement trace, ignoring");
+            return;
+        }
+
+        auto trace = parseMeasurementTrace(doc);
+        Serial << "Measurement trace title=" << doc["title"].as<std::string>().c_str()
+               << " totalMS=" << trace.totalDurationMS() << " doserBusyTotalMS=" << trace.doserBusyTotalMS
+               << " decisions=" << trace.decisions << endl;
+        webServer->setLastMeasurementTrace(trace);
+    };
+
     Serial << "Initialized topic_processor_count=" << topicsToProcessor.size() << endl;
     return std::move(topicsToProcessorPtr);
 }
 
+void enqueueControlCommand(const std::string& topic, const std::string& payload) {
+    concurrency::ControlCommand command;
+    if (!command.set(topic, payload)) {
+        Serial << "[WARNING] Command too large, dropping topic=" << topic.c_str() << endl;
+    } else if (!controlCommands->tryPush(command)) {
+        Serial << "[WARNING] Control queue full, dropping topic=" << topic.c_str() << endl;
+    } else {
+        if (powerManager != nullptr) {
+            powerManager->wake(power::WAKE_MQTT);
+        }
+        if (controlTaskHandle != nullptr) {
+            xTaskNotifyGive(controlTaskHandle);
+        }
+    }
+}
+
+// Swaps each control handler for one that queues the message for the control task
+void routeToControlTask(richiev::mqtt::TopicProcessorMap& handlers) {
+    for (auto& topicAndHandler : handlers) {
+        if (NETWORK_TASK_TOPICS.count(topicAndHandler.first)) continue;
+
+        const auto topic = topicAndHandler.first;
+        controlHandlers[topic] = topicAndHandler.second;
+        topicAndHandler.second = [topic](const std::string& payload) {
+            enqueueControlCommand(topic, payload);
+        };
+    }
+}
+
 std::unique_ptr<alk_measure::AlkMeasurer> alkMeasureSetup(std::shared_ptr<doser::BuffDosers> buffDosers, const alk_measure::AlkMeasurementConfig alkMeasureConf, const std::shared_ptr<ph::controller::PHReader> phReader) {
     return std::make_unique<alk_measure::AlkMeasurer>(buffDosers, alkMeasureConf, phReader);
 }
 
-void setupController(std::shared_ptr<MqttBroker> mqttBroker, std::shared_ptr<MqttClient> mqttClient, std::shared_ptr<doser::BuffDosers> buffDosers, std::shared_ptr<ph::controller::PHReader> phReader, const alk_measure::AlkMeasurementConfig& alkMeasureConf, std::shared_ptr<mqtt::Publisher> pub, std::shared_ptr<buff_time::TimeWrapper> t) {
+// pub is used from the control task, displayPub (if given) from the network task
+void setupController(std::shared_ptr<MqttBroker> mqttBroker, std::shared_ptr<MqttClient> mqttClient, std::shared_ptr<doser::BuffDosers> buffDosers, std::shared_ptr<ph::controller::PHReader> phReader, const alk_measure::AlkMeasurementConfig& alkMeasureConf, std::shared_ptr<mqtt::Publisher> pub, std::shared_ptr<buff_time::TimeWrapper> t, std::shared_ptr<mqtt::Publisher> displayPub = nullptr) {
     buffDosersPtr = buffDosers;
     publisher = pub;
     timeClient = t;
+    phReaderPtr = phReader;
     alkMeasurer = std::move(alkMeasureSetup(buffDosers, alkMeasureConf, phReader));
 
+    // a runtime calibration wins over the one compiled into inputs.h
+    auto persistedCalibration = ph::readPHCalibration();
+    if (persistedCalibration != nullptr) {
+        Serial << "Loaded pH calibration point_count=" << persistedCalibration->points().size() << endl;
+        phReader->updateCalibrator(*persistedCalibration);
+    }
+
     std::shared_ptr<richiev::mqtt::TopicProcessorMap> handlers = std::move(buildHandlers(*buffDosers));
+    controlCommands = std::make_shared<concurrency::ControlCommandQueue>();
+    routeToControlTask(*handlers);
 
     readingStore = std::move(reading_store::setupReadingStore(reading_store::READINGS_TO_KEEP));
     webServer = std::make_unique<web_server::BuffWebServer>(timeClient);
@@ -357,43 +609,91 @@ void setupController(std::shared_ptr<MqttBroker> mqttBroker, std::shared_ptr<Mqt
     richiev::mqtt::setupMQTT(mqttBroker, mqttClient, handlers);
     webServer->setupWebServer(readingStore);
 
-    monitoring_display::setupDisplay(readingStore, publisher);
+    monitoring_display::setupDisplay(readingStore, displayPub != nullptr ? displayPub : publisher);
 
 #ifdef BOARD_MKS_DLC32
     setup_mks();
 #endif
+
+    resumeInterruptedMeasurement();
 }
 
-void loopAlkMeasurement(unsigned long loopAsOf) {
+void loopAlkMeasurement(const uint64_t loopAsOf) {
     if (autoMeasureLooper != nullptr &&
-        (autoMeasureLooper->getLastStepResult().asOfMS + ALK_STEP_INTERVAL_MS) <= loopAsOf) {
+        autoMeasureLooper->getLastStepResult().nextStepDue(loopAsOf, ALK_STEP_INTERVAL_MS)) {
         Serial.print(loopAsOf);
         Serial.print(" Performing measurement step");
+        const auto prevResult = autoMeasureLooper->getLastStepResult();
         auto& result = autoMeasureLooper->nextStep();
         Serial.print(loopAsOf);
         Serial.println(" Completed measurement step");
         debugOutputAction(result);
+        if (alk_measure::tookPHDecision(prevResult, result)) {
+            monitoring_display::recordTitrationPoint({result.measurementStartedAtMS,
+                                                      result.alkReading.reagentVolumeML,
+                                                      result.alkReading.phReading.calibratedPH_mavg});
+        }
         if (result.nextAction == alk_measure::MeasurementAction::MEASURE_DONE) {
             Serial.println("Completed measurement loop");
+            alk_measure::clearCheckpoint();
             autoMeasureLooper.reset();
+        } else if (alk_measure::shouldCheckpoint(prevResult, result)) {
+            alk_measure::persistCheckpoint(alk_measure::checkpointFromStep(result));
         }
     }
 }
 
-void loopController() {
-    auto pendingRequest = webServer->retrievePendingFeedRequest();
-    if (pendingRequest) {
-        runAfterIdempotenceCheck(pendingRequest->asOf, [&]() {
-            autoMeasureLooper = std::move(alk_measure::beginAlkMeasureLoop<AUTO_PH_SAMPLE_COUNT>(alkMeasurer, publisher, timeClient, alkMeasurer->getDefaultAlkMeasurementConfig(), pendingRequest->title));
-        });
+bool measurementInProgress() {
+    return autoMeasureLooper != nullptr || manualMeasurementInProgress();
+}
+
+void recordPHReading(const ph::PHReading& reading) {
+    latestPHReading = reading;
+}
+
+// Returns how long until it next has work: the next measurement step, right
+// away if commands are still queued, otherwise CONTROL_IDLE_INTERVAL_MS
+unsigned long loopControl() {
+    concurrency::ControlCommand command;
+    // a couple per pass, so a burst of messages can't hold up a measurement step
+    for (size_t i = 0; i < MAX_CONTROL_COMMANDS_PER_LOOP && controlCommands->tryPop(command); i++) {
+        auto handler = controlHandlers.find(command.topic);
+        if (handler != controlHandlers.end()) {
+            handler->second(command.payload);
+        }
+    }
+
+    const uint64_t nowMS = timeClient->getMonotonicMS();
+    loopAlkMeasurement(nowMS);
+
+    unsigned long durationMS = 0;
+    if (autoMeasureLooper) {
+        durationMS = autoMeasureLooper->getLastStepResult().asOfMS -
+                     autoMeasureLooper->getLastStepResult().measurementStartedAtMS;
+    }
+    currentMeasurementDurationMS = durationMS;
+
+    if (controlCommands->size() > 0) {
+        return 0;
     }
-    unsigned long currentDurationMS = 0;
     if (autoMeasureLooper) {
-        currentDurationMS = autoMeasureLooper->getLastStepResult().asOfMS -
-                            autoMeasureLooper->getLastStepResult().measurementStartedAtMS;
+        const uint64_t stepDueAtMS = autoMeasureLooper->getLastStepResult().asOfMS + ALK_STEP_INTERVAL_MS;
+        return stepDueAtMS > nowMS ? stepDueAtMS - nowMS : 0;
+    }
+    return CONTROL_IDLE_INTERVAL_MS;
+}
+
+void loopNetwork() {
+    auto pendingRequest = webServer->retrievePendingFeedRequest();
+    if (pendingRequest) {
+        StaticJsonDocument<200> doc;
+        doc["title"] = pendingRequest->title;
+        doc["asOf"] = pendingRequest->asOf;
+        std::string payload;
+        serializeJson(doc, payload);
+        enqueueControlCommand(mqtt::measureAlk, payload);
     }
-    webServer->loopWebServer(currentDurationMS);
-    loopAlkMeasurement(millis());
+    webServer->loopWebServer(currentMeasurementDurationMS);
 
     monitoring_display::loopDisplay();
 }
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cmath>
+#include <memory>
+
+// Buff Libraries
+#include "doser/doser-common.h"
+
+namespace buff {
+namespace doser {
+
+enum DoseMode {
+    DOSE_NONE,
+    DOSE_VOLUME,
+    DOSE_VOLUME_OVER_TIME,
+    DOSE_CONTINUOUS,
+};
+
+/*******************************
+ * DoseExecutor
+ * Runs one dose at a time on a Doser without ever blocking: loop() starts
+ * chunks as they come due and advances the motor by at most one step per
+ * call, so the caller decides how much time to spend stepping.
+ *
+ * Doses spread over a duration are split into a chunk every
+ * chunkIntervalMS, each topping the output up to where it should be by
+ * then, so the average flow rate matches what was asked for.
+ *******************************/
+class DoseExecutor {
+   private:
+    const std::shared_ptr<Doser> _doser;
+    const unsigned long _chunkIntervalMS;
+
+    DoseMode _mode = DOSE_NONE;
+    float _requestedML = 0;
+    unsigned long _durationMS = 0;
+    unsigned long _startedAtMS = 0;
+
+    bool _paused = false;
+    unsigned long _pausedAtMS = 0;
+
+    bool _chunkRunning = false;
+    unsigned long _lastChunkAtMS = 0;
+    // output of finished chunks
+    float _completedML = 0;
+
+    void begin(const DoseMode mode, const float requestedML, const unsigned long durationMS, const unsigned long nowMS) {
+        stop();
+        _mode = mode;
+        _requestedML = requestedML;
+        _durationMS = durationMS;
+        _startedAtMS = nowMS;
+        _completedML = 0;
+    }
+
+    void startChunk(const float ml, const unsigned long nowMS) {
+        _doser->startDoseML(ml);
+        _chunkRunning = true;
+        _lastChunkAtMS = nowMS;
+    }
+
+    void finishChunk() {
+        _completedML += _doser->dosedML();
+        _chunkRunning = false;
+    }
+
+    // how much should be out by now
+    float targetML(const unsigned long nowMS) const {
+        if (_mode != DOSE_VOLUME_OVER_TIME || _durationMS == 0) {
+            return _requestedML;
+        }
+        const unsigned long elapsedMS = nowMS - _startedAtMS;
+        if (elapsedMS >= _durationMS) {
+            return _requestedML;
+        }
+        return _requestedML * elapsedMS / _durationMS;
+    }
+
+    void maybeStartChunk(const unsigned long nowMS) {
+        if (_mode == DOSE_CONTINUOUS) {
+            // a rotation at a time, until stopped
+            startChunk(_doser->config.mlPerFullRotation, nowMS);
+            return;
+        }
+
+        const float remainingML = _requestedML - _completedML;
+        if (remainingML <= MIN_CHUNK_ML) {
+            _mode = DOSE_NONE;
+            return;
+        }
+
+        if (_mode == DOSE_VOLUME) {
+            startChunk(remainingML, nowMS);
+            return;
+        }
+
+        const bool chunkDue = nowMS - _lastChunkAtMS >= _chunkIntervalMS || nowMS - _startedAtMS >= _durationMS;
+        const float dueML = targetML(nowMS) - _completedML;
+        if (chunkDue && dueML > MIN_CHUNK_ML) {
+            startChunk(dueML, nowMS);
+        }
+    }
+
+   public:
+    // smaller than this isn't worth turning the motor for
+    static constexpr float MIN_CHUNK_ML = 0.001;
+
+    DoseExecutor(std::shared_ptr<Doser> doser, const unsigned long chunkIntervalMS = 1000) : _doser(doser), _chunkIntervalMS(chunkIntervalMS) {}
+
+    void doseVolume(const float ml, const unsigned long nowMS) {
+        begin(DOSE_VOLUME, ml, 0, nowMS);
+    }
+
+    void doseVolumeOverTime(const float ml, const unsigned long durationMS, const unsigned long nowMS) {
+        begin(DOSE_VOLUME_OVER_TIME, ml, durationMS, nowMS);
+        // first chunk goes out on the next loop
+        _lastChunkAtMS = nowMS - _chunkIntervalMS;
+    }
+
+    void doseConstantFlowRate(const float mlPerMinute, const unsigned long durationMS, const unsigned long nowMS) {
+        doseVolumeOverTime(mlPerMinute * durationMS / 60000.0, durationMS, nowMS);
+    }
+
+    void doseContinuously(const unsigned long nowMS) {
+        begin(DOSE_CONTINUOUS, INFINITY, 0, nowMS);
+    }
+
+    void pause(const unsigned long nowMS) {
+        if (_mode == DOSE_NONE || _paused) return;
+        if (_chunkRunning) {
+            _doser->stopDose();
+            finishChunk();
+        }
+        _paused = true;
+        _pausedAtMS = nowMS;
+    }
+
+    void resume(const unsigned long nowMS) {
+        if (!_paused) return;
+        _paused = false;
+        // the schedule picks up where it left off
+        _startedAtMS += nowMS - _pausedAtMS;
+        _lastChunkAtMS += nowMS - _pausedAtMS;
+    }
+
+    void stop() {
+        if (_chunkRunning) {
+            _doser->stopDose();
+            finishChunk();
+        }
+        _mode = DOSE_NONE;
+        _paused = false;
+    }
+
+    // true while a dose is active (including paused). Call as often as possible.
+    bool loop(const unsigned long nowMS) {
+        if (_mode == DOSE_NONE) return false;
+        if (_paused) return true;
+
+        if (_chunkRunning) {
+            if (_doser->runDose()) return true;
+            finishChunk();
+        }
+
+        maybeStartChunk(nowMS);
+        return _mode != DOSE_NONE;
+    }
+
+    // whether the motor needs stepping right now, as opposed to waiting on the next chunk
+    bool stepping() const { return _chunkRunning; }
+    bool active() const { return _mode != DOSE_NONE; }
+    bool paused() const { return _paused; }
+    DoseMode mode() const { return _mode; }
+    float requestedML() const { return _requestedML; }
+
+    // output of the current (or most recent) dose so far
+    float dosedML() const {
+        return _completedML + (_chunkRunning ? _doser->dosedML() : 0);
+    }
+};
+
+}  // namespace doser
+}  // namespace buff
@@ -14,6 +14,10 @@ namespace buff {
 namespace doser {
 
 class AccelStepperDoser : public Doser {
+   private:
+    long _doseSteps = 0;
+    long _doseStartPosition = 0;
+
    public:
     AccelStepperDoser(DoserConfig doserConfig, std::shared_ptr<AccelStepper> s) : Doser(doserConfig), stepper(s) {}
 
@@ -39,6 +43,30 @@ class AccelStepperDoser : public Doser {
         stepper->runToPosition();
     }
 
+    virtual void startDoseML(const float outputML, Calibrator* aCalibrator = nullptr) {
+        if (aCalibrator == nullptr) aCalibrator = calibrator.get();
+
+        _doseSteps = partialRotationToSteps(aCalibrator->partialRotationsForMLOutput(outputML));
+        _doseStartPosition = stepper->currentPosition();
+        _startedDoseML = outputML;
+        stepper->move(_doseSteps);
+    }
+
+    // at most one step per call
+    virtual bool runDose() {
+        return stepper->run();
+    }
+
+    virtual void stopDose() {
+        // also zeroes the speed, so the pump halts rather than decelerating
+        stepper->setCurrentPosition(stepper->currentPosition());
+    }
+
+    virtual float dosedML() {
+        if (_doseSteps == 0) return 0;
+        return _startedDoseML * (stepper->currentPosition() - _doseStartPosition) / _doseSteps;
+    }
+
     virtual void setup() {
         const auto rps = config.motorRPM / 60.0;
         const long stepsPerRevolution = partialRotationToSteps(1.0);
@@ -14,6 +14,9 @@ namespace buff {
 namespace doser {
 
 class BasicStepperDoser : public Doser {
+   private:
+    long _doseSteps = 0;
+
    public:
     BasicStepperDoser(DoserConfig doserConfig, std::shared_ptr<A4988> s) : Doser(doserConfig), stepper(s) {}
 
@@ -38,6 +41,28 @@ class BasicStepperDoser : public Doser {
         stepper->move(steps);
     }
 
+    virtual void startDoseML(const float outputML, Calibrator* aCalibrator = nullptr) {
+        if (aCalibrator == nullptr) aCalibrator = calibrator.get();
+
+        _doseSteps = partialRotationToSteps(aCalibrator->partialRotationsForMLOutput(outputML));
+        _startedDoseML = outputML;
+        stepper->startMove(_doseSteps);
+    }
+
+    // nextAction waits out at most one step interval
+    virtual bool runDose() {
+        return stepper->nextAction() > 0;
+    }
+
+    virtual void stopDose() {
+        stepper->stop();
+    }
+
+    virtual float dosedML() {
+        if (_doseSteps == 0) return 0;
+        return _startedDoseML * stepper->getStepsCompleted() / labs(_doseSteps);
+    }
+
     virtual void setup() {
         stepper->begin(config.motorRPM, config.microStepType);
     }
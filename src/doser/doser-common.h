@@ -3,9 +3,12 @@
 #include <Arduino.h>
 
 #include <cmath>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 // Buff Libraries
 #include "doser/doser-config.h"
@@ -40,6 +43,9 @@ class Calibrator {
 };
 
 class Doser {
+   protected:
+    float _startedDoseML = 0;
+
    public:
     const DoserConfig config;
 
@@ -49,6 +55,20 @@ class Doser {
 
     virtual void doseML(const float outputML, Calibrator* aCalibrator = nullptr) = 0;
 
+    // Non-blocking dosing: startDoseML kicks off a dose and runDose is called
+    // (as often as possible) until it returns false. Dosers that can't step
+    // incrementally fall back to doseML, so the whole dose happens in startDoseML.
+    virtual void startDoseML(const float outputML, Calibrator* aCalibrator = nullptr) {
+        doseML(outputML, aCalibrator);
+        _startedDoseML = outputML;
+    }
+    // true while the dose is still running
+    virtual bool runDose() { return false; }
+    // halts the current dose where it is
+    virtual void stopDose() {}
+    // ml output so far by the current (or most recent) dose
+    virtual float dosedML() { return _startedDoseML; }
+
     virtual void setup() = 0;
 
     virtual void debugRotateDegrees(const int deg) = 0;
@@ -65,11 +85,42 @@ class Doser {
     }
 };
 
+/*******************************
+ * BuffDosers
+ * The dosers share one enable pin, and can be driven from more than one task
+ * (eg ESPHome's buff_doser from the main loop, buff_alk from its own). So
+ * anything dosing holds them for the duration:
+ * - a measurement runs every doser in turn, so holds them to itself and waits
+ *   for any doses already running to finish
+ * - manual doses can run alongside each other, but not during a measurement
+ * The pin's enabled while anything holds them, disabled once the last lets go.
+ *******************************/
 class BuffDosers {
    private:
     std::map<MeasurementDoserType, std::shared_ptr<Doser>> _doserTypeToDoser;
     const short _doserDisablePin;
 
+    std::vector<SampleSource> _sampleSources;
+    size_t _nextSampleSourceIndex = 0;
+
+    std::mutex _holdMutex;
+    unsigned int _doseHolds = 0;
+    bool _measurementHold = false;
+
+    // both with _holdMutex held
+    bool held() const {
+        return _measurementHold || _doseHolds > 0;
+    }
+
+    void holdsChanged(const bool wasHeld) {
+        if (held() == wasHeld) return;
+        if (held()) {
+            enableDosers();
+        } else {
+            disableDosers();
+        }
+    }
+
    public:
     BuffDosers(short doserDisablePin) : _doserDisablePin(doserDisablePin) {}
 
@@ -90,6 +141,104 @@ class BuffDosers {
         _doserTypeToDoser.emplace(doserType, doser);
     }
 
+    void addSampleSource(const SampleSource& sampleSource) {
+        if (_sampleSources.size() >= MAX_SAMPLE_SOURCES) {
+            Serial.print("Too many sample sources, ignoring title=");
+            Serial.println(sampleSource.title.c_str());
+            return;
+        }
+        // selectDoser would quietly fall back to FILL, ie sample the main tank under this title
+        if (_doserTypeToDoser.find(sampleSource.doserType) == _doserTypeToDoser.end()) {
+            Serial.print("No doser for sample source, ignoring title=");
+            Serial.println(sampleSource.title.c_str());
+            return;
+        }
+        _sampleSources.push_back(sampleSource);
+    }
+
+    // the source registered for this title, or nullptr to use the defaults
+    const SampleSource* findSampleSource(const std::string& title) const {
+        for (auto& sampleSource : _sampleSources) {
+            if (sampleSource.title == title) {
+                return &sampleSource;
+            }
+        }
+        return nullptr;
+    }
+
+    // the source nextSampleSource will hand out, without moving on to the one after
+    const SampleSource* peekNextSampleSource() const {
+        if (_sampleSources.empty()) {
+            return nullptr;
+        }
+        return &_sampleSources[_nextSampleSourceIndex % _sampleSources.size()];
+    }
+
+    // cycles through the registered sources, so repeated calls measure each tank in turn
+    const SampleSource* nextSampleSource() {
+        auto sampleSource = peekNextSampleSource();
+        if (sampleSource != nullptr) {
+            _nextSampleSourceIndex = (_nextSampleSourceIndex + 1) % _sampleSources.size();
+        }
+        return sampleSource;
+    }
+
+    const std::vector<SampleSource>& getSampleSources() const {
+        return _sampleSources;
+    }
+
+    // false while a measurement holds the dosers
+    bool tryHoldForDose() {
+        std::lock_guard<std::mutex> lock(_holdMutex);
+        if (_measurementHold) return false;
+        const bool wasHeld = held();
+        _doseHolds++;
+        holdsChanged(wasHeld);
+        return true;
+    }
+
+    void releaseDose() {
+        std::lock_guard<std::mutex> lock(_holdMutex);
+        if (_doseHolds == 0) return;
+        const bool wasHeld = held();
+        _doseHolds--;
+        holdsChanged(wasHeld);
+    }
+
+    // false while doses or another measurement hold the dosers
+    bool tryHoldForMeasurement() {
+        std::lock_guard<std::mutex> lock(_holdMutex);
+        if (_measurementHold || _doseHolds > 0) return false;
+        const bool wasHeld = held();
+        _measurementHold = true;
+        holdsChanged(wasHeld);
+        return true;
+    }
+
+    void releaseMeasurement() {
+        std::lock_guard<std::mutex> lock(_holdMutex);
+        if (!_measurementHold) return;
+        const bool wasHeld = held();
+        _measurementHold = false;
+        holdsChanged(wasHeld);
+    }
+
+    bool measuring() {
+        std::lock_guard<std::mutex> lock(_holdMutex);
+        return _measurementHold;
+    }
+
+    // Runs change, eg swapping a doser's calibrator, unless a measurement holds
+    // the dosers (it could be mid dose on another task, using what's changed).
+    // A measurement can't start while it runs. false when it didn't run.
+    bool tryUnlessMeasuring(const std::function<void()>& change) {
+        std::lock_guard<std::mutex> lock(_holdMutex);
+        if (_measurementHold) return false;
+        change();
+        return true;
+    }
+
+    // straight to the pin, regardless of holds, eg for debugging & parking
     void disableDosers() {
         digitalWrite(_doserDisablePin, HIGH);
     }
@@ -135,5 +284,11 @@ static std::unique_ptr<buff::doser::BuffDosers> setupDosers(const short doserDis
     return std::move(dosers);
 }
 
+static void setupSampleSources(BuffDosers& buffDosers, const std::vector<SampleSource>& sampleSources) {
+    for (auto& sampleSource : sampleSources) {
+        buffDosers.addSampleSource(sampleSource);
+    }
+}
+
 }  // namespace doser
 }  // namespace buff
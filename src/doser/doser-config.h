@@ -2,6 +2,7 @@
 
 // #include <Arduino.h>
 
+#include <map>
 #include <memory>
 #include <string>
 
@@ -39,13 +40,36 @@ struct DoserConfig {
 
 enum MeasurementDoserType {
     FILL = 0,
+    // additional sample sources (other tanks, or valves off a shared line) use
+    // the slots between FILL and DRAIN
+    FILL_2 = 1,
+    FILL_3 = 2,
+    FILL_4 = 3,
     DRAIN = 10,
     REAGENT = 20
 };
 
+// FILL through FILL_4
+const size_t MAX_SAMPLE_SOURCES = FILL_4 - FILL + 1;
+
 static std::map<std::string, MeasurementDoserType> const MEASUREMENT_DOSER_TYPE_NAME_TO_MEASUREMENT_DOSER =
     {{"fill", MeasurementDoserType::FILL},
+     {"fill_2", MeasurementDoserType::FILL_2},
+     {"fill_3", MeasurementDoserType::FILL_3},
+     {"fill_4", MeasurementDoserType::FILL_4},
      {"drain", MeasurementDoserType::DRAIN},
      {"reagent", MeasurementDoserType::REAGENT}};
 
+/*******************************
+ * Sample sources
+ *******************************/
+// A tank the measurement vessel can be filled from. Measurements whose title
+// matches are filled using doserType, after first pushing flushVolumeML
+// through the line to clear out water left over from the previous tank.
+struct SampleSource {
+    std::string title;
+    MeasurementDoserType doserType = FILL;
+    float flushVolumeML = 0;
+};
+
 }  // namespace buff
@@ -22,6 +22,11 @@ struct ArduinoPinConfig {
 
     short STIRRER_PIN = UNSET_VALUE;
     short STIRRER_PWM_VALUE = UNSET_VALUE;
+
+    // an I2C display on its own pins gets the second controller (Wire1),
+    // otherwise it shares the sensors' bus
+    short DISPLAY_I2C_SDA = UNSET_VALUE;
+    short DISPLAY_I2C_SCL = UNSET_VALUE;
 };
 
 const ArduinoPinConfig ESP32_CONFIG = {
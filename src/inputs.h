@@ -1,11 +1,14 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 // Buff Libraries
 #include "ph-robotank-sensor.h"
 #include "readings/ph.h"
+#include "sensors/sensor-registry.h"
 
 // Other inputs
 // const std::string wifiSSID;
@@ -46,13 +49,29 @@ const std::map<unsigned char, unsigned char> boardIDToPort = {
 // const auto roboTankPHSensorI2CAddress = 98l;
 const unsigned char boardId = 10;
 const auto roboTankPHSensorI2CAddress = boardIDToPort.at(boardId);
-defineRoboTankSignalReaderFunc(roboTankPHSensorI2CAddress);
+/*******************************
+ * Sensors
+ * Each sensor is read on its own interval, reads on the I2C bus are taken in
+ * turn. PHReader just picks up the most recent values.
+ *******************************/
+std::shared_ptr<sensors::SensorRegistry> buildSensorRegistry() {
+    auto registry = std::make_shared<sensors::SensorRegistry>();
+    // read faster than the 1s alk measurement step, so each step sees a new value
+    registry->add(std::make_shared<robotank::RoboTankPHSensor>(roboTankPHSensorI2CAddress), 500);
+
+    // eg a temperature probe for compensation
+    // registry->add(std::make_shared<sensors::FunctionSensor>(sensors::TEMPERATURE_C, "tank_temp", []() { return readTankTempC(); }), 5000);
+    return registry;
+}
+auto sensorRegistry = buildSensorRegistry();
 
 const ph::PHReadConfig phReadConfig = {
     // how often to read a new ph value
     .readIntervalMS = 1000,
 
-    .phReadFunc = nameForRoboTankSignalReaderFunc(roboTankPHSensorI2CAddress)};
+    .phReadFunc = sensorRegistry->latestValueFunc(sensors::PH),
+    // empty if there's no temperature sensor
+    .temperatureReadFunc = sensorRegistry->latestValueFunc(sensors::TEMPERATURE_C)};
 
 
 /*
@@ -80,6 +99,9 @@ const ph::PHCalibrator::CalibrationPoint phHighPoint = PH_SENSOR.phHighPoint;
 const ph::PHCalibrator::CalibrationPoint phLowPoint = PH_SENSOR.phLowPoint;
 
 
+// More points can be given, eg one near the ~4.5 titration endpoint:
+// ph::PHCalibrator phCalibrator({phLowPoint, {.actualPH = 4.5, .readPH = 5.4}, phHighPoint});
+// Calibrating over MQTT (config/ph/calibrate) or the touch UI overrides this.
 ph::PHCalibrator phCalibrator(phLowPoint, phHighPoint);
 
 /*******************************
@@ -105,6 +127,17 @@ std::map<MeasurementDoserType, std::shared_ptr<doser::Doser>> doserInstances = {
     {MeasurementDoserType::DRAIN, std::make_shared<doser::AccelStepperDoser>(drainDoserConfig, doserSteppers.at(MeasurementDoserType::DRAIN))},
 };
 
+/*******************************
+ * Sample sources
+ * Each additional tank needs its own fill doser (FILL_2, ...) added to
+ * doserSteppers & doserInstances above. Titles are matched after trimming
+ * to reading_store::MAX_TITLE_LEN.
+ *******************************/
+const std::vector<SampleSource> sampleSources = {
+    // {.title = "display", .doserType = MeasurementDoserType::FILL, .flushVolumeML = 0},
+    // {.title = "frag", .doserType = MeasurementDoserType::FILL_2, .flushVolumeML = 20},
+};
+
 alk_measure::AlkMeasurementConfig alkMeasureConf = {
     .primeTankWaterFillVolumeML = 1.0,
     .primeReagentReverseVolumeML = -2.6,
@@ -3,6 +3,7 @@
 
 // #include <cmath>
 // #include <cstring>
+#include <algorithm>
 #include <functional>
 #include <memory>
 
@@ -13,14 +14,19 @@
 
 // Buff Libraries
 #include "readings/alk-measure.h"
+#include "concurrency/deadline-scheduler.h"
 #include "controller.h"
 #include "doser/doser.h"
 #include "inputs.h"
+#include "metrics/loop-profiler.h"
+#include "metrics/metrics.h"
 #include "mqtt-publish.h"
 #include "mqtt.h"
 #include "mywifi.h"
 #include "ntp.h"
 #include "ota.h"
+#include "power/esp-power-hooks.h"
+#include "power/idle-power.h"
 #include "readings/ph-controller.h"
 
 namespace buff {
@@ -34,47 +40,197 @@ ph::controller::PHReadingStats<STANDARD_PH_MAVG_LENGTH> phReadingStats;
 auto mqttBroker = std::make_shared<MqttBroker>(inputs::MQTT_BROKER_PORT);
 auto mqttClient = std::make_shared<MqttClient>(mqttBroker.get());
 
+// display & network side publish directly, the control task goes through a queue
 auto publisher = std::make_shared<mqtt::MQTTPublisher>(mqttClient);
+std::shared_ptr<mqtt::QueuedPublisher> controlPublisher;
 
-std::shared_ptr<NTPClient> ntpClient;
+std::shared_ptr<buff_time::AsyncSNTPClock> ntpClock;
 std::shared_ptr<buff_time::TimeWrapper> timeClient;
 
 std::shared_ptr<doser::BuffDosers> buffDosers;
+std::shared_ptr<power::IdlePowerManager> powerManager;
+
+/*******************************
+ * Tasks
+ * The radio & lwIP live on core 0, so networking & the display go there too.
+ * Dosers, sensors and the measurement state machine get core 1 to themselves
+ * so stepper timing doesn't depend on network load.
+ *******************************/
+const BaseType_t CONTROL_CORE = 1;
+const BaseType_t NETWORK_CORE = 0;
+
+const unsigned long HEAP_SAMPLE_INTERVAL_MS = 1000;
+
+// I2C conversions in flight are polled this often
+const unsigned long SENSOR_POLL_INTERVAL_MS = 20;
+// sockets, OTA & LVGL aren't event driven here, so they're still polled, just
+// not back to back
+const unsigned long NETWORK_POLL_INTERVAL_MS = 10;
+// still quick enough that a touch feels responsive
+const unsigned long IDLE_NETWORK_POLL_INTERVAL_MS = 50;
+const unsigned long NTP_POLL_INTERVAL_MS = 100;
+const unsigned long POWER_CHECK_INTERVAL_MS = 500;
+// upper bound on a task's sleep, in case nothing's scheduled
+const unsigned long MAX_TASK_SLEEP_MS = 1000;
+
+// long enough to notice, short enough that the MQTT keepalive & stepper
+// timing aren't at risk yet
+const uint32_t SLOW_CONTROL_LOOP_US = 50000;
+const uint32_t SLOW_NETWORK_LOOP_US = 100000;
+BUFF_PROFILE_LOOP_DEFINE(controlProfiler, "control", SLOW_CONTROL_LOOP_US)
+BUFF_PROFILE_LOOP_DEFINE(networkProfiler, "network", SLOW_NETWORK_LOOP_US)
+
+concurrency::DeadlineScheduler controlScheduler;
+concurrency::DeadlineScheduler networkScheduler;
+// woken early when a command's queued for them
+size_t controlControllerJob = 0;
+size_t controlPowerJob = 0;
+
+unsigned long networkPollIntervalMS() {
+    return powerManager->state() == power::ACTIVE ? NETWORK_POLL_INTERVAL_MS : IDLE_NETWORK_POLL_INTERVAL_MS;
+}
+
+void sampleHeap() {
+    auto &m = metrics::buffMetrics();
+    m.heapFreeBytes.set(ESP.getFreeHeap());
+    m.heapLargestFreeBlockBytes.set(ESP.getMaxAllocHeap());
+    m.heapMinFreeBytes.set(ESP.getMinFreeHeap());
+}
+
+void loopPH(const uint64_t nowMS) {
+    if (inputs::sensorRegistry->hasReading(sensors::PH)) {
+        auto phReadingPtr = phReader->readNewPHSignalIfTimeAndUpdate<STANDARD_PH_MAVG_LENGTH>(phReadingStats, nowMS);
+        if (phReadingPtr != nullptr) {
+            phReadingPtr->asOfAdjustedSec = timeClient->getAdjustedTimeSeconds();
+            controller::recordPHReading(*phReadingPtr);
+            controlPublisher->publishPH(*phReadingPtr);
+        }
+    }
+}
+
+// sensors before pH, so a read that lands on the same deadline is used right away
+void setupControlJobs() {
+    controlScheduler.add("sensors", [](const uint64_t nowMS) {
+        BUFF_PROFILE(controlProfiler, "sensors", inputs::sensorRegistry->loop(nowMS));
+        return SENSOR_POLL_INTERVAL_MS;
+    });
+    controlScheduler.add("ph", [](const uint64_t nowMS) {
+        BUFF_PROFILE(controlProfiler, "ph", loopPH(nowMS));
+        return powerManager->phReadIntervalMS(inputs::phReadConfig.readIntervalMS);
+    });
+    controlControllerJob = controlScheduler.add("controller", [](const uint64_t nowMS) {
+        unsigned long delayMS;
+        BUFF_PROFILE(controlProfiler, "controller", delayMS = controller::loopControl());
+        return delayMS;
+    });
+    // after the controller, so a command that starts a measurement counts as busy straight away
+    controlPowerJob = controlScheduler.add("power", [](const uint64_t nowMS) {
+        BUFF_PROFILE(controlProfiler, "power", powerManager->loop(nowMS, controller::measurementInProgress()));
+        return POWER_CHECK_INTERVAL_MS;
+    });
+}
+
+void setupNetworkJobs() {
+    networkScheduler.add("ntp", [](const uint64_t nowMS) {
+        BUFF_PROFILE(networkProfiler, "ntp", ntp::loopNTP(ntpClock));
+        return NTP_POLL_INTERVAL_MS;
+    });
+    networkScheduler.add("publish", [](const uint64_t nowMS) {
+        BUFF_PROFILE(networkProfiler, "publish", controlPublisher->drain());
+        return networkPollIntervalMS();
+    });
+    networkScheduler.add("mqtt", [](const uint64_t nowMS) {
+        BUFF_PROFILE(networkProfiler, "mqtt", richiev::mqtt::loopMQTT(mqttBroker, mqttClient));
+        return networkPollIntervalMS();
+    });
+    networkScheduler.add("controller", [](const uint64_t nowMS) {
+        BUFF_PROFILE(networkProfiler, "controller", controller::loopNetwork());
+        return networkPollIntervalMS();
+    });
+    networkScheduler.add("ota", [](const uint64_t nowMS) {
+        BUFF_PROFILE(networkProfiler, "ota", richiev::ota::loopOTA());
+        return networkPollIntervalMS();
+    });
+    networkScheduler.add("heap", [](const uint64_t nowMS) {
+        sampleHeap();
+        return HEAP_SAMPLE_INTERVAL_MS;
+    });
+}
+
+// at least a tick, so the idle task can feed the watchdog
+TickType_t ticksToSleep(concurrency::DeadlineScheduler &scheduler) {
+    const unsigned long sleepMS = scheduler.msUntilNextDeadline(buff_time::monotonicMS(), MAX_TASK_SLEEP_MS);
+    return std::max<TickType_t>(1, pdMS_TO_TICKS(sleepMS));
+}
+
+void controlTask(void *) {
+    auto &loopTime = metrics::buffMetrics().controlLoopUS;
+    while (true) {
+        const unsigned long startedAtUS = micros();
+        BUFF_PROFILE_LOOP_BEGIN(controlProfiler);
+        controlScheduler.runDue(buff_time::monotonicMS());
+        BUFF_PROFILE_LOOP_END(controlProfiler);
+        loopTime.record(micros() - startedAtUS);
+
+        // sleeps through to the next deadline, or until a command's queued
+        if (ulTaskNotifyTake(pdTRUE, ticksToSleep(controlScheduler)) > 0) {
+            const uint64_t nowMS = buff_time::monotonicMS();
+            controlScheduler.wake(controlControllerJob, nowMS);
+            controlScheduler.wake(controlPowerJob, nowMS);
+        }
+    }
+}
+
+void networkTask(void *) {
+    auto &loopTime = metrics::buffMetrics().networkLoopUS;
+    while (true) {
+        const unsigned long startedAtUS = micros();
+        BUFF_PROFILE_LOOP_BEGIN(networkProfiler);
+        networkScheduler.runDue(buff_time::monotonicMS());
+        BUFF_PROFILE_LOOP_END(networkProfiler);
+        loopTime.record(micros() - startedAtUS);
+
+        vTaskDelay(ticksToSleep(networkScheduler));
+    }
+}
 
 /**************************
  * Setup & Loop
  **************************/
 void setup() {
     Serial.begin(115200);
-    Wire.begin(inputs::PIN_CONFIG.I2C_SDA, inputs::PIN_CONFIG.I2C_SCL);
+    sensors::setupI2CBuses(inputs::PIN_CONFIG.I2C_SDA, inputs::PIN_CONFIG.I2C_SCL, inputs::PIN_CONFIG.DISPLAY_I2C_SDA, inputs::PIN_CONFIG.DISPLAY_I2C_SCL);
 
     richiev::connectWifi(inputs::hostname, inputs::wifiSSID, inputs::wifiPassword);
     richiev::ota::setupOTA(inputs::hostname);
 
     buffDosers = std::move(doser::setupDosers(inputs::PIN_CONFIG.STEPPER_DISABLE_PIN, inputs::doserInstances, inputs::doserSteppers));
-    // TODO: make this configurable
-    setupPH_RoboTankPHBoard();
+    doser::setupSampleSources(*buffDosers, inputs::sampleSources);
 
-    // trigger a NTP refresh
-    ntpClient = std::move(ntp::setupNTP());
-    timeClient = std::make_shared<ntp::NTPTimeWrapper>(ntpClient);
+    // syncs in the background once the network task is up
+    ntpClock = ntp::setupNTP();
+    timeClient = ntpClock;
 
-    controller::setupController(mqttBroker, mqttClient, buffDosers, phReader, inputs::alkMeasureConf, publisher, timeClient);
-}
+    auto outbound = std::make_shared<concurrency::OutboundQueue>();
+    controlPublisher = std::make_shared<mqtt::QueuedPublisher>(mqttClient, outbound);
 
-void loop() {
-    auto phReadingPtr = phReader->readNewPHSignalIfTimeAndUpdate<STANDARD_PH_MAVG_LENGTH>(phReadingStats);
-    if (phReadingPtr != nullptr) {
-        phReadingPtr->asOfAdjustedSec = timeClient->getAdjustedTimeSeconds();
-        publisher->publishPH(*phReadingPtr);
-    }
+    controller::setupController(mqttBroker, mqttClient, buffDosers, phReader, inputs::alkMeasureConf, controlPublisher, timeClient, publisher);
 
-    ntp::loopNTP(ntpClient);
+    const power::IdlePowerConfig powerConfig;
+    powerManager = std::make_shared<power::IdlePowerManager>(
+        std::make_shared<power::EspPowerHooks>(buffDosers, inputs::sensorRegistry, powerConfig.idlePHReadIntervalMS), powerConfig);
+    controller::powerManager = powerManager;
+    monitoring_display::setTouchCallback([]() { powerManager->wake(power::WAKE_TOUCH); });
 
-    controller::loopController();
+    setupControlJobs();
+    setupNetworkJobs();
+    xTaskCreatePinnedToCore(controlTask, "BuffControl", 8192, nullptr, 2, &controller::controlTaskHandle, CONTROL_CORE);
+    xTaskCreatePinnedToCore(networkTask, "BuffNetwork", 12288, nullptr, 1, nullptr, NETWORK_CORE);
+}
 
-    richiev::mqtt::loopMQTT(mqttBroker, mqttClient);
-    richiev::ota::loopOTA();
+void loop() {
+    // everything runs on the tasks started in setup
+    vTaskDelete(nullptr);
 }
 
 }  // namespace buff
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Buff Libraries
+#include "metrics/metrics.h"
+
+namespace buff {
+namespace metrics {
+
+const size_t MAX_PROFILED_SECTIONS = 8;
+
+/*******************************
+ * LoopProfiler
+ * Times each subsystem call in a task's loop, keeping a rolling p99 & max
+ * per subsystem (rendered on /metrics), and flags any iteration over
+ * slowThresholdUS along with whichever section took the longest.
+ *
+ * Use it through the BUFF_PROFILE_* macros below, which compile away
+ * unless BUFF_LOOP_PROFILER is defined. One profiler per task.
+ *******************************/
+class LoopProfiler {
+   public:
+    struct Section {
+        const char *name = nullptr;
+        LatencyTracker *latency = nullptr;
+        // this iteration
+        uint32_t lastUS = 0;
+        char labels[48] = {};
+    };
+
+   private:
+    const char *_loopName;
+    const uint32_t _slowThresholdUS;
+    Registry &_registry;
+
+    Section _sections[MAX_PROFILED_SECTIONS];
+    size_t _sectionCount = 0;
+    char _loopLabels[32] = {};
+    Counter *_slowIterations = nullptr;
+
+    uint32_t _iterationStartedAtUS = 0;
+    uint32_t _lastIterationUS = 0;
+    const Section *_culprit = nullptr;
+
+    // handed out once the slots run out
+    Section _overflow;
+    LatencyTracker _overflowLatency;
+
+   public:
+    LoopProfiler(const char *loopName, const uint32_t slowThresholdUS, Registry &r = registry())
+        : _loopName(loopName), _slowThresholdUS(slowThresholdUS), _registry(r) {
+        snprintf(_loopLabels, sizeof(_loopLabels), "loop=\"%s\"", loopName);
+        _slowIterations = &r.counter("buff_loop_slow_iterations_total", "Loop iterations over the slow threshold", _loopLabels);
+        _overflow.name = "overflow";
+        _overflow.latency = &_overflowLatency;
+    }
+
+    // name has to outlive the profiler (a literal), returns the section's index
+    size_t addSection(const char *name) {
+        if (_sectionCount == MAX_PROFILED_SECTIONS) return MAX_PROFILED_SECTIONS;
+        auto &section = _sections[_sectionCount];
+        section.name = name;
+        snprintf(section.labels, sizeof(section.labels), "loop=\"%s\",section=\"%s\"", _loopName, name);
+        section.latency = &_registry.latency("buff_loop_section_duration_us", "Time spent in each subsystem per loop", section.labels);
+        return _sectionCount++;
+    }
+
+    void beginIteration(const uint32_t nowUS) {
+        _iterationStartedAtUS = nowUS;
+        for (size_t i = 0; i < _sectionCount; i++) {
+            _sections[i].lastUS = 0;
+        }
+    }
+
+    void recordSection(const size_t index, const uint32_t startedAtUS, const uint32_t endedAtUS) {
+        auto &section = index < _sectionCount ? _sections[index] : _overflow;
+        const uint32_t us = endedAtUS - startedAtUS;
+        section.lastUS += us;
+        section.latency->record(us);
+    }
+
+    // true if the iteration was slow, see culprit()
+    bool endIteration(const uint32_t nowUS) {
+        _lastIterationUS = nowUS - _iterationStartedAtUS;
+        _culprit = nullptr;
+        if (_lastIterationUS <= _slowThresholdUS) return false;
+
+        for (size_t i = 0; i < _sectionCount; i++) {
+            if (_culprit == nullptr || _sections[i].lastUS > _culprit->lastUS) {
+                _culprit = &_sections[i];
+            }
+        }
+        _slowIterations->inc();
+        return true;
+    }
+
+    const char *loopName() const { return _loopName; }
+    uint32_t lastIterationUS() const { return _lastIterationUS; }
+    // the slowest section of the last slow iteration, null if it wasn't slow
+    const Section *culprit() const { return _culprit; }
+    size_t sectionCount() const { return _sectionCount; }
+    const Section &section(const size_t index) const { return _sections[index]; }
+};
+
+}  // namespace metrics
+}  // namespace buff
+
+#ifdef BUFF_LOOP_PROFILER
+#include <Arduino.h>
+
+namespace buff {
+namespace metrics {
+
+const unsigned long SLOW_LOOP_LOG_INTERVAL_MS = 1000;
+
+// at most once per SLOW_LOOP_LOG_INTERVAL_MS per call site, so a run of slow
+// loops doesn't make itself worse by flooding Serial
+static void logSlowIteration(const LoopProfiler &profiler, unsigned long &lastLoggedAtMS, unsigned int &suppressed) {
+    if (millis() - lastLoggedAtMS < SLOW_LOOP_LOG_INTERVAL_MS) {
+        suppressed++;
+        return;
+    }
+    lastLoggedAtMS = millis();
+
+    Serial.print("[WARNING] Slow ");
+    Serial.print(profiler.loopName());
+    Serial.print(" loop us=");
+    Serial.print(profiler.lastIterationUS());
+    if (profiler.culprit() != nullptr) {
+        Serial.print(", culprit=");
+        Serial.print(profiler.culprit()->name);
+        Serial.print(" us=");
+        Serial.print(profiler.culprit()->lastUS);
+    }
+    Serial.print(", suppressed=");
+    Serial.println(suppressed);
+    suppressed = 0;
+}
+
+}  // namespace metrics
+}  // namespace buff
+
+#define BUFF_PROFILE_LOOP_DEFINE(profiler, loopName, slowThresholdUS)    \
+    buff::metrics::LoopProfiler &profiler() {                            \
+        static buff::metrics::LoopProfiler p(loopName, slowThresholdUS); \
+        return p;                                                        \
+    }
+
+#define BUFF_PROFILE_LOOP_BEGIN(profiler) profiler().beginIteration(micros())
+
+#define BUFF_PROFILE_LOOP_END(profiler)                                              \
+    do {                                                                             \
+        if (profiler().endIteration(micros())) {                                     \
+            static unsigned long lastLoggedAtMS = 0;                                 \
+            static unsigned int suppressed = 0;                                      \
+            buff::metrics::logSlowIteration(profiler(), lastLoggedAtMS, suppressed); \
+        }                                                                            \
+    } while (0)
+
+// the call can have commas in it, so it's the varargs
+#define BUFF_PROFILE(profiler, name, ...)                                         \
+    do {                                                                          \
+        static const size_t profiledSection = profiler().addSection(name);        \
+        const uint32_t profiledStartedAtUS = micros();                            \
+        __VA_ARGS__;                                                              \
+        profiler().recordSection(profiledSection, profiledStartedAtUS, micros()); \
+    } while (0)
+
+#else
+
+#define BUFF_PROFILE_LOOP_DEFINE(profiler, loopName, slowThresholdUS)
+#define BUFF_PROFILE_LOOP_BEGIN(profiler) \
+    do {                                  \
+    } while (0)
+#define BUFF_PROFILE_LOOP_END(profiler) \
+    do {                                \
+    } while (0)
+#define BUFF_PROFILE(profiler, name, ...) \
+    do {                                  \
+        __VA_ARGS__;                      \
+    } while (0)
+
+#endif
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <string>
+
+namespace buff {
+namespace metrics {
+
+const size_t MAX_COUNTERS = 16;
+const size_t MAX_GAUGES = 8;
+// a couple of loops plus BUFF_LOOP_PROFILER's per subsystem sections
+const size_t MAX_LATENCIES = 16;
+
+/*******************************
+ * Counter / Gauge
+ * A relaxed atomic each, so they can be bumped from any task or callback
+ * without a lock. 32 bits on purpose: 64 bit atomics aren't lock free on
+ * the ESP32.
+ *******************************/
+class Counter {
+   private:
+    std::atomic<uint32_t> _value{0};
+
+   public:
+    void inc(const uint32_t by = 1) { _value.fetch_add(by, std::memory_order_relaxed); }
+    uint32_t value() const { return _value.load(std::memory_order_relaxed); }
+};
+
+class Gauge {
+   private:
+    std::atomic<int32_t> _value{0};
+
+   public:
+    void set(const int32_t value) { _value.store(value, std::memory_order_relaxed); }
+    int32_t value() const { return _value.load(std::memory_order_relaxed); }
+};
+
+/*******************************
+ * LatencyTracker
+ * Percentiles over roughly the last WINDOW_SAMPLES..2*WINDOW_SAMPLES
+ * samples, from power of 2 buckets (so a percentile is the upper bound of
+ * its bucket, capped at the max seen). Recording is a handful of relaxed
+ * stores, no locks or allocation.
+ *
+ * Single writer: only record from one task. Reads from elsewhere see a
+ * slightly stale, possibly torn, snapshot, which is fine for a scrape.
+ *******************************/
+class LatencyTracker {
+   public:
+    static const size_t BUCKETS = 16;
+    // the first bucket is < 2^MIN_SHIFT us (64us), the last everything >= ~1s
+    static const uint8_t MIN_SHIFT = 6;
+    static const uint32_t WINDOW_SAMPLES = 4096;
+
+   private:
+    std::atomic<uint32_t> _current[BUCKETS] = {};
+    std::atomic<uint32_t> _previous[BUCKETS] = {};
+    std::atomic<uint32_t> _currentMaxUS{0};
+    std::atomic<uint32_t> _previousMaxUS{0};
+    // writer only
+    uint32_t _windowSamples = 0;
+
+    std::atomic<uint32_t> _count{0};
+
+    static size_t bucketFor(const uint32_t us) {
+        const uint8_t bits = us == 0 ? 0 : 32 - __builtin_clz(us);
+        if (bits <= MIN_SHIFT) return 0;
+        const size_t bucket = bits - MIN_SHIFT;
+        return bucket < BUCKETS ? bucket : BUCKETS - 1;
+    }
+
+    static void add(std::atomic<uint32_t> &value, const uint32_t by) {
+        value.store(value.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    void rollWindow() {
+        for (size_t i = 0; i < BUCKETS; i++) {
+            _previous[i].store(_current[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            _current[i].store(0, std::memory_order_relaxed);
+        }
+        _previousMaxUS.store(_currentMaxUS.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        _currentMaxUS.store(0, std::memory_order_relaxed);
+        _windowSamples = 0;
+    }
+
+   public:
+    static uint32_t bucketUpperBoundUS(const size_t bucket) { return 1UL << (bucket + MIN_SHIFT); }
+
+    void record(const uint32_t us) {
+        if (_windowSamples == WINDOW_SAMPLES) {
+            rollWindow();
+        }
+        _windowSamples++;
+
+        add(_current[bucketFor(us)], 1);
+        if (us > _currentMaxUS.load(std::memory_order_relaxed)) {
+            _currentMaxUS.store(us, std::memory_order_relaxed);
+        }
+        add(_count, 1);
+    }
+
+    uint32_t maxUS() const {
+        const uint32_t current = _currentMaxUS.load(std::memory_order_relaxed);
+        const uint32_t previous = _previousMaxUS.load(std::memory_order_relaxed);
+        return current > previous ? current : previous;
+    }
+
+    // eg 0.99 for p99, 0 if nothing's been recorded
+    uint32_t percentileUS(const float quantile) const {
+        uint32_t counts[BUCKETS];
+        uint32_t total = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            counts[i] = _current[i].load(std::memory_order_relaxed) + _previous[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        if (total == 0) return 0;
+
+        const uint32_t rank = (uint32_t)(quantile * total + 0.5f);
+        const uint32_t max = maxUS();
+        uint32_t seen = 0;
+        for (size_t i = 0; i < BUCKETS - 1; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                const uint32_t bound = bucketUpperBoundUS(i);
+                return bound < max ? bound : max;
+            }
+        }
+        return max;
+    }
+
+    // all time, not just the window
+    uint32_t count() const { return _count.load(std::memory_order_relaxed); }
+};
+
+/*******************************
+ * Registry
+ * Fixed slots of named metrics, rendered in the Prometheus text format.
+ * Registering takes a spinlock so it's safe from any task, but it's meant
+ * to happen once: hold on to the returned reference on hot paths.
+ *
+ * labels is the inside of the {}, eg R"(task="control")", and can be null.
+ * name, help and labels aren't copied, so they have to outlive the registry.
+ *******************************/
+class Registry {
+   private:
+    struct Entry {
+        const char *name = nullptr;
+        const char *help = nullptr;
+        const char *labels = nullptr;
+    };
+
+    std::atomic_flag _registering = ATOMIC_FLAG_INIT;
+
+    Counter _counters[MAX_COUNTERS];
+    Entry _counterEntries[MAX_COUNTERS];
+    std::atomic<size_t> _counterCount{0};
+
+    Gauge _gauges[MAX_GAUGES];
+    Entry _gaugeEntries[MAX_GAUGES];
+    std::atomic<size_t> _gaugeCount{0};
+
+    LatencyTracker _latencies[MAX_LATENCIES];
+    Entry _latencyEntries[MAX_LATENCIES];
+    std::atomic<size_t> _latencyCount{0};
+
+    // handed out once the slots run out, so callers never get a null
+    Counter _overflowCounter;
+    Gauge _overflowGauge;
+    LatencyTracker _overflowLatency;
+
+    template <typename T, size_t N>
+    T &add(T (&metrics)[N], Entry (&entries)[N], std::atomic<size_t> &count, T &overflow, const Entry &entry) {
+        while (_registering.test_and_set(std::memory_order_acquire)) {
+        }
+        T *metric = &overflow;
+        const size_t i = count.load(std::memory_order_relaxed);
+        if (i < N) {
+            entries[i] = entry;
+            metric = &metrics[i];
+            // render only reads entries below count
+            count.store(i + 1, std::memory_order_release);
+        }
+        _registering.clear(std::memory_order_release);
+        return *metric;
+    }
+
+    static bool sameName(const Entry &a, const Entry &b) { return strcmp(a.name, b.name) == 0; }
+
+    // Samples for a name have to be grouped under one TYPE line, whatever
+    // order they were registered in
+    template <typename T, typename RenderFunc>
+    static void renderAll(std::string &out, const T *metrics, const Entry *entries, const size_t count, const char *type, RenderFunc renderMetric) {
+        for (size_t i = 0; i < count; i++) {
+            bool rendered = false;
+            for (size_t j = 0; j < i && !rendered; j++) {
+                rendered = sameName(entries[i], entries[j]);
+            }
+            if (rendered) continue;
+
+            out += "# HELP ";
+            out += entries[i].name;
+            out += " ";
+            out += entries[i].help;
+            out += "\n# TYPE ";
+            out += entries[i].name;
+            out += " ";
+            out += type;
+            out += "\n";
+            for (size_t k = i; k < count; k++) {
+                if (sameName(entries[i], entries[k])) {
+                    renderMetric(entries[k], metrics[k]);
+                }
+            }
+        }
+    }
+
+    static void renderSample(std::string &out, const char *name, const char *suffix, const char *labels, const char *extraLabel, const long long value) {
+        char temp[160];
+        const bool hasLabels = labels != nullptr || extraLabel != nullptr;
+        snprintf(temp, sizeof(temp), "%s%s%s%s%s%s%s %lld\n",
+                 name, suffix,
+                 hasLabels ? "{" : "",
+                 labels != nullptr ? labels : "",
+                 labels != nullptr && extraLabel != nullptr ? "," : "",
+                 extraLabel != nullptr ? extraLabel : "",
+                 hasLabels ? "}" : "",
+                 value);
+        out += temp;
+    }
+
+   public:
+    Counter &counter(const char *name, const char *help, const char *labels = nullptr) {
+        return add(_counters, _counterEntries, _counterCount, _overflowCounter, {.name = name, .help = help, .labels = labels});
+    }
+
+    Gauge &gauge(const char *name, const char *help, const char *labels = nullptr) {
+        return add(_gauges, _gaugeEntries, _gaugeCount, _overflowGauge, {.name = name, .help = help, .labels = labels});
+    }
+
+    LatencyTracker &latency(const char *name, const char *help, const char *labels = nullptr) {
+        return add(_latencies, _latencyEntries, _latencyCount, _overflowLatency, {.name = name, .help = help, .labels = labels});
+    }
+
+    void render(std::string &out) const {
+        renderAll(out, _counters, _counterEntries, _counterCount.load(std::memory_order_acquire), "counter",
+                  [&](const Entry &entry, const Counter &counter) {
+                      renderSample(out, entry.name, "", entry.labels, nullptr, counter.value());
+                  });
+        renderAll(out, _gauges, _gaugeEntries, _gaugeCount.load(std::memory_order_acquire), "gauge",
+                  [&](const Entry &entry, const Gauge &gauge) {
+                      renderSample(out, entry.name, "", entry.labels, nullptr, gauge.value());
+                  });
+        renderAll(out, _latencies, _latencyEntries, _latencyCount.load(std::memory_order_acquire), "summary",
+                  [&](const Entry &entry, const LatencyTracker &latency) {
+                      renderSample(out, entry.name, "", entry.labels, R"(quantile="0.5")", latency.percentileUS(0.5));
+                      renderSample(out, entry.name, "", entry.labels, R"(quantile="0.9")", latency.percentileUS(0.9));
+                      renderSample(out, entry.name, "", entry.labels, R"(quantile="0.99")", latency.percentileUS(0.99));
+                      renderSample(out, entry.name, "", entry.labels, R"(quantile="1")", latency.maxUS());
+                      renderSample(out, entry.name, "_count", entry.labels, nullptr, latency.count());
+                  });
+    }
+};
+
+// the one registry /metrics renders
+inline Registry &registry() {
+    static Registry r;
+    return r;
+}
+
+/*******************************
+ * BuffMetrics
+ * What the firmware tracks, registered on first use.
+ *******************************/
+struct BuffMetrics {
+    Counter &mqttMessagesIn;
+    Counter &mqttMessagesOut;
+    Counter &mqttMessagesDropped;
+    Counter &httpRequests;
+    Counter &i2cReadFailures;
+    Counter &nvsWrites;
+
+    Gauge &heapFreeBytes;
+    Gauge &heapLargestFreeBlockBytes;
+    Gauge &heapMinFreeBytes;
+
+    LatencyTracker &controlLoopUS;
+    LatencyTracker &networkLoopUS;
+
+    explicit BuffMetrics(Registry &r)
+        : mqttMessagesIn(r.counter("buff_mqtt_messages_in_total", "MQTT messages received")),
+          mqttMessagesOut(r.counter("buff_mqtt_messages_out_total", "MQTT messages published")),
+          mqttMessagesDropped(r.counter("buff_mqtt_messages_dropped_total", "Outbound MQTT messages dropped before sending")),
+          httpRequests(r.counter("buff_http_requests_total", "HTTP requests handled")),
+          i2cReadFailures(r.counter("buff_i2c_read_failures_total", "Failed I2C sensor reads")),
+          nvsWrites(r.counter("buff_nvs_writes_total", "Writes to NVS (preferences)")),
+          heapFreeBytes(r.gauge("buff_heap_free_bytes", "Free heap")),
+          heapLargestFreeBlockBytes(r.gauge("buff_heap_largest_free_block_bytes", "Largest allocatable heap block")),
+          heapMinFreeBytes(r.gauge("buff_heap_min_free_bytes", "Lowest free heap since boot")),
+          controlLoopUS(r.latency("buff_loop_duration_us", "Loop iteration time", R"(task="control")")),
+          networkLoopUS(r.latency("buff_loop_duration_us", "Loop iteration time", R"(task="network")")) {}
+};
+
+inline BuffMetrics &buffMetrics() {
+    static BuffMetrics m(registry());
+    return m;
+}
+
+}  // namespace metrics
+}  // namespace buff
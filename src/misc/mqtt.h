@@ -6,6 +6,9 @@
 #include <ArduinoJson.h>
 #include <TinyMqtt.h>
 
+// Buff Libraries
+#include "metrics/metrics.h"
+
 namespace richiev {
 namespace mqtt {
 /*******************************
@@ -27,13 +30,13 @@ StaticJsonDocument<200> parseInput(const std::string payload) {
 }
 
 void onPublish(const MqttClient* /* srce */, const Topic& topic, const char* payloadC, size_t payloadLength) {
+    buff::metrics::buffMetrics().mqttMessagesIn.inc();
+
     std::string payload = payloadC;
     Serial.print("Received msg on topic=");
     Serial.print(topic.c_str());
     Serial.print(", payload=");
     Serial.print(payloadC);
-    Serial.print(", free_heap=");
-    Serial.print(xPortGetFreeHeapSize());
     Serial.println();
 
     if (topicsToProcessor->count(topic.c_str())) {
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cmath>
+
+namespace buff {
+namespace stats {
+
+/**
+ * Sliding window over fixed-point samples, keeping mean, variance, min, max
+ * and least-squares slope up to date in O(1) (amortized for min/max) per add.
+ *
+ * Samples are stored as int32 scaled by SCALE, sums are int64, so nothing
+ * accumulates float rounding error as samples enter & leave the window.
+ */
+template <size_t N, int32_t SCALE>
+class FixedPointWindow {
+   private:
+    // Monotonic deque of sample sequence numbers, used for min & max. Entries
+    // are always within the last N samples, so their values live in _data.
+    class MonotonicDeque {
+       private:
+        uint32_t _seqs[N];
+        size_t _head = 0;
+        size_t _size = 0;
+
+       public:
+        void reset() {
+            _head = 0;
+            _size = 0;
+        }
+
+        bool empty() const { return _size == 0; }
+        uint32_t front() const { return _seqs[_head]; }
+        uint32_t back() const { return _seqs[(_head + _size - 1) % N]; }
+        void popFront() {
+            _head = (_head + 1) % N;
+            _size--;
+        }
+        void popBack() { _size--; }
+        void pushBack(uint32_t seq) {
+            _seqs[(_head + _size) % N] = seq;
+            _size++;
+        }
+    };
+
+    int32_t _data[N];
+    uint32_t _nextSeq;
+    size_t _count;
+
+    int64_t _sum;
+    int64_t _sumSq;
+    // sum(i * y_i) with i = 0 for the oldest sample in the window
+    int64_t _sumIndexed;
+
+    MonotonicDeque _minSeqs;
+    MonotonicDeque _maxSeqs;
+
+    int32_t valueAt(uint32_t seq) const { return _data[seq % N]; }
+    uint32_t oldestSeq() const { return _nextSeq - _count; }
+
+   public:
+    FixedPointWindow() { reset(); }
+
+    void reset() {
+        _nextSeq = 0;
+        _count = 0;
+        _sum = _sumSq = _sumIndexed = 0;
+        _minSeqs.reset();
+        _maxSeqs.reset();
+    }
+
+    static int32_t toFixed(float value) { return lroundf(value * SCALE); }
+    static float fromFixed(double value) { return value / SCALE; }
+
+    void add(float value) { addFixed(toFixed(value)); }
+
+    void addFixed(int32_t value) {
+        if (_count == N) {
+            const int32_t dropped = valueAt(oldestSeq());
+            // every remaining sample moves one index closer to the front
+            _sumIndexed -= _sum - dropped;
+            _sum -= dropped;
+            _sumSq -= (int64_t)dropped * dropped;
+            _count--;
+        }
+
+        _sumIndexed += (int64_t)_count * value;
+        _sum += value;
+        _sumSq += (int64_t)value * value;
+
+        const uint32_t seq = _nextSeq++;
+        _data[seq % N] = value;
+        _count++;
+
+        const uint32_t oldest = oldestSeq();
+        while (!_minSeqs.empty() && _minSeqs.front() < oldest) _minSeqs.popFront();
+        while (!_maxSeqs.empty() && _maxSeqs.front() < oldest) _maxSeqs.popFront();
+        while (!_minSeqs.empty() && valueAt(_minSeqs.back()) >= value) _minSeqs.popBack();
+        while (!_maxSeqs.empty() && valueAt(_maxSeqs.back()) <= value) _maxSeqs.popBack();
+        _minSeqs.pushBack(seq);
+        _maxSeqs.pushBack(seq);
+    }
+
+    size_t size() const { return _count; }
+    bool full() const { return _count == N; }
+
+    int32_t lastFixed() const { return _count ? valueAt(_nextSeq - 1) : 0; }
+    int32_t minFixed() const { return _count ? valueAt(_minSeqs.front()) : 0; }
+    int32_t maxFixed() const { return _count ? valueAt(_maxSeqs.front()) : 0; }
+
+    float last() const { return fromFixed(lastFixed()); }
+    float min() const { return fromFixed(minFixed()); }
+    float max() const { return fromFixed(maxFixed()); }
+
+    float mean() const {
+        if (_count == 0) {
+            return 0;
+        }
+        return fromFixed((double)_sum / _count);
+    }
+
+    // Population variance, in (unscaled units)^2
+    float variance() const {
+        if (_count < 2) {
+            return 0;
+        }
+        const double n = _count;
+        const double scaledVariance = ((double)_sumSq - (double)_sum * _sum / n) / n;
+        return scaledVariance > 0 ? scaledVariance / ((double)SCALE * SCALE) : 0;
+    }
+
+    float stdDev() const { return sqrt(variance()); }
+
+    // Least-squares slope across the window, in unscaled units per sample
+    float slope() const {
+        if (_count < 2) {
+            return 0;
+        }
+        const int64_t n = _count;
+        const int64_t sumI = n * (n - 1) / 2;
+        const int64_t sumISq = (n - 1) * n * (2 * n - 1) / 6;
+        const int64_t denominator = n * sumISq - sumI * sumI;
+        return fromFixed((double)(n * _sumIndexed - sumI * _sum) / denominator);
+    }
+};
+
+}  // namespace stats
+}  // namespace buff
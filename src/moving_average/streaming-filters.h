@@ -0,0 +1,286 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace buff {
+namespace stats {
+
+/**
+ * Streaming filters. They all share the same shape so they can be swapped
+ * via a template parameter (see PHReadingStats):
+ *   float add(float)   add a sample, returns the new filtered value
+ *   float get() const  current filtered value
+ *   size_t size() const  samples seen (capped at the window size, if any)
+ *   void reset()
+ */
+
+// Passes samples through untouched, the default for PHReadingStats
+class PassThroughFilter {
+   private:
+    float _value = 0;
+    size_t _count = 0;
+
+   public:
+    float add(float input) {
+        _value = input;
+        if (_count == 0) _count = 1;
+        return _value;
+    }
+
+    float get() const { return _value; }
+    size_t size() const { return _count; }
+    void reset() {
+        _value = 0;
+        _count = 0;
+    }
+};
+
+// Simple moving average over the last N samples
+template <size_t N>
+class BoxcarFilter {
+   private:
+    float _data[N];
+    double _sum;
+    size_t _current;
+    size_t _count;
+
+   public:
+    BoxcarFilter() { reset(); }
+
+    float add(float input) {
+        if (_count == N) {
+            _sum -= _data[_current];
+        } else {
+            _count++;
+        }
+        _data[_current] = input;
+        _sum += input;
+        _current = (_current + 1) % N;
+        return get();
+    }
+
+    float get() const { return _count ? _sum / _count : 0; }
+    size_t size() const { return _count; }
+    void reset() {
+        _sum = 0;
+        _current = 0;
+        _count = 0;
+    }
+};
+
+// Exponential moving average, with the usual alpha = 2 / (N + 1) so it
+// smooths about as much as an N sample boxcar. Seeded with the first sample.
+template <size_t N>
+class EMAFilter {
+   private:
+    const float _alpha = 2.0 / (N + 1);
+    float _value;
+    size_t _count;
+
+   public:
+    EMAFilter() { reset(); }
+
+    float add(float input) {
+        if (_count == 0) {
+            _value = input;
+        } else {
+            _value += _alpha * (input - _value);
+        }
+        if (_count < N) _count++;
+        return _value;
+    }
+
+    float get() const { return _value; }
+    size_t size() const { return _count; }
+    void reset() {
+        _value = 0;
+        _count = 0;
+    }
+};
+
+/**
+ * Median of the last N samples, good at dropping single sample spikes (eg a
+ * bubble across the pH probe) that a boxcar would smear across the window.
+ *
+ * Samples are kept in a ring buffer, with each slot also sitting in one of two
+ * heaps: a max-heap of the lower half and a min-heap of the upper half. Adding
+ * a sample overwrites the oldest slot in place and re-sifts it, so it's
+ * O(log N) per sample with no allocation.
+ */
+template <size_t N>
+class RollingMedianFilter {
+   private:
+    struct HeapPos {
+        bool inLow;
+        size_t index;
+    };
+
+    float _data[N];
+    HeapPos _pos[N];
+
+    // heaps of slot indices into _data
+    size_t _low[N];  // max-heap
+    size_t _high[N];  // min-heap
+    size_t _lowSize;
+    size_t _highSize;
+
+    size_t _oldest;
+    size_t _count;
+
+    size_t *heap(bool low) { return low ? _low : _high; }
+    size_t &heapSize(bool low) { return low ? _lowSize : _highSize; }
+
+    // whether slot a belongs above slot b in the given heap
+    bool before(bool low, size_t a, size_t b) const {
+        return low ? _data[a] > _data[b] : _data[a] < _data[b];
+    }
+
+    void place(bool low, size_t index, size_t slot) {
+        heap(low)[index] = slot;
+        _pos[slot] = {low, index};
+    }
+
+    void swapEntries(bool low, size_t i, size_t j) {
+        size_t *h = heap(low);
+        const size_t slotI = h[i];
+        place(low, i, h[j]);
+        place(low, j, slotI);
+    }
+
+    void siftUp(bool low, size_t index) {
+        size_t *h = heap(low);
+        while (index > 0) {
+            const size_t parent = (index - 1) / 2;
+            if (!before(low, h[index], h[parent])) break;
+            swapEntries(low, index, parent);
+            index = parent;
+        }
+    }
+
+    void siftDown(bool low, size_t index) {
+        size_t *h = heap(low);
+        const size_t size = heapSize(low);
+        while (true) {
+            size_t best = index;
+            const size_t left = 2 * index + 1;
+            const size_t right = left + 1;
+            if (left < size && before(low, h[left], h[best])) best = left;
+            if (right < size && before(low, h[right], h[best])) best = right;
+            if (best == index) break;
+            swapEntries(low, index, best);
+            index = best;
+        }
+    }
+
+    void push(bool low, size_t slot) {
+        const size_t index = heapSize(low)++;
+        place(low, index, slot);
+        siftUp(low, index);
+    }
+
+    size_t popTop(bool low) {
+        size_t *h = heap(low);
+        const size_t top = h[0];
+        const size_t last = --heapSize(low);
+        if (last > 0) {
+            place(low, 0, h[last]);
+            siftDown(low, 0);
+        }
+        return top;
+    }
+
+    // keep every low value <= every high value after a single slot changed
+    void fixCross() {
+        if (_lowSize == 0 || _highSize == 0 || _data[_low[0]] <= _data[_high[0]]) return;
+        const size_t lowTop = _low[0];
+        place(true, 0, _high[0]);
+        place(false, 0, lowTop);
+        siftDown(true, 0);
+        siftDown(false, 0);
+    }
+
+   public:
+    RollingMedianFilter() { reset(); }
+
+    float add(float input) {
+        if (_count < N) {
+            const size_t slot = _count++;
+            _data[slot] = input;
+            push(_lowSize == 0 || input <= _data[_low[0]], slot);
+
+            // low holds the extra sample when the count is odd
+            if (_lowSize > _highSize + 1) {
+                push(false, popTop(true));
+            } else if (_highSize > _lowSize) {
+                push(true, popTop(false));
+            }
+        } else {
+            const size_t slot = _oldest;
+            _oldest = (_oldest + 1) % N;
+            _data[slot] = input;
+
+            const HeapPos pos = _pos[slot];
+            siftUp(pos.inLow, pos.index);
+            siftDown(pos.inLow, _pos[slot].index);
+            fixCross();
+        }
+        return get();
+    }
+
+    float get() const {
+        if (_count == 0) return 0;
+        if (_lowSize > _highSize) return _data[_low[0]];
+        return (_data[_low[0]] + _data[_high[0]]) / 2;
+    }
+
+    size_t size() const { return _count; }
+    void reset() {
+        _lowSize = _highSize = 0;
+        _oldest = 0;
+        _count = 0;
+    }
+};
+
+/**
+ * 1-D Kalman filter for a slowly changing value (eg pH between titration doses).
+ * processNoise is how much the true value is expected to wander per sample,
+ * measurementNoise is the variance of the sensor readings.
+ */
+class KalmanFilter1D {
+   private:
+    const float _processNoise;
+    const float _measurementNoise;
+
+    float _estimate;
+    float _errorCovariance;
+    size_t _count;
+
+   public:
+    KalmanFilter1D(float processNoise = 0.0001, float measurementNoise = 0.0025) : _processNoise(processNoise), _measurementNoise(measurementNoise) { reset(); }
+
+    float add(float input) {
+        if (_count == 0) {
+            _estimate = input;
+            _errorCovariance = _measurementNoise;
+        } else {
+            _errorCovariance += _processNoise;
+            const float gain = _errorCovariance / (_errorCovariance + _measurementNoise);
+            _estimate += gain * (input - _estimate);
+            _errorCovariance *= 1 - gain;
+        }
+        _count++;
+        return _estimate;
+    }
+
+    float get() const { return _estimate; }
+    size_t size() const { return _count; }
+    float errorCovariance() const { return _errorCovariance; }
+    void reset() {
+        _estimate = 0;
+        _errorCovariance = 0;
+        _count = 0;
+    }
+};
+
+}  // namespace stats
+}  // namespace buff
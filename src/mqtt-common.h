@@ -1,20 +1,29 @@
 #pragma once
 
 #include "readings/alk-measure-common.h"
+#include "readings/measurement-trace.h"
 #include "readings/ph-common.h"
+#include "readings/ph.h"
 
 namespace buff {
 namespace mqtt {
 const std::string alkRead("readings/alk");
+const std::string alkTraceRead("readings/alk/trace");
 const std::string measureAlk("execute/measure_alk");
 const std::string phRead("readings/ph");
+const std::string phCalibration("config/ph/calibration");
+const std::string phCalibrate("config/ph/calibrate");
+const std::string phCalibrationRead("readings/ph/calibration");
 
 // TODO: this should live outside mqtt
 class Publisher {
    public:
     virtual void publishPH(const ph::PHReading& phReading) = 0;
     virtual void publishAlkReading(const alk_measure::AlkReading& alkReading) = 0;
+    virtual void publishMeasurementTrace(const alk_measure::AlkReading& alkReading, const alk_measure::MeasurementTrace& trace) = 0;
     virtual void publishMeasureAlk(const std::string& title, const unsigned long asOfMS);
+    virtual void publishCalibratePH(const float actualPH, const unsigned long asOfMS) = 0;
+    virtual void publishPHCalibration(const ph::PHCalibrator& calibrator) = 0;
 
     virtual ~Publisher() {}
 };
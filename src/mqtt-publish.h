@@ -7,6 +7,8 @@
 #include <TinyMqtt.h>
 
 // Buff Libraries
+#include "concurrency/task-messages.h"
+#include "metrics/metrics.h"
 #include "mqtt-common.h"
 #include "readings/alk-measure.h"
 #include "readings/ph-common.h"
@@ -23,6 +25,7 @@ class MQTTPublisher : public Publisher {
         serializeJson(doc, serializedDoc);
 
         _mqttClient->publish(topic, serializedDoc);
+        metrics::buffMetrics().mqttMessagesOut.inc();
     }
 
     void publishPH(const ph::PHReading& phReading) {
@@ -34,6 +37,9 @@ class MQTTPublisher : public Publisher {
         updateDoc["rawPH_mavg"] = phReading.rawPH_mavg;
         updateDoc["calibratedPH"] = phReading.calibratedPH;
         updateDoc["calibratedPH_mavg"] = phReading.calibratedPH_mavg;
+        if (!std::isnan(phReading.temperatureC)) {
+            updateDoc["temperatureC"] = phReading.temperatureC;
+        }
 
         publishMessage(Topic(phRead), updateDoc);
     }
@@ -53,6 +59,45 @@ class MQTTPublisher : public Publisher {
         publishMessage(Topic(alkRead), updateDoc);
     }
 
+    // Has to fit in an OutboundMessage, so phases are [durationMS, busyMS, steps]
+    // and only the ones that ran are included
+    void publishMeasurementTrace(const alk_measure::AlkReading& alkReading, const alk_measure::MeasurementTrace& trace) {
+        DynamicJsonDocument updateDoc(1024);
+
+        updateDoc["asOfAdjustedSec"] = alkReading.asOfAdjustedSec;
+        updateDoc["title"] = alkReading.title;
+        updateDoc["totalMS"] = trace.totalDurationMS();
+
+        auto phasesDoc = updateDoc.createNestedObject("phases");
+        for (size_t action = 0; action < alk_measure::NUM_MEASUREMENT_ACTIONS; action++) {
+            const auto& phase = trace.phases[action];
+            if (phase.steps == 0) continue;
+            auto phaseDoc = phasesDoc.createNestedArray(alk_measure::MEASUREMENT_ACTION_TO_NAME.at((alk_measure::MeasurementAction)action));
+            phaseDoc.add(phase.durationMS);
+            phaseDoc.add(phase.busyMS);
+            phaseDoc.add(phase.steps);
+        }
+        updateDoc["doseSteps"] = trace.measureSteps[alk_measure::DOSE];
+        updateDoc["measurePHSteps"] = trace.measureSteps[alk_measure::MEASURE_PH];
+
+        auto doserDoc = updateDoc.createNestedObject("doser");
+        doserDoc["calls"] = trace.doserCalls;
+        doserDoc["totalMS"] = trace.doserBusyTotalMS;
+        doserDoc["maxMS"] = trace.doserBusyMaxMS;
+        auto bucketsDoc = doserDoc.createNestedArray("buckets");
+        for (auto count : trace.doserBusyBuckets) {
+            bucketsDoc.add(count);
+        }
+
+        auto samplesDoc = updateDoc.createNestedObject("phSamples");
+        samplesDoc["decisions"] = trace.decisions;
+        samplesDoc["min"] = trace.phSamplesPerDecisionMin;
+        samplesDoc["max"] = trace.phSamplesPerDecisionMax;
+        samplesDoc["total"] = trace.phSamplesTotal;
+
+        publishMessage(Topic(alkTraceRead), updateDoc);
+    }
+
     void publishMeasureAlk(const std::string& title, const unsigned long asOfMS) {
         DynamicJsonDocument updateDoc(128);
 
@@ -62,9 +107,74 @@ class MQTTPublisher : public Publisher {
         publishMessage(Topic(measureAlk), updateDoc);
     }
 
-   private:
+    void publishCalibratePH(const float actualPH, const unsigned long asOfMS) {
+        DynamicJsonDocument updateDoc(128);
+
+        updateDoc["asOf"] = asOfMS;
+        updateDoc["actualPH"] = actualPH;
+
+        publishMessage(Topic(phCalibrate), updateDoc);
+    }
+
+    void publishPHCalibration(const ph::PHCalibrator& calibrator) {
+        DynamicJsonDocument updateDoc(512);
+
+        updateDoc["calibrationTempC"] = calibrator.calibrationTempC();
+        auto points = updateDoc.createNestedArray("points");
+        for (auto& point : calibrator.points()) {
+            auto pointDoc = points.createNestedObject();
+            pointDoc["actualPH"] = point.actualPH;
+            pointDoc["readPH"] = point.readPH;
+        }
+
+        publishMessage(Topic(phCalibrationRead), updateDoc);
+    }
+
+   protected:
     std::shared_ptr<MqttClient> _mqttClient;
 };
 
+/*******************************
+ * QueuedPublisher
+ * For publishing off the network task: messages are serialized where they're
+ * published and queued, the network task sends them out via drain(). The
+ * queue is SPSC, so only publish from one task.
+ *******************************/
+class QueuedPublisher : public MQTTPublisher {
+   private:
+    std::shared_ptr<concurrency::OutboundQueue> _outbound;
+
+   public:
+    QueuedPublisher(std::shared_ptr<MqttClient> mqttClient, std::shared_ptr<concurrency::OutboundQueue> outbound) : MQTTPublisher(mqttClient), _outbound(outbound) {}
+
+    void publishMessage(const Topic& topic, const DynamicJsonDocument& doc) override {
+        concurrency::OutboundMessage message;
+        const std::string topicStr = topic.c_str();
+        if (!concurrency::copyBounded(message.topic, topicStr.c_str(), topicStr.size()) ||
+            measureJson(doc) >= sizeof(message.payload)) {
+            metrics::buffMetrics().mqttMessagesDropped.inc();
+            Serial.print("[WARNING] Message too large to queue, dropping topic=");
+            Serial.println(topic.c_str());
+            return;
+        }
+        serializeJson(doc, message.payload, sizeof(message.payload));
+
+        if (!_outbound->tryPush(message)) {
+            metrics::buffMetrics().mqttMessagesDropped.inc();
+            Serial.print("[WARNING] Outbound queue full, dropping topic=");
+            Serial.println(topic.c_str());
+        }
+    }
+
+    // network task only
+    void drain() {
+        concurrency::OutboundMessage message;
+        while (_outbound->tryPop(message)) {
+            _mqttClient->publish(Topic(message.topic), String(message.payload));
+            metrics::buffMetrics().mqttMessagesOut.inc();
+        }
+    }
+};
+
 }  // namespace mqtt
 }  // namespace buff
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+
+#include <memory>
+
+// Buff Libraries
+#include "buff-displays/monitoring-display.h"
+#include "doser/doser.h"
+#include "power/idle-power.h"
+#include "sensors/sensor-registry.h"
+
+namespace buff {
+namespace power {
+
+const uint32_t ACTIVE_CPU_MHZ = 240;
+// lowest that keeps the APB (and so I2S, UART & I2C timing) at 80MHz
+const uint32_t IDLE_CPU_MHZ = 80;
+
+/*******************************
+ * EspPowerHooks
+ * Steppers are parked through the shared disable pin, the radio goes to
+ * max modem sleep (it still wakes for DTIM beacons, so MQTT & the web server
+ * keep working, just with more latency).
+ *
+ * When the IDF is built with power management (CONFIG_PM_ENABLE) the
+ * scheduler's sleeps turn into automatic light sleep, otherwise the CPU is
+ * just clocked down.
+ *
+ * Call from the control task, parking steppers mid dose would stall it.
+ *******************************/
+class EspPowerHooks : public PowerHooks {
+   private:
+    const std::shared_ptr<doser::BuffDosers> _buffDosers;
+    const std::shared_ptr<sensors::SensorRegistry> _sensorRegistry;
+    const unsigned long _activePHSensorIntervalMS;
+    const unsigned long _idlePHSensorIntervalMS;
+
+   public:
+    EspPowerHooks(std::shared_ptr<doser::BuffDosers> buffDosers, std::shared_ptr<sensors::SensorRegistry> sensorRegistry, const unsigned long idlePHSensorIntervalMS)
+        : _buffDosers(buffDosers),
+          _sensorRegistry(sensorRegistry),
+          _activePHSensorIntervalMS(sensorRegistry->readIntervalMS(sensors::PH)),
+          _idlePHSensorIntervalMS(idlePHSensorIntervalMS) {}
+
+    void parkSteppers() override {
+        _buffDosers->disableDosers();
+    }
+
+    void setBacklight(const uint8_t brightness) override {
+        monitoring_display::setBacklight(brightness);
+    }
+
+    void setLowPower(const bool lowPower) override {
+        WiFi.setSleep(lowPower ? WIFI_PS_MAX_MODEM : WIFI_PS_MIN_MODEM);
+
+#if CONFIG_PM_ENABLE
+        esp_pm_config_esp32_t pmConfig = {
+            .max_freq_mhz = (int)ACTIVE_CPU_MHZ,
+            .min_freq_mhz = (int)(lowPower ? IDLE_CPU_MHZ : ACTIVE_CPU_MHZ),
+            .light_sleep_enable = lowPower};
+        esp_pm_configure(&pmConfig);
+#else
+        setCpuFrequencyMhz(lowPower ? IDLE_CPU_MHZ : ACTIVE_CPU_MHZ);
+#endif
+    }
+
+    void setSlowSampling(const bool slow) override {
+        _sensorRegistry->setReadIntervalMS(sensors::PH, slow ? _idlePHSensorIntervalMS : _activePHSensorIntervalMS);
+    }
+};
+
+}  // namespace power
+}  // namespace buff
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace buff {
+namespace power {
+
+enum PowerState {
+    ACTIVE,
+    // steppers parked, radio & CPU throttled, pH sampled slowly, display dimmed
+    IDLE,
+    // IDLE with the display off
+    BLANKED
+};
+
+static const std::map<PowerState, std::string> POWER_STATE_TO_NAME =
+    {{ACTIVE, "ACTIVE"},
+     {IDLE, "IDLE"},
+     {BLANKED, "BLANKED"}};
+
+// What woke it up, for logging
+enum WakeSource {
+    WAKE_TOUCH,
+    // a command, over MQTT or from the web UI
+    WAKE_MQTT,
+    // a measurement started (scheduled ones come in as commands too)
+    WAKE_MEASUREMENT
+};
+
+struct IdlePowerConfig {
+    // with no measurement running and no touches or commands
+    unsigned long idleAfterMS = 2 * 60 * 1000;
+    unsigned long blankAfterMS = 10 * 60 * 1000;
+
+    uint8_t activeBrightness = 255;
+    uint8_t idleBrightness = 40;
+
+    // pH sampling while not ACTIVE
+    unsigned long idlePHReadIntervalMS = 10000;
+};
+
+/*******************************
+ * PowerHooks
+ * The hardware side of each power state, see EspPowerHooks. Called from
+ * whichever task runs IdlePowerManager::loop.
+ *******************************/
+class PowerHooks {
+   public:
+    virtual void parkSteppers() = 0;
+    // 0 is off
+    virtual void setBacklight(const uint8_t brightness) = 0;
+    // radio power save & CPU clock
+    virtual void setLowPower(const bool lowPower) = 0;
+    // sensors read at their idle rate, rather than the configured one
+    virtual void setSlowSampling(const bool slow) = 0;
+
+    virtual ~PowerHooks() {}
+};
+
+/*******************************
+ * IdlePowerManager
+ * Winds the unit down between measurements and back up on a touch, a
+ * command or a measurement starting. Busy (a measurement running) always
+ * counts as active.
+ *
+ * wake() is safe from any task, it only flags the activity; loop() picks it
+ * up and drives the hooks, from one task.
+ *******************************/
+class IdlePowerManager {
+   private:
+    const IdlePowerConfig _config;
+    const std::shared_ptr<PowerHooks> _hooks;
+
+    // read by the other task to pick its poll rate
+    std::atomic<PowerState> _state{ACTIVE};
+    uint64_t _lastActivityMS = 0;
+    std::atomic<bool> _activityPending{false};
+    std::atomic<uint8_t> _lastWakeSource{WAKE_MEASUREMENT};
+
+    unsigned int _wakeCount = 0;
+
+    void enter(const PowerState state) {
+        if (state == _state) return;
+
+        if (state == ACTIVE) {
+            _hooks->setLowPower(false);
+            _hooks->setSlowSampling(false);
+            _hooks->setBacklight(_config.activeBrightness);
+            _wakeCount++;
+        } else {
+            if (_state == ACTIVE) {
+                _hooks->parkSteppers();
+                _hooks->setSlowSampling(true);
+                _hooks->setLowPower(true);
+            }
+            _hooks->setBacklight(state == IDLE ? _config.idleBrightness : 0);
+        }
+        _state = state;
+    }
+
+   public:
+    IdlePowerManager(std::shared_ptr<PowerHooks> hooks, const IdlePowerConfig config = IdlePowerConfig()) : _config(config), _hooks(hooks) {}
+
+    void wake(const WakeSource source) {
+        _lastWakeSource = source;
+        _activityPending.store(true, std::memory_order_release);
+    }
+
+    void loop(const uint64_t nowMS, const bool busy) {
+        if (_activityPending.exchange(false, std::memory_order_acq_rel)) {
+            _lastActivityMS = nowMS;
+        }
+        if (busy) {
+            if (_state != ACTIVE) _lastWakeSource = WAKE_MEASUREMENT;
+            _lastActivityMS = nowMS;
+        }
+
+        const uint64_t quietMS = nowMS - _lastActivityMS;
+        if (quietMS >= _config.blankAfterMS) {
+            enter(BLANKED);
+        } else if (quietMS >= _config.idleAfterMS) {
+            enter(IDLE);
+        } else {
+            enter(ACTIVE);
+        }
+    }
+
+    PowerState state() const { return _state; }
+    WakeSource lastWakeSource() const { return (WakeSource)_lastWakeSource.load(); }
+    unsigned int wakeCount() const { return _wakeCount; }
+
+    const IdlePowerConfig &config() const { return _config; }
+
+    unsigned long phReadIntervalMS(const unsigned long activeIntervalMS) const {
+        return _state == ACTIVE ? activeIntervalMS : _config.idlePHReadIntervalMS;
+    }
+};
+
+}  // namespace power
+}  // namespace buff
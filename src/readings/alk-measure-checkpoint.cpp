@@ -0,0 +1,75 @@
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "metrics/metrics.h"
+#include "readings/alk-measure-checkpoint.h"
+
+namespace buff {
+namespace alk_measure {
+
+// kept separate from the reading store so clearing one doesn't touch the other
+const char* CHECKPOINT_PREFERENCE_NS = "buff-ckpt";
+
+/************
+ * I/O
+ ***********/
+Preferences checkpointPreferences;
+
+#define CHECKPOINT_STATE_KEY "state"
+#define CHECKPOINT_TITLE_KEY "title"
+
+// Written as one blob, so a reboot mid-write can't leave a mix of old & new
+// values. A size mismatch (firmware with a different layout) reads as no checkpoint.
+struct PersistedCheckpoint {
+    unsigned char nextAction;
+    unsigned char nextMeasurementStepAction;
+    float tankWaterVolumeML;
+    float reagentVolumeML;
+    AlkMeasurementConfig alkMeasureConf;
+};
+
+void persistCheckpoint(const MeasurementCheckpoint& checkpoint) {
+    PersistedCheckpoint persisted = {
+        .nextAction = static_cast<unsigned char>(checkpoint.nextAction),
+        .nextMeasurementStepAction = static_cast<unsigned char>(checkpoint.nextMeasurementStepAction),
+        .tankWaterVolumeML = checkpoint.tankWaterVolumeML,
+        .reagentVolumeML = checkpoint.reagentVolumeML,
+        .alkMeasureConf = checkpoint.alkMeasureConf};
+
+    checkpointPreferences.begin(CHECKPOINT_PREFERENCE_NS, false);
+    checkpointPreferences.putString(CHECKPOINT_TITLE_KEY, checkpoint.title.c_str());
+    checkpointPreferences.putBytes(CHECKPOINT_STATE_KEY, &persisted, sizeof(persisted));
+    checkpointPreferences.end();
+    metrics::buffMetrics().nvsWrites.inc(2);
+}
+
+std::unique_ptr<MeasurementCheckpoint> readCheckpoint() {
+    checkpointPreferences.begin(CHECKPOINT_PREFERENCE_NS, true);
+
+    PersistedCheckpoint persisted;
+    std::unique_ptr<MeasurementCheckpoint> checkpoint = nullptr;
+    if (checkpointPreferences.getBytesLength(CHECKPOINT_STATE_KEY) == sizeof(persisted) &&
+        checkpointPreferences.getBytes(CHECKPOINT_STATE_KEY, &persisted, sizeof(persisted)) == sizeof(persisted) &&
+        persisted.nextAction != MEASURE_DONE) {
+        checkpoint = std::make_unique<MeasurementCheckpoint>();
+        checkpoint->nextAction = static_cast<MeasurementAction>(persisted.nextAction);
+        checkpoint->nextMeasurementStepAction = static_cast<MeasurementStepAction>(persisted.nextMeasurementStepAction);
+        checkpoint->tankWaterVolumeML = persisted.tankWaterVolumeML;
+        checkpoint->reagentVolumeML = persisted.reagentVolumeML;
+        checkpoint->alkMeasureConf = persisted.alkMeasureConf;
+        checkpoint->title = checkpointPreferences.getString(CHECKPOINT_TITLE_KEY).c_str();
+    }
+
+    checkpointPreferences.end();
+    return std::move(checkpoint);
+}
+
+void clearCheckpoint() {
+    checkpointPreferences.begin(CHECKPOINT_PREFERENCE_NS, false);
+    checkpointPreferences.clear();
+    checkpointPreferences.end();
+    metrics::buffMetrics().nvsWrites.inc();
+}
+
+}  // namespace alk_measure
+}  // namespace buff
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+// Buff Libraries
+#include "readings/alk-measure-common.h"
+#include "readings/alk-measure.h"
+
+namespace buff {
+namespace alk_measure {
+
+/************
+ * Checkpoints
+ * Enough of a MeasurementStepResult to pick a measurement back up after a
+ * reboot. pH stats aren't kept, those just get re-sampled.
+ ***********/
+struct MeasurementCheckpoint {
+    MeasurementAction nextAction = MEASURE_DONE;
+    MeasurementStepAction nextMeasurementStepAction = STEP_INITIALIZE;
+
+    float tankWaterVolumeML = 0.0;
+    float reagentVolumeML = 0.0;
+
+    std::string title;
+
+    AlkMeasurementConfig alkMeasureConf;
+};
+
+template <size_t NUM_SAMPLES>
+MeasurementCheckpoint checkpointFromStep(const MeasurementStepResult<NUM_SAMPLES> &stepResult) {
+    MeasurementCheckpoint checkpoint;
+    checkpoint.nextAction = stepResult.nextAction;
+    checkpoint.nextMeasurementStepAction = stepResult.nextMeasurementStepAction;
+    checkpoint.tankWaterVolumeML = stepResult.alkReading.tankWaterVolumeML;
+    checkpoint.reagentVolumeML = stepResult.alkReading.reagentVolumeML;
+    checkpoint.title = stepResult.alkReading.title;
+    checkpoint.alkMeasureConf = stepResult.alkMeasureConf;
+    return checkpoint;
+}
+
+// Only phase changes, and the steps either side of a dose, are worth a flash
+// write. Re-sampling pH after a reboot is cheap, losing track of reagent isn't.
+template <size_t NUM_SAMPLES>
+bool shouldCheckpoint(const MeasurementStepResult<NUM_SAMPLES> &prevResult, const MeasurementStepResult<NUM_SAMPLES> &nextResult) {
+    if (prevResult.nextAction != nextResult.nextAction) {
+        return true;
+    }
+    if (prevResult.nextMeasurementStepAction != nextResult.nextMeasurementStepAction) {
+        return prevResult.nextMeasurementStepAction == DOSE || nextResult.nextMeasurementStepAction == DOSE;
+    }
+    return false;
+}
+
+// Decides where a measurement interrupted at checkpoint should pick back up:
+// * nothing measured yet (PRIME, CLEAN_AND_FILL) -> redo that phase, both drain first
+// * measuring, with a known reagent volume -> re-sample pH and carry on
+// * mid-dose, or already cleaning up -> the vessel contents can't be trusted,
+//   so just clean up without publishing
+template <size_t NUM_SAMPLES>
+MeasurementStepResult<NUM_SAMPLES> resumeFromCheckpoint(AlkMeasurer &alkMeasurer, const MeasurementCheckpoint &checkpoint, const uint64_t asOfMS, const unsigned long asOfAdjustedSec) {
+    auto r = alkMeasurer.begin<NUM_SAMPLES>(checkpoint.alkMeasureConf, asOfMS, asOfAdjustedSec, checkpoint.title);
+
+    switch (checkpoint.nextAction) {
+        case PRIME:
+        case MEASURE_DONE:
+            r.nextAction = checkpoint.nextAction;
+            break;
+        case CLEAN_AND_FILL:
+            r.nextAction = CLEAN_AND_FILL;
+            break;
+        case MEASURE:
+            if (checkpoint.nextMeasurementStepAction == DOSE) {
+                r.nextAction = ABORT_CLEANUP;
+            } else {
+                r.nextAction = MEASURE;
+                r.nextMeasurementStepAction = STEP_INITIALIZE;
+                r.alkReading.tankWaterVolumeML = checkpoint.tankWaterVolumeML;
+                r.alkReading.reagentVolumeML = checkpoint.reagentVolumeML;
+            }
+            break;
+        case CLEANUP:
+        case ABORT_CLEANUP:
+            r.nextAction = ABORT_CLEANUP;
+            break;
+    }
+    return r;
+}
+
+void persistCheckpoint(const MeasurementCheckpoint &checkpoint);
+// nullptr if there's no measurement in flight
+std::unique_ptr<MeasurementCheckpoint> readCheckpoint();
+void clearCheckpoint();
+
+}  // namespace alk_measure
+}  // namespace buff
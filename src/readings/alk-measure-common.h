@@ -1,15 +1,50 @@
 #pragma once
 
+#include <map>
 #include <string>
 
 // Buff Libraries
+#include "doser/doser-config.h"
 #include "readings/ph.h"
 
 namespace buff {
 namespace alk_measure {
 
+enum MeasurementAction {
+    PRIME,
+    CLEAN_AND_FILL,
+    MEASURE,
+    CLEANUP,
+    MEASURE_DONE,
+    // drain & refill without publishing, for a measurement that can't be trusted
+    // anymore (eg it was interrupted by a reboot mid-dose)
+    ABORT_CLEANUP
+};
+
+static const std::map<MeasurementAction, std::string> MEASUREMENT_ACTION_TO_NAME =
+    {{PRIME, "PRIME"},
+     {CLEAN_AND_FILL, "CLEAN_AND_FILL"},
+     {MEASURE, "MEASURE"},
+     {CLEANUP, "CLEANUP"},
+     {MEASURE_DONE, "MEASURE_DONE"},
+     {ABORT_CLEANUP, "ABORT_CLEANUP"}};
+
+enum MeasurementStepAction {
+    STEP_INITIALIZE,
+    MEASURE_PH,
+    DOSE,
+    STEP_DONE
+};
+
+static const std::map<MeasurementStepAction, std::string> MEASUREMENT_STEP_ACTION_TO_NAME =
+    {{STEP_INITIALIZE, "STEP_INITIALIZE"},
+     {MEASURE_PH, "MEASURE_PH"},
+     {DOSE, "DOSE"},
+     {STEP_DONE, "STEP_DONE"}};
+
 struct AlkReading {
-    unsigned long asOfMS = 0;
+    // buff_time::monotonicMS
+    uint64_t asOfMS = 0;
     unsigned long asOfAdjustedSec = 0;
 
     float tankWaterVolumeML = 0.0;
@@ -60,6 +95,11 @@ struct AlkMeasurementConfig {
     // to adjust the calculated result by a configured value. Is effectively
     // the same as just adjusting the reagentStrengthMoles value
     float calibrationMultiplier = 1.0;
+
+    // which doser fills the measurement vessel, and how much to flush through
+    // it first. Normally set from the SampleSource matching the title.
+    MeasurementDoserType sampleDoserType = FILL;
+    float sampleFlushVolumeML = 0;
 };
 
 }  // namespace alk_measure
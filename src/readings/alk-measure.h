@@ -7,40 +7,13 @@
 #include "mqtt-common.h"
 #include "readings/ph-controller.h"
 #include "readings/alk-measure-common.h"
+#include "readings/measurement-trace.h"
 #include "readings/ph.h"
 #include "time-common.h"
 
 namespace buff {
 namespace alk_measure {
 
-enum MeasurementAction {
-    PRIME,
-    CLEAN_AND_FILL,
-    MEASURE,
-    CLEANUP,
-    MEASURE_DONE
-};
-
-static const std::map<MeasurementAction, std::string> MEASUREMENT_ACTION_TO_NAME =
-    {{PRIME, "PRIME"},
-     {CLEAN_AND_FILL, "CLEAN_AND_FILL"},
-     {MEASURE, "MEASURE"},
-     {CLEANUP, "CLEANUP"},
-     {MEASURE_DONE, "MEASURE_DONE"}};
-
-enum MeasurementStepAction {
-    STEP_INITIALIZE,
-    MEASURE_PH,
-    DOSE,
-    STEP_DONE
-};
-
-static const std::map<MeasurementStepAction, std::string> MEASUREMENT_STEP_ACTION_TO_NAME =
-    {{STEP_INITIALIZE, "STEP_INITIALIZE"},
-     {MEASURE_PH, "MEASURE_PH"},
-     {DOSE, "DOSE"},
-     {STEP_DONE, "STEP_DONE"}};
-
 static void stirForABit(doser::BuffDosers &buffDosers, const AlkMeasurementConfig &alkMeasureConf) {
     std::shared_ptr<doser::Doser> drainDoser = buffDosers.selectDoser(MeasurementDoserType::DRAIN);
 
@@ -52,7 +25,7 @@ static void stirForABit(doser::BuffDosers &buffDosers, const AlkMeasurementConfi
 // using them for measurement that we don't miss some initial drops. This
 // helps counteract the effects of any back-siphoning.
 static void primeDosers(std::shared_ptr<doser::BuffDosers> buffDosers, const AlkMeasurementConfig &alkMeasureConf) {
-    std::shared_ptr<doser::Doser> waterFillDoser = buffDosers->selectDoser(MeasurementDoserType::FILL);
+    std::shared_ptr<doser::Doser> waterFillDoser = buffDosers->selectDoser(alkMeasureConf.sampleDoserType);
     std::shared_ptr<doser::Doser> reagentDoser = buffDosers->selectDoser(MeasurementDoserType::REAGENT);
 
     waterFillDoser->doseML(alkMeasureConf.primeTankWaterFillVolumeML / 2.0);
@@ -61,6 +34,18 @@ static void primeDosers(std::shared_ptr<doser::BuffDosers> buffDosers, const Alk
     waterFillDoser->doseML(alkMeasureConf.primeTankWaterFillVolumeML / 2.0);
 }
 
+// Pushes water from the sample source through the line and back out the
+// drain, so the measurement isn't diluted by whichever tank was sampled last.
+static void flushSampleLine(doser::BuffDosers &buffDosers, const AlkMeasurementConfig &alkMeasureConf) {
+    if (alkMeasureConf.sampleFlushVolumeML <= 0) return;
+
+    std::shared_ptr<doser::Doser> waterFillDoser = buffDosers.selectDoser(alkMeasureConf.sampleDoserType);
+    std::shared_ptr<doser::Doser> drainDoser = buffDosers.selectDoser(MeasurementDoserType::DRAIN);
+
+    waterFillDoser->doseML(alkMeasureConf.sampleFlushVolumeML);
+    drainDoser->doseML(alkMeasureConf.sampleFlushVolumeML);
+}
+
 static void drainMeasurementVessel(doser::BuffDosers &buffDosers, const AlkMeasurementConfig &alkMeasureConf) {
     std::shared_ptr<doser::Doser> drainDoser = buffDosers.selectDoser(MeasurementDoserType::DRAIN);
 
@@ -68,7 +53,7 @@ static void drainMeasurementVessel(doser::BuffDosers &buffDosers, const AlkMeasu
 }
 
 static void fillMeasurementVessel(doser::BuffDosers &buffDosers, const AlkMeasurementConfig &alkMeasureConf, AlkReading &alkReading) {
-    std::shared_ptr<doser::Doser> waterFillDoser = buffDosers.selectDoser(MeasurementDoserType::FILL);
+    std::shared_ptr<doser::Doser> waterFillDoser = buffDosers.selectDoser(alkMeasureConf.sampleDoserType);
 
     waterFillDoser->doseML(alkMeasureConf.measurementTankWaterVolumeML);
     alkReading.tankWaterVolumeML += alkMeasureConf.measurementTankWaterVolumeML;
@@ -89,6 +74,16 @@ static bool hitPHTarget(const float ph) {
     return ph < practicalTargetPH;
 }
 
+// doser calls block, so this is how long the pumps held up the step
+template <typename DoseFunc>
+static void timeDoser(const std::shared_ptr<MeasurementTrace> &trace, DoseFunc dose) {
+    const unsigned long startedAtMS = millis();
+    dose();
+    if (trace) {
+        trace->recordDoserBusy(millis() - startedAtMS);
+    }
+}
+
 static float round2Decimals(const float f) {
     return roundf(f * 100.0) / 100.0;
 }
@@ -99,12 +94,31 @@ static float calcAlkReading(const AlkReading &alkReading, const AlkMeasurementCo
     return round2Decimals(dkh);
 }
 
+/*******************************
+ * DosersHold
+ * One run's hold on the dosers (see doser::BuffDosers). Every step result of
+ * the run shares it, so it's let go at MEASURE_DONE, or once the last step
+ * result of an abandoned run is gone, eg its looper was replaced.
+ *******************************/
+class DosersHold {
+   private:
+    const std::shared_ptr<doser::BuffDosers> _buffDosers;
+
+   public:
+    DosersHold(std::shared_ptr<doser::BuffDosers> buffDosers) : _buffDosers(buffDosers) {}
+    ~DosersHold() { _buffDosers->releaseMeasurement(); }
+
+    DosersHold(const DosersHold &) = delete;
+    DosersHold &operator=(const DosersHold &) = delete;
+};
+
 template <size_t NUM_SAMPLES>
 class MeasurementStepResult {
    public:
-    unsigned long measurementStartedAtMS;
+    // buff_time::monotonicMS
+    uint64_t measurementStartedAtMS;
 
-    unsigned long asOfMS;
+    uint64_t asOfMS;
     unsigned long asOfAdjustedSec;
     MeasurementAction nextAction;
     MeasurementStepAction nextMeasurementStepAction;
@@ -113,15 +127,33 @@ class MeasurementStepResult {
     AlkReading primeAndCleanupScratchData;
 
     std::shared_ptr<ph::controller::PHReadingStats<NUM_SAMPLES>> measuredPHStats;
+    // shared by every step of the run
+    std::shared_ptr<MeasurementTrace> trace;
+    // from the run's first step through to MEASURE_DONE
+    std::shared_ptr<DosersHold> dosersHold;
 
     AlkMeasurementConfig alkMeasureConf;
 
-    void setTime(const unsigned long asOf, const unsigned long asOfAdjustedSec) {
+    // the step scheduler's check, 64-bit so it keeps working past millis()'s wrap
+    bool nextStepDue(const uint64_t nowMS, const unsigned long stepIntervalMS) const {
+        return asOfMS + stepIntervalMS <= nowMS;
+    }
+
+    void setTime(const uint64_t asOf, const unsigned long asOfAdjustedSec) {
         this->asOfMS = alkReading.asOfMS = primeAndCleanupScratchData.asOfMS = asOf;
         this->asOfAdjustedSec = alkReading.asOfAdjustedSec = primeAndCleanupScratchData.asOfAdjustedSec = asOfAdjustedSec;
     }
 };
 
+// the step finished sampling pH and took a decision on it, ie a point on the
+// titration curve
+template <size_t NUM_SAMPLES>
+bool tookPHDecision(const MeasurementStepResult<NUM_SAMPLES> &prevResult, const MeasurementStepResult<NUM_SAMPLES> &result) {
+    return prevResult.nextAction == MEASURE &&
+           prevResult.nextMeasurementStepAction == MEASURE_PH &&
+           result.nextMeasurementStepAction != MEASURE_PH;
+}
+
 class AlkMeasurer {
    private:
     std::shared_ptr<doser::BuffDosers> _buffDosers;
@@ -132,53 +164,96 @@ class AlkMeasurer {
     AlkMeasurer(std::shared_ptr<doser::BuffDosers> buffDosers, const AlkMeasurementConfig alkMeasureConf, const std::shared_ptr<ph::controller::PHReader> phReader) : _buffDosers(buffDosers), _defaultAlkMeasurementConf(alkMeasureConf), _phReader(phReader) {}
 
     template <size_t NUM_SAMPLES>
-    MeasurementStepResult<NUM_SAMPLES> begin(const unsigned long asOfMS, const unsigned long asOfAdjustedSec, const std::string &title) {
+    MeasurementStepResult<NUM_SAMPLES> begin(const uint64_t asOfMS, const unsigned long asOfAdjustedSec, const std::string &title) {
         return begin<NUM_SAMPLES>(_defaultAlkMeasurementConf, asOfMS, asOfAdjustedSec, title);
     }
 
     template <size_t NUM_SAMPLES>
-    MeasurementStepResult<NUM_SAMPLES> begin(const AlkMeasurementConfig &alkMeasureConf, const unsigned long asOfMS, const unsigned long asOfAdjustedSec, const std::string &title) {
+    MeasurementStepResult<NUM_SAMPLES> begin(const AlkMeasurementConfig &alkMeasureConf, const uint64_t asOfMS, const unsigned long asOfAdjustedSec, const std::string &title) {
         MeasurementStepResult<NUM_SAMPLES> r;
         r.nextAction = PRIME;
         r.nextMeasurementStepAction = STEP_INITIALIZE;
         r.alkMeasureConf = alkMeasureConf;
+        auto sampleSource = _buffDosers->findSampleSource(title);
+        if (sampleSource != nullptr) {
+            r.alkMeasureConf.sampleDoserType = sampleSource->doserType;
+            r.alkMeasureConf.sampleFlushVolumeML = sampleSource->flushVolumeML;
+        }
         r.measurementStartedAtMS = asOfMS;
         r.setTime(asOfMS, asOfAdjustedSec);
         r.alkReading.title = title;
+        r.trace = std::make_shared<MeasurementTrace>();
         return r;
     }
 
     template <size_t NUM_SAMPLES>
     MeasurementStepResult<NUM_SAMPLES> measureAlk(std::shared_ptr<mqtt::Publisher> publisher, std::shared_ptr<buff_time::TimeWrapper> timeClient, const MeasurementStepResult<NUM_SAMPLES> &prevResult) {
+        if (prevResult.trace == nullptr) {
+            // eg resumed from a checkpoint, which doesn't keep the trace
+            auto resumed = prevResult;
+            resumed.trace = std::make_shared<MeasurementTrace>();
+            return measureAlk(publisher, timeClient, resumed);
+        }
+
+        if (prevResult.nextAction != MEASURE_DONE && prevResult.dosersHold == nullptr) {
+            // the run's first step, PRIME or wherever a checkpoint resumed
+            if (!_buffDosers->tryHoldForMeasurement()) {
+                // doses or another run have the dosers, try again next step
+                auto waiting = prevResult;
+                waiting.setTime(timeClient->getMonotonicMS(), timeClient->getAdjustedTimeSeconds());
+                return waiting;
+            }
+            auto held = prevResult;
+            held.dosersHold = std::make_shared<DosersHold>(_buffDosers);
+            return measureAlk(publisher, timeClient, held);
+        }
+
+        const unsigned long stepStartedAtMS = millis();
+        auto r = measureAlkStep(publisher, timeClient, prevResult);
+        if (r.nextAction == MEASURE_DONE) {
+            // let go once the previous step's copies are gone too
+            r.dosersHold.reset();
+        }
+        if (prevResult.nextAction != MEASURE_DONE) {
+            r.trace->recordStep(prevResult.nextAction, prevResult.nextMeasurementStepAction, stepStartedAtMS, millis());
+        }
+        if (prevResult.nextAction == CLEANUP) {
+            publisher->publishMeasurementTrace(r.alkReading, *r.trace);
+        }
+        return r;
+    }
+
+   private:
+    template <size_t NUM_SAMPLES>
+    MeasurementStepResult<NUM_SAMPLES> measureAlkStep(std::shared_ptr<mqtt::Publisher> publisher, std::shared_ptr<buff_time::TimeWrapper> timeClient, const MeasurementStepResult<NUM_SAMPLES> &prevResult) {
         // TODO: wrap this in a transaction/finally equivalent
         if (prevResult.nextAction == PRIME) {
             MeasurementStepResult<NUM_SAMPLES> r = prevResult;
 
-            _buffDosers->enableDosers();
-
             // Get everything primed and cleared out
-            primeDosers(_buffDosers, r.alkMeasureConf);
-            drainMeasurementVessel(*_buffDosers, r.alkMeasureConf);
-            fillMeasurementVessel(*_buffDosers, r.alkMeasureConf, r.primeAndCleanupScratchData);
-            stirForABit(*_buffDosers, r.alkMeasureConf);
+            timeDoser(r.trace, [&]() { flushSampleLine(*_buffDosers, r.alkMeasureConf); });
+            timeDoser(r.trace, [&]() { primeDosers(_buffDosers, r.alkMeasureConf); });
+            timeDoser(r.trace, [&]() { drainMeasurementVessel(*_buffDosers, r.alkMeasureConf); });
+            timeDoser(r.trace, [&]() { fillMeasurementVessel(*_buffDosers, r.alkMeasureConf, r.primeAndCleanupScratchData); });
+            timeDoser(r.trace, [&]() { stirForABit(*_buffDosers, r.alkMeasureConf); });
 
             r.nextAction = CLEAN_AND_FILL;
 
-            r.setTime(millis(), timeClient->getAdjustedTimeSeconds());
+            r.setTime(timeClient->getMonotonicMS(), timeClient->getAdjustedTimeSeconds());
             return r;
         } else if (prevResult.nextAction == CLEAN_AND_FILL) {
             MeasurementStepResult<NUM_SAMPLES> r = prevResult;
 
             // Start the measurement
-            drainMeasurementVessel(*_buffDosers, r.alkMeasureConf);
-            fillMeasurementVessel(*_buffDosers, r.alkMeasureConf, r.alkReading);
+            timeDoser(r.trace, [&]() { drainMeasurementVessel(*_buffDosers, r.alkMeasureConf); });
+            timeDoser(r.trace, [&]() { fillMeasurementVessel(*_buffDosers, r.alkMeasureConf, r.alkReading); });
 
-            addReagentDose(*_buffDosers, r.alkMeasureConf.initialReagentDoseVolumeML, r.alkReading);
-            stirForABit(*_buffDosers, r.alkMeasureConf);
+            timeDoser(r.trace, [&]() { addReagentDose(*_buffDosers, r.alkMeasureConf.initialReagentDoseVolumeML, r.alkReading); });
+            timeDoser(r.trace, [&]() { stirForABit(*_buffDosers, r.alkMeasureConf); });
 
             r.nextAction = MEASURE;
             r.nextMeasurementStepAction = STEP_INITIALIZE;
-            r.setTime(millis(), timeClient->getAdjustedTimeSeconds());
+            r.setTime(timeClient->getMonotonicMS(), timeClient->getAdjustedTimeSeconds());
             return r;
         } else if (prevResult.nextAction == MEASURE) {
             MeasurementStepResult<NUM_SAMPLES> r = prevResult;
@@ -187,11 +262,12 @@ class AlkMeasurer {
                 r.measuredPHStats = std::make_shared<ph::controller::PHReadingStats<NUM_SAMPLES>>();
                 r.nextMeasurementStepAction = MeasurementStepAction::MEASURE_PH;
             } else if (prevResult.nextMeasurementStepAction == MeasurementStepAction::MEASURE_PH) {
-                auto newPHReading = _phReader->readNewPHSignal();
-                auto phReading = r.measuredPHStats->adPHReading(newPHReading);
+                auto phReading = _phReader->readNewPHSignalWithStats(*r.measuredPHStats, timeClient->getMonotonicMS());
                 r.alkReading.phReading = phReading;
+                r.trace->recordPHSample();
 
                 if (r.measuredPHStats->receivedMinReadings()) {
+                    r.trace->recordDecision();
                     if (hitPHTarget(r.alkReading.phReading.calibratedPH_mavg)) {
                         r.nextAction = CLEANUP;
                         r.nextMeasurementStepAction = STEP_DONE;
@@ -210,8 +286,8 @@ class AlkMeasurer {
                 // the stirrer should be stopped before attempting to measure the pH. However I think the change is
                 // small enough that it doesn't really matter. Especially given during calibration I tend to keep the
                 // fluid in motion anyway.
-                addReagentDose(*_buffDosers, r.alkMeasureConf.incrementalReagentDoseVolumeML, r.alkReading);
-                stirForABit(*_buffDosers, r.alkMeasureConf);
+                timeDoser(r.trace, [&]() { addReagentDose(*_buffDosers, r.alkMeasureConf.incrementalReagentDoseVolumeML, r.alkReading); });
+                timeDoser(r.trace, [&]() { stirForABit(*_buffDosers, r.alkMeasureConf); });
 
                 r.nextMeasurementStepAction = STEP_INITIALIZE;
             } else {
@@ -220,7 +296,7 @@ class AlkMeasurer {
 
             r.alkReading.alkReadingDKH = calcAlkReading(r.alkReading, r.alkMeasureConf);
 
-            r.setTime(millis(), timeClient->getAdjustedTimeSeconds());
+            r.setTime(timeClient->getMonotonicMS(), timeClient->getAdjustedTimeSeconds());
             return r;
         } else if (prevResult.nextAction == CLEANUP) {
             MeasurementStepResult<NUM_SAMPLES> r = prevResult;
@@ -228,13 +304,23 @@ class AlkMeasurer {
             publisher->publishAlkReading(prevResult.alkReading);
 
             // Clear out all the reagent and refill with fresh tank water
-            drainMeasurementVessel(*_buffDosers, r.alkMeasureConf);
-            fillMeasurementVessel(*_buffDosers, r.alkMeasureConf, r.primeAndCleanupScratchData);
-            stirForABit(*_buffDosers, r.alkMeasureConf);
+            timeDoser(r.trace, [&]() { drainMeasurementVessel(*_buffDosers, r.alkMeasureConf); });
+            timeDoser(r.trace, [&]() { fillMeasurementVessel(*_buffDosers, r.alkMeasureConf, r.primeAndCleanupScratchData); });
+            timeDoser(r.trace, [&]() { stirForABit(*_buffDosers, r.alkMeasureConf); });
 
             r.nextAction = MEASURE_DONE;
-            r.setTime(millis(), timeClient->getAdjustedTimeSeconds());
-            _buffDosers->disableDosers();
+            r.setTime(timeClient->getMonotonicMS(), timeClient->getAdjustedTimeSeconds());
+            return r;
+        } else if (prevResult.nextAction == ABORT_CLEANUP) {
+            MeasurementStepResult<NUM_SAMPLES> r = prevResult;
+
+            // Same as CLEANUP, but the reading is discarded
+            timeDoser(r.trace, [&]() { drainMeasurementVessel(*_buffDosers, r.alkMeasureConf); });
+            timeDoser(r.trace, [&]() { fillMeasurementVessel(*_buffDosers, r.alkMeasureConf, r.primeAndCleanupScratchData); });
+            timeDoser(r.trace, [&]() { stirForABit(*_buffDosers, r.alkMeasureConf); });
+
+            r.nextAction = MEASURE_DONE;
+            r.setTime(timeClient->getMonotonicMS(), timeClient->getAdjustedTimeSeconds());
             return r;
         } else if (prevResult.nextAction == MEASURE_DONE) {
             return prevResult;
@@ -243,6 +329,7 @@ class AlkMeasurer {
         assert(false);
     }
 
+   public:
     const AlkMeasurementConfig getDefaultAlkMeasurementConfig() {
         return _defaultAlkMeasurementConf;
     }
@@ -269,7 +356,7 @@ class AlkMeasureLooper {
 
 template <size_t NUM_SAMPLES>
 static std::unique_ptr<AlkMeasureLooper<NUM_SAMPLES>> beginAlkMeasureLoop(std::shared_ptr<AlkMeasurer> alkMeasurer, std::shared_ptr<mqtt::Publisher> publisher, std::shared_ptr<buff_time::TimeWrapper> timeClient, const AlkMeasurementConfig &beginAlkMeasureConf, const std::string &title) {
-    auto beginResult = alkMeasurer->begin<NUM_SAMPLES>(beginAlkMeasureConf, millis(), timeClient->getAdjustedTimeSeconds(), title);
+    auto beginResult = alkMeasurer->begin<NUM_SAMPLES>(beginAlkMeasureConf, timeClient->getMonotonicMS(), timeClient->getAdjustedTimeSeconds(), title);
     auto looper = std::make_unique<AlkMeasureLooper<NUM_SAMPLES>>(alkMeasurer, publisher, timeClient, beginResult);
 
     return std::move(looper);
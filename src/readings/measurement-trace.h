@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stddef.h>
+
+// Buff Libraries
+#include "readings/alk-measure-common.h"
+
+namespace buff {
+namespace alk_measure {
+
+const size_t NUM_MEASUREMENT_ACTIONS = ABORT_CLEANUP + 1;
+const size_t NUM_MEASUREMENT_STEP_ACTIONS = STEP_DONE + 1;
+
+const size_t DOSER_BUSY_BUCKETS = 6;
+// upper bounds, the last bucket takes everything longer
+const unsigned long DOSER_BUSY_BUCKET_BOUNDS_MS[DOSER_BUSY_BUCKETS - 1] = {100, 1000, 5000, 15000, 60000};
+
+struct PhaseTrace {
+    // millis() when the phase's first step started
+    unsigned long startedAtMS = 0;
+    // first step started -> last step finished, including the waits between steps
+    unsigned long durationMS = 0;
+    // time spent inside the steps themselves
+    unsigned long busyMS = 0;
+    unsigned int steps = 0;
+};
+
+/*******************************
+ * MeasurementTrace
+ * Where the time goes in one measurement run: per phase and per MEASURE step
+ * timings, how long each doser call blocked for, and how many pH samples
+ * went into each dose-or-stop decision. Fixed size, no allocation, so it's
+ * cheap to update from every step.
+ *******************************/
+struct MeasurementTrace {
+    unsigned long startedAtMS = 0;
+    unsigned long endedAtMS = 0;
+
+    PhaseTrace phases[NUM_MEASUREMENT_ACTIONS];
+
+    // only for steps in the MEASURE phase
+    unsigned int measureSteps[NUM_MEASUREMENT_STEP_ACTIONS] = {};
+    unsigned long measureStepBusyMS[NUM_MEASUREMENT_STEP_ACTIONS] = {};
+
+    unsigned int doserCalls = 0;
+    unsigned long doserBusyTotalMS = 0;
+    unsigned long doserBusyMaxMS = 0;
+    unsigned int doserBusyBuckets[DOSER_BUSY_BUCKETS] = {};
+
+    unsigned int decisions = 0;
+    unsigned int phSamplesPerDecisionMin = 0;
+    unsigned int phSamplesPerDecisionMax = 0;
+    unsigned int phSamplesTotal = 0;
+    // samples since the last decision
+    unsigned int pendingPHSamples = 0;
+
+    void recordStep(const MeasurementAction action, const MeasurementStepAction stepAction, const unsigned long stepStartedAtMS, const unsigned long stepEndedAtMS) {
+        if (steps() == 0) {
+            startedAtMS = stepStartedAtMS;
+        }
+        endedAtMS = stepEndedAtMS;
+
+        auto &phase = phases[action];
+        if (phase.steps == 0) {
+            phase.startedAtMS = stepStartedAtMS;
+        }
+        phase.steps++;
+        phase.busyMS += stepEndedAtMS - stepStartedAtMS;
+        phase.durationMS = stepEndedAtMS - phase.startedAtMS;
+
+        if (action == MEASURE) {
+            measureSteps[stepAction]++;
+            measureStepBusyMS[stepAction] += stepEndedAtMS - stepStartedAtMS;
+        }
+    }
+
+    void recordPHSample() { pendingPHSamples++; }
+
+    void recordDoserBusy(const unsigned long busyMS) {
+        doserCalls++;
+        doserBusyTotalMS += busyMS;
+        if (busyMS > doserBusyMaxMS) {
+            doserBusyMaxMS = busyMS;
+        }
+
+        size_t bucket = 0;
+        while (bucket < DOSER_BUSY_BUCKETS - 1 && busyMS > DOSER_BUSY_BUCKET_BOUNDS_MS[bucket]) {
+            bucket++;
+        }
+        doserBusyBuckets[bucket]++;
+    }
+
+    // the pH samples since the last decision were enough to decide to dose or stop
+    void recordDecision() {
+        if (decisions == 0 || pendingPHSamples < phSamplesPerDecisionMin) {
+            phSamplesPerDecisionMin = pendingPHSamples;
+        }
+        if (pendingPHSamples > phSamplesPerDecisionMax) {
+            phSamplesPerDecisionMax = pendingPHSamples;
+        }
+        phSamplesTotal += pendingPHSamples;
+        decisions++;
+        pendingPHSamples = 0;
+    }
+
+    unsigned int steps() const {
+        unsigned int total = 0;
+        for (auto &phase : phases) {
+            total += phase.steps;
+        }
+        return total;
+    }
+
+    unsigned long totalDurationMS() const { return endedAtMS - startedAtMS; }
+};
+
+}  // namespace alk_measure
+}  // namespace buff
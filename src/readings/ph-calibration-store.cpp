@@ -0,0 +1,57 @@
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "metrics/metrics.h"
+#include "readings/ph-calibration-store.h"
+
+namespace buff {
+namespace ph {
+
+const char* CALIBRATION_PREFERENCE_NS = "buff-phcal";
+
+/************
+ * I/O
+ ***********/
+Preferences calibrationPreferences;
+
+#define CALIBRATION_KEY "cal"
+
+// Written as one blob so a partial write can't mix old & new points. A size
+// mismatch (firmware with a different layout) reads as not calibrated.
+struct PersistedCalibration {
+    unsigned char pointCount;
+    float calibrationTempC;
+    PHCalibrator::CalibrationPoint points[MAX_CALIBRATION_POINTS];
+};
+
+void persistPHCalibration(const PHCalibrator& calibrator) {
+    PersistedCalibration persisted = {};
+    auto& points = calibrator.points();
+    persisted.pointCount = points.size();
+    persisted.calibrationTempC = calibrator.calibrationTempC();
+    std::copy(points.begin(), points.end(), persisted.points);
+
+    calibrationPreferences.begin(CALIBRATION_PREFERENCE_NS, false);
+    calibrationPreferences.putBytes(CALIBRATION_KEY, &persisted, sizeof(persisted));
+    calibrationPreferences.end();
+    metrics::buffMetrics().nvsWrites.inc();
+}
+
+std::unique_ptr<PHCalibrator> readPHCalibration() {
+    calibrationPreferences.begin(CALIBRATION_PREFERENCE_NS, true);
+
+    PersistedCalibration persisted;
+    std::unique_ptr<PHCalibrator> calibrator = nullptr;
+    if (calibrationPreferences.getBytesLength(CALIBRATION_KEY) == sizeof(persisted) &&
+        calibrationPreferences.getBytes(CALIBRATION_KEY, &persisted, sizeof(persisted)) == sizeof(persisted) &&
+        persisted.pointCount > 0 && persisted.pointCount <= MAX_CALIBRATION_POINTS) {
+        std::vector<PHCalibrator::CalibrationPoint> points(persisted.points, persisted.points + persisted.pointCount);
+        calibrator = std::make_unique<PHCalibrator>(points, persisted.calibrationTempC);
+    }
+
+    calibrationPreferences.end();
+    return std::move(calibrator);
+}
+
+}  // namespace ph
+}  // namespace buff
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <memory>
+
+// Buff Libraries
+#include "readings/ph.h"
+
+namespace buff {
+namespace ph {
+
+void persistPHCalibration(const PHCalibrator &calibrator);
+// nullptr if nothing has been calibrated at runtime yet
+std::unique_ptr<PHCalibrator> readPHCalibration();
+
+}  // namespace ph
+}  // namespace buff
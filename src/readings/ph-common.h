@@ -1,10 +1,15 @@
 #pragma once
 
+#include <stdint.h>
+
+#include <cmath>
+
 namespace buff {
 namespace ph {
 
 struct PHReading {
-    unsigned long asOfMS;
+    // buff_time::monotonicMS
+    uint64_t asOfMS;
     unsigned long asOfAdjustedSec;
 
     float rawPH;
@@ -12,6 +17,9 @@ struct PHReading {
 
     float calibratedPH;
     float calibratedPH_mavg;
+
+    // NAN without a temperature sensor
+    float temperatureC = NAN;
 };
 
 }  // namespace ph
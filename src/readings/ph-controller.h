@@ -3,9 +3,11 @@
 #include <memory>
 
 #include <Arduino.h>
-#include "RVMovingAvg.h"
+#include "fixed-point-window.h"
+#include "streaming-filters.h"
 
 // Buff Libraries
+#include "buff_time/monotonic-clock.h"
 #include "readings/ph.h"
 
 /*******************************
@@ -15,25 +17,28 @@ namespace buff {
 namespace ph {
 namespace controller {
 
-template <size_t NUM_SAMPLES>
+// PreFilter is applied to each raw reading before it enters the window, eg a
+// stats::RollingMedianFilter to drop spikes from bubbles across the probe.
+template <size_t NUM_SAMPLES, typename PreFilter = stats::PassThroughFilter>
 class PHReadingStats {
    private:
-    RVMovingAvg<NUM_SAMPLES, unsigned int, unsigned long> _rawPHStats;
-    RVMovingAvg<NUM_SAMPLES, unsigned int, unsigned long> _calibPHStats;
-
-    const float phMetricScaleFactor = 10000;
+    PreFilter _preFilter;
+    // Only raw pH is windowed. Calibrated variance & slope are the raw ones
+    // scaled by the calibration's gain (segment slope, temperature compensated)
+    // at the window mean: exact while the window's within one segment, an
+    // approximation when it straddles a calibration point.
+    stats::FixedPointWindow<NUM_SAMPLES, 10000> _rawPHStats;
 
     PHReading _mostRecentReading;
 
    public:
-    PHReading adPHReading(PHReading reading) {
+    PHReading adPHReading(PHReading reading, const PHCalibrator &calibrator) {
         _mostRecentReading = reading;
 
-        _rawPHStats.add(round(reading.rawPH * phMetricScaleFactor));
-        _calibPHStats.add(round(reading.calibratedPH * phMetricScaleFactor));
+        _rawPHStats.add(_preFilter.add(reading.rawPH));
 
-        _mostRecentReading.rawPH_mavg = _rawPHStats.get() / phMetricScaleFactor;
-        _mostRecentReading.calibratedPH_mavg = _calibPHStats.get() / phMetricScaleFactor;
+        _mostRecentReading.rawPH_mavg = _rawPHStats.mean();
+        _mostRecentReading.calibratedPH_mavg = calibrator.convert(_mostRecentReading.rawPH_mavg, reading.temperatureC);
 
         return _mostRecentReading;
     }
@@ -42,54 +47,89 @@ class PHReadingStats {
         return _mostRecentReading;
     }
 
-    size_t readingCount() {
+    const stats::FixedPointWindow<NUM_SAMPLES, 10000> &rawPHStats() const {
+        return _rawPHStats;
+    }
+
+    // at the latest reading's temperature, like calibratedPH_mavg
+    float calibratedPHVariance(const PHCalibrator &calibrator) const {
+        const float gain = calibrator.gainAt(_rawPHStats.mean(), _mostRecentReading.temperatureC);
+        return _rawPHStats.variance() * gain * gain;
+    }
+
+    // pH change per reading, across the window
+    float calibratedPHSlope(const PHCalibrator &calibrator) const {
+        return _rawPHStats.slope() * calibrator.gainAt(_rawPHStats.mean(), _mostRecentReading.temperatureC);
+    }
+
+    size_t readingCount() const {
         return _rawPHStats.size();
     }
 
-    bool receivedMinReadings() {
+    bool receivedMinReadings() const {
         return readingCount() >= NUM_SAMPLES;
     }
 };
 
 class PHReader {
    private:
-    const PHCalibrator _phCalibrator;
+    PHCalibrator _phCalibrator;
     const PHReadConfig _phReadConfig;
 
-    unsigned long nextPHReadTime = 0;
+    uint64_t nextPHReadTime = 0;
 
    public:
     PHReader(const PHReadConfig phReadConfig, const PHCalibrator &phCalibrator) : _phReadConfig(phReadConfig), _phCalibrator(phCalibrator) {}
 
-    PHReading readNewPHSignal(unsigned long currentMillis = -1) const {
-        if (currentMillis == -1) {
-            currentMillis = millis();
-        }
+    PHReading readNewPHSignal() const {
+        return readNewPHSignal(buff_time::monotonicMS());
+    }
 
+    PHReading readNewPHSignal(const uint64_t currentMillis) const {
         const auto ph = (_phReadConfig.phReadFunc)();
-        const auto calibratedPH = _phCalibrator.convert(ph);
 
-        PHReading phReading = {.asOfMS = currentMillis, .rawPH = ph, .calibratedPH = calibratedPH};
+        PHReading phReading = {.asOfMS = currentMillis, .rawPH = ph};
+        if (_phReadConfig.temperatureReadFunc) {
+            phReading.temperatureC = (_phReadConfig.temperatureReadFunc)();
+        }
+        phReading.calibratedPH = _phCalibrator.convert(ph, phReading.temperatureC);
         return phReading;
     }
 
-    template <size_t NUM_SAMPLES>
-    PHReading readNewPHSignalWithStats(PHReadingStats<NUM_SAMPLES> &phReadingStats, unsigned long currentMillis = -1) const {
+    template <size_t NUM_SAMPLES, typename PreFilter>
+    PHReading readNewPHSignalWithStats(PHReadingStats<NUM_SAMPLES, PreFilter> &phReadingStats) const {
+        return readNewPHSignalWithStats(phReadingStats, buff_time::monotonicMS());
+    }
+
+    template <size_t NUM_SAMPLES, typename PreFilter>
+    PHReading readNewPHSignalWithStats(PHReadingStats<NUM_SAMPLES, PreFilter> &phReadingStats, const uint64_t currentMillis) const {
         auto phReading = readNewPHSignal(currentMillis);
-        return phReadingStats.adPHReading(phReading);
+        return phReadingStats.adPHReading(phReading, _phCalibrator);
+    }
+
+    const PHCalibrator &calibrator() const {
+        return _phCalibrator;
+    }
+
+    // eg after a runtime calibration, takes effect from the next reading
+    void updateCalibrator(const PHCalibrator &phCalibrator) {
+        _phCalibrator = phCalibrator;
     }
 
-    template <size_t NUM_SAMPLES>
-    std::unique_ptr<PHReading> readNewPHSignalIfTimeAndUpdate(PHReadingStats<NUM_SAMPLES> &phReadingStats) {
-        unsigned long currentMillis = millis();
+    template <size_t NUM_SAMPLES, typename PreFilter>
+    std::unique_ptr<PHReading> readNewPHSignalIfTimeAndUpdate(PHReadingStats<NUM_SAMPLES, PreFilter> &phReadingStats) {
+        return readNewPHSignalIfTimeAndUpdate(phReadingStats, buff_time::monotonicMS());
+    }
 
+    template <size_t NUM_SAMPLES, typename PreFilter>
+    std::unique_ptr<PHReading> readNewPHSignalIfTimeAndUpdate(PHReadingStats<NUM_SAMPLES, PreFilter> &phReadingStats, const uint64_t currentMillis) {
         if (nextPHReadTime > currentMillis) {
             return nullptr;
         }
 
-        auto phReading = readNewPHSignalWithStats<NUM_SAMPLES>(phReadingStats, currentMillis);
+        auto phReading = readNewPHSignalWithStats(phReadingStats, currentMillis);
 
-        nextPHReadTime = millis() + _phReadConfig.readIntervalMS;
+        nextPHReadTime = currentMillis + _phReadConfig.readIntervalMS;
 
         return std::make_unique<PHReading>(phReadingStats.mostRecentReading());
     }
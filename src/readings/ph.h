@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <functional>
+#include <vector>
 
 // Buff Libraries
 #include "readings/ph-common.h"
@@ -13,38 +16,144 @@ using PHReadingFunctionPtr = std::function<float()>;
 struct PHReadConfig {
     unsigned int readIntervalMS;
     PHReadingFunctionPtr phReadFunc;
+    // optional, in C, for temperature compensation
+    std::function<float()> temperatureReadFunc = nullptr;
 };
 
+const size_t MAX_CALIBRATION_POINTS = 5;
+const float DEFAULT_CALIBRATION_TEMP_C = 25.0;
+
+/**
+ * Piecewise linear calibration through N buffer points, eg 4/7 plus one near
+ * the ~4.5 titration endpoint so that region isn't just interpolated off 4/7.
+ * Readings outside the points extrapolate off the outermost segment.
+ *
+ * Segments (slope & intercept) are worked out when the points change, so
+ * convert is a scan over a handful of segments and a multiply-add.
+ */
 class PHCalibrator {
    public:
     struct CalibrationPoint {
-        const float actualPH;
-        const float readPH;
+        float actualPH;
+        float readPH;
     };
 
    private:
-    const CalibrationPoint _lowPoint;
-    const CalibrationPoint _highPoint;
+    struct Segment {
+        // this segment covers readings up to here, the last one has no upper bound
+        float readPHUpTo;
+        float slope;
+        float intercept;
+    };
+
+    // sorted by readPH
+    std::vector<CalibrationPoint> _points;
+    float _calibrationTempC;
+
+    std::vector<Segment> _segments;
+
+    void buildSegments() {
+        // stable, so points at the same readPH stay in the order they were added
+        std::stable_sort(_points.begin(), _points.end(), [](const CalibrationPoint &a, const CalibrationPoint &b) { return a.readPH < b.readPH; });
+        // two readings at the same spot can't define a slope, keep the later one;
+        // unique keeps the first of a run, so run it over the points reversed
+        std::reverse(_points.begin(), _points.end());
+        _points.erase(std::unique(_points.begin(), _points.end(), [](const CalibrationPoint &a, const CalibrationPoint &b) { return a.readPH == b.readPH; }), _points.end());
+        std::reverse(_points.begin(), _points.end());
+
+        _segments.clear();
+        if (_points.size() < 2) {
+            // a single point can only correct the offset
+            const float offset = _points.empty() ? 0 : _points[0].actualPH - _points[0].readPH;
+            _segments.push_back({.readPHUpTo = INFINITY, .slope = 1, .intercept = offset});
+            return;
+        }
+
+        for (size_t i = 0; i + 1 < _points.size(); i++) {
+            const auto &low = _points[i];
+            const auto &high = _points[i + 1];
+            const float slope = (high.actualPH - low.actualPH) / (high.readPH - low.readPH);
+            const bool last = i + 2 == _points.size();
+            _segments.push_back({.readPHUpTo = last ? INFINITY : high.readPH, .slope = slope, .intercept = low.actualPH - slope * low.readPH});
+        }
+    }
+
+    const Segment &segmentFor(float reading) const {
+        for (const auto &segment : _segments) {
+            if (reading <= segment.readPHUpTo) {
+                return segment;
+            }
+        }
+        return _segments.back();
+    }
 
    public:
-    PHCalibrator(CalibrationPoint lowPoint, CalibrationPoint highPoint) : _lowPoint(lowPoint), _highPoint(highPoint){};
+    PHCalibrator(CalibrationPoint lowPoint, CalibrationPoint highPoint, float calibrationTempC = DEFAULT_CALIBRATION_TEMP_C) : PHCalibrator(std::vector<CalibrationPoint>({lowPoint, highPoint}), calibrationTempC) {}
+
+    PHCalibrator(const std::vector<CalibrationPoint> &points, float calibrationTempC = DEFAULT_CALIBRATION_TEMP_C) : _points(points), _calibrationTempC(calibrationTempC) {
+        if (_points.size() > MAX_CALIBRATION_POINTS) {
+            _points.resize(MAX_CALIBRATION_POINTS);
+        }
+        buildSegments();
+    }
 
     float convert(float reading) const {
-        // pHx - the pH of the sample
-        // pHref1 - the pH of the calibration buffer 1 (generally 4)
-        // pHref2 - the pH of the calibration buffer 2 (generally 7)
-        //
-        // Mref1 - the measured value for buffer 1
-        // Mref2 - the measured value for buffer 2
-        //
-        // Mx - the measured value for the sample
+        // Within a segment this is the usual two buffer formula:
         // pHx = pHref1 + (pHref2 – pHref1) * (Mx – Mref1) / (Mref2 - Mref1)
-        // pHx = 4 + 3 * (Mx – M4) / (M7 - M4)
-        return _lowPoint.actualPH +
-               (_highPoint.actualPH - _lowPoint.actualPH) *
-                   (reading - _lowPoint.readPH) /
-                   (_highPoint.readPH - _lowPoint.readPH);
+        // with the slope & intercept precomputed
+        const auto &segment = segmentFor(reading);
+        return segment.slope * reading + segment.intercept;
     }
+
+    float convert(float reading, float temperatureC) const {
+        return convert(compensate(reading, temperatureC));
+    }
+
+    // Electrode output scales with absolute temperature (Nernst), pivoting on
+    // pH 7, so scale a reading taken at temperatureC back to what it would
+    // have been at the calibration temperature. NAN temperature -> no change.
+    float compensate(float reading, float temperatureC) const {
+        if (std::isnan(temperatureC)) {
+            return reading;
+        }
+        return 7.0 + (reading - 7.0) * (_calibrationTempC + 273.15) / (temperatureC + 273.15);
+    }
+
+    // d(calibrated pH) / d(read pH) around reading, used to carry spreads &
+    // slopes of raw readings over to calibrated ones without converting each sample
+    float gainAt(float reading) const {
+        return segmentFor(reading).slope;
+    }
+
+    // as above for a reading taken at temperatureC, ie the slope of convert(reading, temperatureC)
+    float gainAt(float reading, float temperatureC) const {
+        const float compensation = std::isnan(temperatureC) ? 1.0 : (_calibrationTempC + 273.15) / (temperatureC + 273.15);
+        return gainAt(compensate(reading, temperatureC)) * compensation;
+    }
+
+    // A copy with point added, replacing any existing point for the same
+    // buffer. When full, the point with the closest buffer pH is replaced.
+    PHCalibrator withPoint(const CalibrationPoint &point) const {
+        auto points = _points;
+
+        auto closest = points.end();
+        for (auto it = points.begin(); it != points.end(); it++) {
+            if (closest == points.end() || fabs(it->actualPH - point.actualPH) < fabs(closest->actualPH - point.actualPH)) {
+                closest = it;
+            }
+        }
+
+        const float SAME_BUFFER_TOLERANCE_PH = 0.05;
+        if (closest != points.end() && (fabs(closest->actualPH - point.actualPH) < SAME_BUFFER_TOLERANCE_PH || points.size() >= MAX_CALIBRATION_POINTS)) {
+            *closest = point;
+        } else {
+            points.push_back(point);
+        }
+        return PHCalibrator(points, _calibrationTempC);
+    }
+
+    const std::vector<CalibrationPoint> &points() const { return _points; }
+    float calibrationTempC() const { return _calibrationTempC; }
 };
 }  // namespace ph
 }  // namespace buff
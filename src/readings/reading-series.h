@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "readings/alk-measure-common.h"
+#include "misc/string-manip.h"
+
+namespace buff {
+namespace reading_store {
+
+// series hold hundredths (of a dKH, ml or pH), small enough for LVGL's 16 bit coords
+const int16_t SERIES_SCALE = 100;
+
+inline int16_t toSeriesValue(const float value) {
+    return (int16_t)std::lround(value * SERIES_SCALE);
+}
+
+/*******************************
+ * decimatedTitleSeries
+ * One title's dKH readings, oldest first, averaged down into at most
+ * maxPoints buckets. Takes getReadingsSortedByAsOf's newest first order,
+ * empty (never written) slots are skipped.
+ *******************************/
+inline std::vector<int16_t> decimatedTitleSeries(const std::vector<std::reference_wrapper<alk_measure::PersistedAlkReading>>& newestFirst, const std::string& title, const size_t maxPoints) {
+    std::vector<float> values;
+    for (auto it = newestFirst.rbegin(); it != newestFirst.rend(); it++) {
+        const auto& reading = it->get();
+        if (reading.asOfAdjustedSec == 0) continue;
+
+        auto readingTitle = reading.title;
+        richiev::strings::trim(readingTitle);
+        if (readingTitle == title) {
+            values.push_back(reading.alkReadingDKH);
+        }
+    }
+
+    std::vector<int16_t> series;
+    if (values.size() <= maxPoints) {
+        for (const auto value : values) {
+            series.push_back(toSeriesValue(value));
+        }
+        return series;
+    }
+
+    for (size_t bucket = 0; bucket < maxPoints; bucket++) {
+        const size_t start = bucket * values.size() / maxPoints;
+        const size_t end = (bucket + 1) * values.size() / maxPoints;
+        float sum = 0;
+        for (size_t i = start; i < end; i++) {
+            sum += values[i];
+        }
+        series.push_back(toSeriesValue(sum / (end - start)));
+    }
+    return series;
+}
+
+/*******************************
+ * appendedPoints
+ * How many points to push onto the end of a chart (in shift mode) showing
+ * previous, so it shows next. -1 when next isn't previous with points added
+ * on the end (eg the decimation buckets moved), so it needs redrawing.
+ *******************************/
+inline int appendedPoints(const std::vector<int16_t>& previous, const std::vector<int16_t>& next) {
+    if (next.size() >= previous.size() && std::equal(previous.begin(), previous.end(), next.begin())) {
+        return next.size() - previous.size();
+    }
+
+    // a full chart, the oldest points scrolled off
+    if (next.size() == previous.size()) {
+        for (size_t shift = 1; shift < previous.size(); shift++) {
+            if (std::equal(previous.begin() + shift, previous.end(), next.begin())) {
+                return shift;
+            }
+        }
+    }
+    return -1;
+}
+
+/*******************************
+ * TitrationCurve
+ * The running measurement's pH vs reagent volume, one point per pH decision.
+ * Keeps the last `capacity` points, in series units.
+ *******************************/
+struct TitrationPoint {
+    // buff_time::monotonicMS, tells one run from the next
+    uint64_t runStartedAtMS;
+    float reagentML;
+    float pH;
+};
+
+class TitrationCurve {
+   public:
+    struct SeriesPoint {
+        int16_t reagentML;
+        int16_t pH;
+    };
+
+   private:
+    const size_t _capacity;
+    std::vector<SeriesPoint> _points;
+    uint64_t _runStartedAtMS = 0;
+    bool _started = false;
+    int16_t _maxReagentML = 0;
+
+   public:
+    TitrationCurve(const size_t capacity) : _capacity(capacity) {}
+
+    // true when the point starts a new run, so the old curve's gone
+    bool add(const TitrationPoint& point) {
+        const bool newRun = !_started || point.runStartedAtMS != _runStartedAtMS;
+        if (newRun) {
+            _points.clear();
+            _runStartedAtMS = point.runStartedAtMS;
+            _started = true;
+            _maxReagentML = 0;
+        }
+
+        if (_points.size() == _capacity) {
+            _points.erase(_points.begin());
+        }
+        const SeriesPoint seriesPoint = {toSeriesValue(point.reagentML), toSeriesValue(point.pH)};
+        _points.push_back(seriesPoint);
+        _maxReagentML = std::max(_maxReagentML, seriesPoint.reagentML);
+        return newRun;
+    }
+
+    const std::vector<SeriesPoint>& points() const { return _points; }
+    int16_t maxReagentML() const { return _maxReagentML; }
+};
+
+}  // namespace reading_store
+}  // namespace buff
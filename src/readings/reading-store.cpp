@@ -1,6 +1,7 @@
 #include <Arduino.h>
 #include <Preferences.h>
 
+#include "metrics/metrics.h"
 #include "readings/reading-store.h"
 
 namespace buff {
@@ -31,8 +32,10 @@ void persistAlkReading(const unsigned char i, const alk_measure::PersistedAlkRea
 
     preferences.putUChar(dkhKey, numeric::smallFloatToByte(reading.alkReadingDKH));
     preferences.putULong(asOfKey, reading.asOfAdjustedSec);
+    metrics::buffMetrics().nvsWrites.inc(2);
     if (reading.title.size() >= 0) {
         preferences.putString(titleKey, reading.title.substr(0, MAX_TITLE_LEN).c_str());
+        metrics::buffMetrics().nvsWrites.inc();
     }
 }
 
@@ -53,6 +56,7 @@ alk_measure::PersistedAlkReading readAlkReading(const unsigned char i) {
 void persistIndex(const unsigned char i) {
     char indexKey[] = INDEX_KEY;
     preferences.putUChar(indexKey, i);
+    metrics::buffMetrics().nvsWrites.inc();
 }
 
 unsigned char readIndex() {
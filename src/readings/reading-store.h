@@ -74,6 +74,8 @@ class ReadingStore {
     }
 
     const unsigned char getTipIndex() { return _tipIndex; }
+
+    size_t getReadingsToKeep() const { return _readingsToKeep; }
 };
 
 void persistReadingStore(std::shared_ptr<ReadingStore> readingStore);
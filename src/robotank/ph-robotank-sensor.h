@@ -3,27 +3,38 @@
 #include <Arduino.h>
 #include <Wire.h>
 
+#include <cmath>
+#include <cstdlib>
+
+// Buff Libraries
+#include "metrics/metrics.h"
+#include "sensors/i2c-buses.h"
+#include "sensors/sensor.h"
+
 /*******************************
  * RoboTank PH Sensor Integration
+ * The board needs the bus at 10 KHz - this is important! It's set per
+ * transaction by sensors::sensorBus(), so a display sharing the bus can run
+ * faster in between.
  *******************************/
-void setupPH_RoboTankPHBoard() {
-    ::Wire.setClock(10000);  // set I2C bus to 10 KHz - this is important!
-}
 
 // read the current ph directly from the board
 float readPHSignal_RoboTankPHBoard(const uint8_t i2cAddress) {
-    ::Wire.beginTransmission(i2cAddress);  // start transmission
-    ::Wire.write("R");                     // ask for pH
-    ::Wire.write(0);                       // send closing byte
-    ::Wire.endTransmission();              // end transmission
+    buff::sensors::WireBus::Transaction transaction(buff::sensors::sensorBus(), buff::concurrency::I2C_HIGH_PRIORITY, buff::sensors::SENSOR_I2C_CLOCK_HZ);
+    auto &wire = transaction.wire();
+
+    wire.beginTransmission(i2cAddress);  // start transmission
+    wire.write("R");                     // ask for pH
+    wire.write(0);                       // send closing byte
+    wire.endTransmission();              // end transmission
 
     uint8_t count = 0;  // count imcoming bytes
     uint8_t byteCountToRead = 8;
-    String i = "";                                  // create string of incoming data
-    ::Wire.requestFrom(i2cAddress, byteCountToRead);  // request 8 bytes from pH circuit
-    while (::Wire.available())                        // read the 8 incoming bytes
+    String i = "";                                // create string of incoming data
+    wire.requestFrom(i2cAddress, byteCountToRead);  // request 8 bytes from pH circuit
+    while (wire.available())                        // read the 8 incoming bytes
     {
-        char c = Wire.read();  // receive a byte as character
+        char c = wire.read();  // receive a byte as character
         if (count > 0) {
             i = i + c;
         }         // ignore first btye and combine remaining into a string
@@ -39,3 +50,94 @@ float readPHSignal_RoboTankPHBoard(const uint8_t i2cAddress) {
     float nameForRoboTankSignalReaderFunc(i2cAddress)() { \
         return readPHSignal_RoboTankPHBoard(i2cAddress);  \
     }
+
+namespace buff {
+namespace robotank {
+
+/*******************************
+ * Split-phase RoboTank reads
+ * Instead of command + read back to back inside loop(), the command is sent,
+ * then the board is left alone for conversionDelayMS while loop() gets on with
+ * doser ticks & MQTT, then the result is read on a later pass. Scheduled by
+ * sensors::SensorRegistry, PHReader only ever sees the cached value.
+ *
+ * requestFrom is still a blocking transfer, but that's ~8 bytes, not the
+ * whole command/convert/read round trip. Both go through the shared bus at
+ * high priority, so they're let in ahead of any queued display page.
+ *******************************/
+class RoboTankPHSensor : public sensors::Sensor {
+   private:
+    static const uint8_t RESPONSE_BYTES = 8;
+
+    const uint8_t _i2cAddress;
+    const unsigned long _conversionDelayMS;
+
+    unsigned long _commandSentAtMS = 0;
+
+    void logError(const char *reason) {
+        metrics::buffMetrics().i2cReadFailures.inc();
+        Serial.print("[WARNING] RoboTank pH read failed: ");
+        Serial.print(reason);
+        Serial.print(", errors=");
+        Serial.println(stats().errorCount + 1);
+    }
+
+    // response is a status byte followed by the pH as ascii, eg "\x017.123\0\0"
+    bool readResponse(float &ph) {
+        char buffer[RESPONSE_BYTES + 1];
+        uint8_t len = 0;
+
+        sensors::WireBus::Transaction transaction(sensors::sensorBus(), concurrency::I2C_HIGH_PRIORITY, sensors::SENSOR_I2C_CLOCK_HZ);
+        auto &wire = transaction.wire();
+
+        wire.requestFrom(_i2cAddress, RESPONSE_BYTES);
+        bool first = true;
+        while (wire.available()) {
+            const char c = wire.read();
+            if (first) {
+                first = false;
+            } else if (len < RESPONSE_BYTES) {
+                buffer[len++] = c;
+            }
+        }
+        buffer[len] = '\0';
+
+        char *end = nullptr;
+        ph = strtof(buffer, &end);
+        return end != buffer && !std::isnan(ph) && ph >= 0 && ph <= 14;
+    }
+
+   protected:
+    bool startRead(const unsigned long nowMS) override {
+        _commandSentAtMS = nowMS;
+        sensors::WireBus::Transaction transaction(sensors::sensorBus(), concurrency::I2C_HIGH_PRIORITY, sensors::SENSOR_I2C_CLOCK_HZ);
+        auto &wire = transaction.wire();
+
+        wire.beginTransmission(_i2cAddress);
+        wire.write("R");
+        wire.write(0);
+        if (wire.endTransmission() != 0) {
+            logError("command not acked");
+            return false;
+        }
+        return true;
+    }
+
+    sensors::ReadStatus continueRead(const unsigned long nowMS, float &value) override {
+        if (nowMS - _commandSentAtMS < _conversionDelayMS) {
+            return sensors::READ_IN_PROGRESS;
+        }
+        if (!readResponse(value)) {
+            logError("unparseable response");
+            return sensors::READ_FAILED;
+        }
+        return sensors::READ_DONE;
+    }
+
+   public:
+    RoboTankPHSensor(const uint8_t i2cAddress, const unsigned long conversionDelayMS = 20)
+        : sensors::Sensor(sensors::PH, "robotank_ph"), _i2cAddress(i2cAddress), _conversionDelayMS(conversionDelayMS) {}
+};
+
+}  // namespace robotank
+}  // namespace buff
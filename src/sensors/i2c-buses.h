@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Wire.h>
+
+// Buff Libraries
+#include "concurrency/i2c-bus.h"
+#include "inputs-board-config.h"
+
+namespace buff {
+namespace sensors {
+
+typedef concurrency::I2CBus<TwoWire> WireBus;
+
+// the RoboTank board needs it this slow
+const uint32_t SENSOR_I2C_CLOCK_HZ = 10000;
+const uint32_t DISPLAY_I2C_CLOCK_HZ = 400000;
+
+/*******************************
+ * I2C buses
+ * Sensors are on Wire. The display either has Wire1 to itself or shares
+ * Wire, in which case the bus is switched to its clock per transaction and
+ * sensor reads go first.
+ *******************************/
+inline WireBus &sensorBus() {
+    static WireBus bus(::Wire);
+    return bus;
+}
+
+inline bool &displayHasOwnBus() {
+    static bool ownBus = false;
+    return ownBus;
+}
+
+inline WireBus &displayBus() {
+    static WireBus ownBus(::Wire1);
+    return displayHasOwnBus() ? ownBus : sensorBus();
+}
+
+// before setting up the display & sensors
+inline void setupI2CBuses(const short sda, const short scl, const short displaySDA = UNSET_VALUE, const short displaySCL = UNSET_VALUE) {
+    ::Wire.begin(sda, scl);
+    if (displaySDA != UNSET_VALUE && displaySCL != UNSET_VALUE) {
+        ::Wire1.begin(displaySDA, displaySCL);
+        displayHasOwnBus() = true;
+    }
+}
+
+}  // namespace sensors
+}  // namespace buff
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Buff Libraries
+#include "sensors/sensor.h"
+
+namespace buff {
+namespace sensors {
+
+/*******************************
+ * Registry & scheduler
+ * Each sensor gets its own read interval. Reads on the shared I2C bus are
+ * serialized: at most one is in flight, and at most one is started per loop,
+ * most overdue first. So loop() does about the same amount of bus work no
+ * matter how many probes are hooked up.
+ *******************************/
+class SensorRegistry {
+   private:
+    struct Entry {
+        std::shared_ptr<Sensor> sensor;
+        unsigned long readIntervalMS;
+        // buff_time::monotonicMS, so it doesn't go backwards at millis()'s wrap
+        uint64_t nextReadAtMS;
+        bool inFlight;
+    };
+
+    std::vector<Entry> _entries;
+    bool _busInFlight = false;
+
+    void poll(Entry &entry, const uint64_t nowMS) {
+        if (entry.sensor->pollRead(nowMS) != READ_IN_PROGRESS) {
+            entry.inFlight = false;
+            if (entry.sensor->usesSharedBus()) {
+                _busInFlight = false;
+            }
+        }
+    }
+
+    void start(Entry &entry, const uint64_t nowMS) {
+        entry.nextReadAtMS = nowMS + entry.readIntervalMS;
+        if (!entry.sensor->beginRead(nowMS)) {
+            return;
+        }
+        entry.inFlight = true;
+        if (entry.sensor->usesSharedBus()) {
+            _busInFlight = true;
+        }
+    }
+
+   public:
+    void add(std::shared_ptr<Sensor> sensor, const unsigned long readIntervalMS) {
+        _entries.push_back({.sensor = sensor, .readIntervalMS = readIntervalMS, .nextReadAtMS = 0, .inFlight = false});
+    }
+
+    // every sensor of that kind, takes effect from its last read
+    void setReadIntervalMS(const SensorKind kind, const unsigned long readIntervalMS) {
+        for (auto &entry : _entries) {
+            if (entry.sensor->kind() != kind) continue;
+            if (entry.nextReadAtMS != 0) {
+                entry.nextReadAtMS = entry.nextReadAtMS - entry.readIntervalMS + readIntervalMS;
+            }
+            entry.readIntervalMS = readIntervalMS;
+        }
+    }
+
+    // of the first sensor of that kind, 0 if there isn't one
+    unsigned long readIntervalMS(const SensorKind kind) const {
+        for (auto &entry : _entries) {
+            if (entry.sensor->kind() == kind) {
+                return entry.readIntervalMS;
+            }
+        }
+        return 0;
+    }
+
+    void loop(const uint64_t nowMS) {
+        for (auto &entry : _entries) {
+            if (entry.inFlight) {
+                poll(entry, nowMS);
+            }
+        }
+
+        Entry *mostOverdueBusEntry = nullptr;
+        for (auto &entry : _entries) {
+            if (entry.inFlight || entry.nextReadAtMS > nowMS) {
+                continue;
+            }
+            if (!entry.sensor->usesSharedBus()) {
+                start(entry, nowMS);
+                // quick reads finish in the same loop
+                poll(entry, nowMS);
+            } else if (mostOverdueBusEntry == nullptr || entry.nextReadAtMS < mostOverdueBusEntry->nextReadAtMS) {
+                mostOverdueBusEntry = &entry;
+            }
+        }
+
+        if (!_busInFlight && mostOverdueBusEntry != nullptr) {
+            start(*mostOverdueBusEntry, nowMS);
+        }
+    }
+
+    bool busInFlight() const { return _busInFlight; }
+
+    // first registered sensor of that kind, nullptr if there isn't one
+    std::shared_ptr<Sensor> find(const SensorKind kind) const {
+        for (auto &entry : _entries) {
+            if (entry.sensor->kind() == kind) {
+                return entry.sensor;
+            }
+        }
+        return nullptr;
+    }
+
+    std::shared_ptr<Sensor> find(const std::string &name) const {
+        for (auto &entry : _entries) {
+            if (entry.sensor->name() == name) {
+                return entry.sensor;
+            }
+        }
+        return nullptr;
+    }
+
+    bool hasReading(const SensorKind kind) const {
+        auto sensor = find(kind);
+        return sensor != nullptr && sensor->hasReading();
+    }
+
+    // For handing a cached value to eg PHReadConfig::phReadFunc, never touches the bus
+    std::function<float()> latestValueFunc(const SensorKind kind) const {
+        auto sensor = find(kind);
+        if (sensor == nullptr) {
+            return nullptr;
+        }
+        return [sensor]() { return sensor->lastValue(); };
+    }
+
+    const std::vector<Entry> &entries() const { return _entries; }
+};
+
+}  // namespace sensors
+}  // namespace buff
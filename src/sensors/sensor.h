@@ -0,0 +1,124 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+
+namespace buff {
+namespace sensors {
+
+enum SensorKind {
+    PH = 0,
+    TEMPERATURE_C = 1,
+    CONDUCTIVITY_US = 2,
+};
+
+static std::map<SensorKind, std::string> const SENSOR_KIND_TO_NAME =
+    {{SensorKind::PH, "ph"},
+     {SensorKind::TEMPERATURE_C, "temperature_c"},
+     {SensorKind::CONDUCTIVITY_US, "conductivity_us"}};
+
+enum ReadStatus {
+    READ_IN_PROGRESS,
+    READ_DONE,
+    READ_FAILED,
+};
+
+struct SensorReadStats {
+    unsigned long readCount = 0;
+    unsigned long errorCount = 0;
+    // read started -> value available
+    unsigned long lastLatencyMS = 0;
+    unsigned long maxLatencyMS = 0;
+};
+
+/*******************************
+ * Sensors
+ * A read is split in two so slow conversions don't block the loop:
+ * beginRead kicks it off (eg sends an I2C command), pollRead is called on
+ * later loops until the value is in. When to read is up to the SensorRegistry.
+ *******************************/
+class Sensor {
+   private:
+    const SensorKind _kind;
+    const std::string _name;
+
+    bool _hasReading = false;
+    float _lastValue = 0;
+    unsigned long _lastReadAtMS = 0;
+    unsigned long _readStartedAtMS = 0;
+
+    SensorReadStats _stats;
+
+   protected:
+    virtual bool startRead(const unsigned long nowMS) = 0;
+    // on READ_DONE, value holds the new reading
+    virtual ReadStatus continueRead(const unsigned long nowMS, float &value) = 0;
+
+   public:
+    Sensor(const SensorKind kind, const std::string &name) : _kind(kind), _name(name) {}
+    virtual ~Sensor() = default;
+
+    // whether reads go over the shared I2C bus, those are never overlapped
+    virtual bool usesSharedBus() const { return true; }
+
+    bool beginRead(const unsigned long nowMS) {
+        _readStartedAtMS = nowMS;
+        if (!startRead(nowMS)) {
+            _stats.errorCount++;
+            return false;
+        }
+        return true;
+    }
+
+    ReadStatus pollRead(const unsigned long nowMS) {
+        float value;
+        const auto status = continueRead(nowMS, value);
+        if (status == READ_DONE) {
+            _hasReading = true;
+            _lastValue = value;
+            _lastReadAtMS = nowMS;
+
+            _stats.readCount++;
+            _stats.lastLatencyMS = nowMS - _readStartedAtMS;
+            if (_stats.lastLatencyMS > _stats.maxLatencyMS) {
+                _stats.maxLatencyMS = _stats.lastLatencyMS;
+            }
+        } else if (status == READ_FAILED) {
+            _stats.errorCount++;
+        }
+        return status;
+    }
+
+    SensorKind kind() const { return _kind; }
+    const std::string &name() const { return _name; }
+
+    bool hasReading() const { return _hasReading; }
+    // most recent good value, held over failed reads
+    float lastValue() const { return _lastValue; }
+    unsigned long lastReadAtMS() const { return _lastReadAtMS; }
+    const SensorReadStats &stats() const { return _stats; }
+};
+
+// Wraps a synchronous read function, for sensors that are quick to read and
+// don't sit on the I2C bus (eg an analog thermistor or a OneWire probe)
+class FunctionSensor : public Sensor {
+   private:
+    const std::function<float()> _readFunc;
+
+   protected:
+    bool startRead(const unsigned long nowMS) override { return true; }
+
+    ReadStatus continueRead(const unsigned long nowMS, float &value) override {
+        value = _readFunc();
+        return value == value ? READ_DONE : READ_FAILED;  // NaN -> failed
+    }
+
+   public:
+    FunctionSensor(const SensorKind kind, const std::string &name, std::function<float()> readFunc) : Sensor(kind, name), _readFunc(readFunc) {}
+
+    bool usesSharedBus() const override { return false; }
+};
+
+}  // namespace sensors
+}  // namespace buff
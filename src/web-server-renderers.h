@@ -1,11 +1,13 @@
 #pragma once
 
 #include <ctime>
+#include <functional>
 #include <list>
 #include <string>
 
 #include "Arduino.h"
 #include "readings/alk-measure-common.h"
+#include "readings/measurement-trace.h"
 
 namespace buff {
 namespace web_server {
@@ -108,7 +110,7 @@ static std::string renderHeader(char *temp, size_t bufferSize, const ph::PHReadi
     return temp;
 }
 
-static std::string renderFooter(char *temp, size_t bufferSize, const unsigned long renderTimeSec, const unsigned long uptimeMS) {
+static std::string renderFooter(char *temp, size_t bufferSize, const unsigned long renderTimeSec, const uint64_t uptimeMS) {
     const auto footerTemplate = R"(
         <footer class="row">
           <div class="col">
@@ -147,7 +149,72 @@ static std::string renderAlerts(char *temp, size_t bufferSize, const unsigned lo
     return alertContent;
 }
 
-static void renderRoot(std::string &out, const unsigned long currentElapsedMeasurementTimeMS, const TriggerVal &triggered, const unsigned long renderTimeSec, const unsigned long uptimeMS, const std::vector<std::reference_wrapper<alk_measure::PersistedAlkReading>> &mostRecentReadings, const std::set<std::string> &recentTitles, const ph::PHReading &phReading) {
+// Prometheus text format, for the most recent measurement run
+static void renderMeasurementTraceMetrics(std::string &out, const alk_measure::MeasurementTrace &trace) {
+    const size_t bufferSize = 256;
+    char temp[bufferSize];
+
+    out += "# TYPE buff_alk_measurement_duration_ms gauge\n";
+    snprintf(temp, bufferSize, "buff_alk_measurement_duration_ms %lu\n", trace.totalDurationMS());
+    out += temp;
+
+    // each metric's samples have to be grouped under its TYPE line
+    const std::pair<const char *, std::function<unsigned long(const alk_measure::PhaseTrace &)>> phaseMetrics[] = {
+        {"buff_alk_measurement_phase_duration_ms", [](const alk_measure::PhaseTrace &phase) { return phase.durationMS; }},
+        {"buff_alk_measurement_phase_busy_ms", [](const alk_measure::PhaseTrace &phase) { return phase.busyMS; }},
+        {"buff_alk_measurement_phase_steps", [](const alk_measure::PhaseTrace &phase) { return (unsigned long)phase.steps; }}};
+    for (auto &metric : phaseMetrics) {
+        snprintf(temp, bufferSize, "# TYPE %s gauge\n", metric.first);
+        out += temp;
+        for (size_t action = 0; action < alk_measure::NUM_MEASUREMENT_ACTIONS; action++) {
+            if (action == alk_measure::MEASURE_DONE) continue;
+            snprintf(temp, bufferSize, "%s{phase=\"%s\"} %lu\n", metric.first,
+                     alk_measure::MEASUREMENT_ACTION_TO_NAME.at((alk_measure::MeasurementAction)action).c_str(),
+                     metric.second(trace.phases[action]));
+            out += temp;
+        }
+    }
+
+    out += "# TYPE buff_alk_measurement_measure_steps gauge\n";
+    for (auto step : {alk_measure::MEASURE_PH, alk_measure::DOSE}) {
+        snprintf(temp, bufferSize, "buff_alk_measurement_measure_steps{step=\"%s\"} %u\n",
+                 alk_measure::MEASUREMENT_STEP_ACTION_TO_NAME.at(step).c_str(), trace.measureSteps[step]);
+        out += temp;
+    }
+
+    out += "# TYPE buff_alk_measurement_doser_busy_ms histogram\n";
+    unsigned int cumulative = 0;
+    for (size_t bucket = 0; bucket < alk_measure::DOSER_BUSY_BUCKETS; bucket++) {
+        cumulative += trace.doserBusyBuckets[bucket];
+        if (bucket < alk_measure::DOSER_BUSY_BUCKETS - 1) {
+            snprintf(temp, bufferSize, "buff_alk_measurement_doser_busy_ms_bucket{le=\"%lu\"} %u\n", alk_measure::DOSER_BUSY_BUCKET_BOUNDS_MS[bucket], cumulative);
+        } else {
+            snprintf(temp, bufferSize, "buff_alk_measurement_doser_busy_ms_bucket{le=\"+Inf\"} %u\n", cumulative);
+        }
+        out += temp;
+    }
+    snprintf(temp, bufferSize,
+             "buff_alk_measurement_doser_busy_ms_sum %lu\n"
+             "buff_alk_measurement_doser_busy_ms_count %u\n",
+             trace.doserBusyTotalMS, trace.doserCalls);
+    out += temp;
+    out += "# TYPE buff_alk_measurement_doser_busy_max_ms gauge\n";
+    snprintf(temp, bufferSize, "buff_alk_measurement_doser_busy_max_ms %lu\n", trace.doserBusyMaxMS);
+    out += temp;
+
+    out += "# TYPE buff_alk_measurement_decisions gauge\n";
+    snprintf(temp, bufferSize, "buff_alk_measurement_decisions %u\n", trace.decisions);
+    out += temp;
+    out += "# TYPE buff_alk_measurement_ph_samples_per_decision gauge\n";
+    snprintf(temp, bufferSize,
+             "buff_alk_measurement_ph_samples_per_decision{stat=\"min\"} %u\n"
+             "buff_alk_measurement_ph_samples_per_decision{stat=\"max\"} %u\n"
+             "buff_alk_measurement_ph_samples_per_decision{stat=\"total\"} %u\n",
+             trace.phSamplesPerDecisionMin, trace.phSamplesPerDecisionMax, trace.phSamplesTotal);
+    out += temp;
+}
+
+static void renderRoot(std::string &out, const unsigned long currentElapsedMeasurementTimeMS, const TriggerVal &triggered, const unsigned long renderTimeSec, const uint64_t uptimeMS, const std::vector<std::reference_wrapper<alk_measure::PersistedAlkReading>> &mostRecentReadings, const std::set<std::string> &recentTitles, const ph::PHReading &phReading) {
     const size_t bufferSize = 2048;
     char temp[bufferSize];
     memset(temp, 0, bufferSize);
@@ -6,7 +6,9 @@
 
 #include <string>
 
+#include "metrics/metrics.h"
 #include "readings/alk-measure-common.h"
+#include "readings/measurement-trace.h"
 #include "readings/reading-store.h"
 #include "string-manip.h"
 #include "time-common.h"
@@ -24,15 +26,17 @@ class BuffWebServer {
     unsigned long _currentElapsedMeasurementTimeMS = 0;
 
     std::unique_ptr<alk_measure::TriggerRequest> _pendingTrigger;
+    std::unique_ptr<alk_measure::MeasurementTrace> _lastMeasurementTrace;
 
    public:
     BuffWebServer(std::shared_ptr<buff_time::TimeWrapper> timeClient, int port = 80) : _server(port), _timeClient(timeClient) {}
 
     void handleRoot() {
+        metrics::buffMetrics().httpRequests.inc();
         std::string bodyText;
         auto readings = _readingStore->getReadingsSortedByAsOf();
         renderRoot(bodyText, _currentElapsedMeasurementTimeMS, TriggerVal::NA,
-                   _timeClient->getAdjustedTimeSeconds(), millis(),
+                   _timeClient->getAdjustedTimeSeconds(), _timeClient->getMonotonicMS(),
                    readings, _readingStore->getRecentTitles(readings),
                    _readingStore->getMostRecentPHReading());
 
@@ -40,6 +44,7 @@ class BuffWebServer {
     }
 
     void handleTrigger() {
+        metrics::buffMetrics().httpRequests.inc();
         String asOfString = _server.arg("asOf");
         unsigned long asOf = 0;
 
@@ -64,13 +69,14 @@ class BuffWebServer {
         std::string bodyText;
         auto readings = _readingStore->getReadingsSortedByAsOf();
         renderRoot(bodyText, _currentElapsedMeasurementTimeMS, triggered,
-                   _timeClient->getAdjustedTimeSeconds(), millis(),
+                   _timeClient->getAdjustedTimeSeconds(), _timeClient->getMonotonicMS(),
                    readings, _readingStore->getRecentTitles(readings),
                    _readingStore->getMostRecentPHReading());
         _server.send(200, "text/html", bodyText.c_str());
     }
 
     void handleNotFound() {
+        metrics::buffMetrics().httpRequests.inc();
         String message = "File Not Found\n\n";
         message += "URI: ";
         message += _server.uri();
@@ -88,9 +94,10 @@ class BuffWebServer {
     }
 
     void handleGetReadings() {
+        metrics::buffMetrics().httpRequests.inc();
         DynamicJsonDocument responseDoc(1024);
 
-        responseDoc["asOfMS"] = millis();
+        responseDoc["asOfMS"] = _timeClient->getMonotonicMS();
         responseDoc["asOfAdjustedSec"] = _timeClient->getAdjustedTimeSeconds();
 
         auto readings = _readingStore->getReadingsSortedByAsOf();
@@ -118,12 +125,23 @@ class BuffWebServer {
         _server.send(200, "application/json", serializedDoc);
     }
 
+    void handleMetrics() {
+        metrics::buffMetrics().httpRequests.inc();
+        std::string bodyText;
+        metrics::registry().render(bodyText);
+        if (_lastMeasurementTrace) {
+            renderMeasurementTraceMetrics(bodyText, *_lastMeasurementTrace);
+        }
+        _server.send(200, "text/plain; version=0.0.4", bodyText.c_str());
+    }
+
     void setupWebServer(std::shared_ptr<reading_store::ReadingStore> rs) {
         _readingStore = rs;
 
         _server.on("/", [&]() { handleRoot(); });
         _server.on("/execute/measure_alk", [&]() { handleTrigger(); });
         _server.on("/readings.json", [&]() { handleGetReadings(); });
+        _server.on("/metrics", [&]() { handleMetrics(); });
         _server.onNotFound([&]() { handleNotFound(); });
         _server.begin();
         Serial.println("HTTP server started");
@@ -134,6 +152,10 @@ class BuffWebServer {
         _server.handleClient();
     }
 
+    void setLastMeasurementTrace(const alk_measure::MeasurementTrace &trace) {
+        _lastMeasurementTrace = std::make_unique<alk_measure::MeasurementTrace>(trace);
+    }
+
     std::unique_ptr<alk_measure::TriggerRequest> retrievePendingFeedRequest() {
         if (_pendingTrigger) {
             auto feedReq = std::move(_pendingTrigger);
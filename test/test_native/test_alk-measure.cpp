@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "readings/alk-measure.h"
+#include "readings/alk-measure-checkpoint.h"
 #include "doser/doser.h"
 #include "mqtt-common.h"
 #include "ph-mock.h"
@@ -20,7 +21,11 @@ class MockDoser : public doser::Doser {
    public:
     MockDoser(): doser::Doser(NONE_CONFIG) {}
 
-    virtual void doseML(const float outputML, doser::Calibrator *aCalibrator = nullptr) { }
+    float dosedML = 0;
+
+    virtual void doseML(const float outputML, doser::Calibrator *aCalibrator = nullptr) {
+        dosedML += outputML;
+    }
 
     virtual void setup() {}
 
@@ -43,6 +48,7 @@ std::unique_ptr<doser::BuffDosers> buildMockDosers() {
 auto buildPublisherMock() {
     auto publisherMock = std::make_shared<Mock<mqtt::Publisher>>();
     When(Method((*publisherMock), publishAlkReading)).AlwaysReturn();
+    When(Method((*publisherMock), publishMeasurementTrace)).AlwaysReturn();
     return publisherMock;
 }
 
@@ -194,6 +200,23 @@ void testSequenceWithSingleDose() {
     // =3.1/200*280
     TEST_ASSERT_EQUAL_FLOAT(4.34, cleanupResult.alkReading.alkReadingDKH);
     Verify(Method((*publisherMock), publishAlkReading).Matching([](const alk_measure::AlkReading &alkReading) { return abs(alkReading.alkReadingDKH - 4.34) < 0.01; })).Exactly(Once);
+
+    // Trace
+    auto &trace = *cleanupResult.trace;
+    TEST_ASSERT_EQUAL(1, trace.phases[alk_measure::PRIME].steps);
+    TEST_ASSERT_EQUAL(1, trace.phases[alk_measure::CLEAN_AND_FILL].steps);
+    TEST_ASSERT_EQUAL(7, trace.phases[alk_measure::MEASURE].steps);
+    TEST_ASSERT_EQUAL(1, trace.phases[alk_measure::CLEANUP].steps);
+    TEST_ASSERT_EQUAL(2, trace.measureSteps[alk_measure::STEP_INITIALIZE]);
+    TEST_ASSERT_EQUAL(4, trace.measureSteps[alk_measure::MEASURE_PH]);
+    TEST_ASSERT_EQUAL(1, trace.measureSteps[alk_measure::DOSE]);
+    // prime 5, clean & fill 4, dose 2, cleanup 3
+    TEST_ASSERT_EQUAL(14, trace.doserCalls);
+    TEST_ASSERT_EQUAL(2, trace.decisions);
+    TEST_ASSERT_EQUAL(2, trace.phSamplesPerDecisionMin);
+    TEST_ASSERT_EQUAL(2, trace.phSamplesPerDecisionMax);
+    TEST_ASSERT_EQUAL(4, trace.phSamplesTotal);
+    Verify(Method((*publisherMock), publishMeasurementTrace).Matching([](const alk_measure::AlkReading &alkReading, const alk_measure::MeasurementTrace &trace) { return trace.decisions == 2; })).Exactly(Once);
 }
 
 void testPublishResultIsReadable() {
@@ -240,10 +263,280 @@ void testPublishResultIsReadable() {
     })).Exactly(Once);
 }
 
+void testSampleSourceRoutesFill() {
+    stubs();
+
+    auto buffDosers = buildMockDosers();
+    auto defaultFillDoser = std::static_pointer_cast<MockDoser>(buffDosers->selectDoser(MeasurementDoserType::FILL));
+    auto tank2FillDoser = std::static_pointer_cast<MockDoser>(buffDosers->selectDoser(MeasurementDoserType::FILL_2));
+    buffDosers->addSampleSource({.title = "tank2", .doserType = MeasurementDoserType::FILL_2, .flushVolumeML = 20});
+
+    auto x = std::vector<float>({4.5});
+    std::shared_ptr<ph::controller::PHReader> phReader = std::move(buildPHReader(x));
+
+    alk_measure::AlkMeasurementConfig alkMeasureConf = {
+        .primeTankWaterFillVolumeML = 10,
+        .measurementTankWaterVolumeML = 200};
+
+    auto publisherMock = buildPublisherMock();
+    std::shared_ptr<mqtt::Publisher> publisher(mockptrize(publisherMock));
+    auto timeClient = std::make_shared<buff_time::TimeWrapper>();
+
+    buff::alk_measure::AlkMeasurer measurer(std::move(buffDosers), alkMeasureConf, phReader);
+
+    auto beginStepResult = measurer.begin<1>(0, 0, "tank2");
+    TEST_ASSERT_EQUAL(MeasurementDoserType::FILL_2, beginStepResult.alkMeasureConf.sampleDoserType);
+    TEST_ASSERT_EQUAL_FLOAT(20, beginStepResult.alkMeasureConf.sampleFlushVolumeML);
+
+    measurer.measureAlk<1>(publisher, timeClient, beginStepResult);
+    // flush + prime + fill
+    TEST_ASSERT_EQUAL_FLOAT(20 + 10 + 200, tank2FillDoser->dosedML);
+    TEST_ASSERT_EQUAL_FLOAT(0, defaultFillDoser->dosedML);
+
+    auto otherStepResult = measurer.begin<1>(0, 0, "other");
+    TEST_ASSERT_EQUAL(MeasurementDoserType::FILL, otherStepResult.alkMeasureConf.sampleDoserType);
+    TEST_ASSERT_EQUAL_FLOAT(0, otherStepResult.alkMeasureConf.sampleFlushVolumeML);
+}
+
+void testSampleSourcesRoundRobin() {
+    auto buffDosers = buildMockDosers();
+    TEST_ASSERT_NULL(buffDosers->nextSampleSource());
+
+    buffDosers->addSampleSource({.title = "a", .doserType = MeasurementDoserType::FILL});
+    buffDosers->addSampleSource({.title = "b", .doserType = MeasurementDoserType::FILL_2});
+
+    TEST_ASSERT_EQUAL_STRING("a", buffDosers->nextSampleSource()->title.c_str());
+    // peeking doesn't move on, eg when the measurement's refused
+    TEST_ASSERT_EQUAL_STRING("b", buffDosers->peekNextSampleSource()->title.c_str());
+    TEST_ASSERT_EQUAL_STRING("b", buffDosers->peekNextSampleSource()->title.c_str());
+    TEST_ASSERT_EQUAL_STRING("b", buffDosers->nextSampleSource()->title.c_str());
+    TEST_ASSERT_EQUAL_STRING("a", buffDosers->nextSampleSource()->title.c_str());
+}
+
+void testSampleSourceWithoutDoserIsRejected() {
+    stubs();
+
+    doser::BuffDosers buffDosers(1);
+    buffDosers.emplace(MeasurementDoserType::FILL, std::make_shared<MockDoser>());
+
+    // no FILL_2 doser, it'd end up sampling the main tank
+    buffDosers.addSampleSource({.title = "tank2", .doserType = MeasurementDoserType::FILL_2});
+    TEST_ASSERT_NULL(buffDosers.findSampleSource("tank2"));
+    TEST_ASSERT_EQUAL(0, buffDosers.getSampleSources().size());
+
+    buffDosers.addSampleSource({.title = "main", .doserType = MeasurementDoserType::FILL});
+    TEST_ASSERT_NOT_NULL(buffDosers.findSampleSource("main"));
+}
+
+void testSampleSourcesCapped() {
+    stubs();
+
+    TEST_ASSERT_EQUAL(4, MAX_SAMPLE_SOURCES);
+    auto buffDosers = buildMockDosers();
+    for (size_t i = 0; i < MAX_SAMPLE_SOURCES + 2; i++) {
+        buffDosers->addSampleSource({.title = "tank" + std::to_string(i), .doserType = MeasurementDoserType::FILL});
+    }
+    TEST_ASSERT_EQUAL(MAX_SAMPLE_SOURCES, buffDosers->getSampleSources().size());
+}
+
+void testDoserHolds() {
+    stubs();
+
+    doser::BuffDosers buffDosers(1);
+    TEST_ASSERT_TRUE(buffDosers.tryHoldForDose());
+    TEST_ASSERT_TRUE(buffDosers.tryHoldForDose());
+    TEST_ASSERT_FALSE(buffDosers.tryHoldForMeasurement());
+
+    // still enabled for the other dose
+    buffDosers.releaseDose();
+    Verify(Method(ArduinoFake(), digitalWrite).Using(1, HIGH)).Never();
+    buffDosers.releaseDose();
+    Verify(Method(ArduinoFake(), digitalWrite).Using(1, LOW)).Exactly(Once);
+    Verify(Method(ArduinoFake(), digitalWrite).Using(1, HIGH)).Exactly(Once);
+
+    TEST_ASSERT_TRUE(buffDosers.tryHoldForMeasurement());
+    TEST_ASSERT_TRUE(buffDosers.measuring());
+    TEST_ASSERT_FALSE(buffDosers.tryHoldForDose());
+    TEST_ASSERT_FALSE(buffDosers.tryHoldForMeasurement());
+
+    // eg a calibration change, not while the measurement could be dosing with the old one
+    bool changed = false;
+    TEST_ASSERT_FALSE(buffDosers.tryUnlessMeasuring([&]() { changed = true; }));
+    TEST_ASSERT_FALSE(changed);
+
+    buffDosers.releaseMeasurement();
+    TEST_ASSERT_FALSE(buffDosers.measuring());
+    TEST_ASSERT_TRUE(buffDosers.tryUnlessMeasuring([&]() { changed = true; }));
+    TEST_ASSERT_TRUE(changed);
+    TEST_ASSERT_TRUE(buffDosers.tryHoldForDose());
+}
+
+void testMeasurementWaitsForDoses() {
+    stubs();
+
+    auto x = std::vector<float>({4.5});
+    std::shared_ptr<ph::controller::PHReader> phReader = std::move(buildPHReader(x));
+    alk_measure::AlkMeasurementConfig alkMeasureConf = {.measurementTankWaterVolumeML = 200};
+
+    auto publisherMock = buildPublisherMock();
+    std::shared_ptr<mqtt::Publisher> publisher(mockptrize(publisherMock));
+    auto timeClient = std::make_shared<buff_time::TimeWrapper>();
+
+    std::shared_ptr<doser::BuffDosers> buffDosers = buildMockDosers();
+    auto fillDoser = std::static_pointer_cast<MockDoser>(buffDosers->selectDoser(MeasurementDoserType::FILL));
+    buff::alk_measure::AlkMeasurer measurer(buffDosers, alkMeasureConf, phReader);
+
+    auto step = measurer.begin<1>(0, 0, "test");
+    step.nextAction = alk_measure::ABORT_CLEANUP;
+
+    // a manual dose is running, so nothing moves
+    TEST_ASSERT_TRUE(buffDosers->tryHoldForDose());
+    step = measurer.measureAlk<1>(publisher, timeClient, step);
+    TEST_ASSERT_EQUAL(alk_measure::ABORT_CLEANUP, step.nextAction);
+    TEST_ASSERT_EQUAL_FLOAT(0, fillDoser->dosedML);
+    TEST_ASSERT_FALSE(buffDosers->measuring());
+
+    buffDosers->releaseDose();
+    step = measurer.measureAlk<1>(publisher, timeClient, step);
+    TEST_ASSERT_EQUAL(alk_measure::MEASURE_DONE, step.nextAction);
+    TEST_ASSERT_TRUE(fillDoser->dosedML > 0);
+
+    // let go once done, so doses can run again
+    TEST_ASSERT_FALSE(buffDosers->measuring());
+    TEST_ASSERT_TRUE(buffDosers->tryHoldForDose());
+}
+
+void testAbandonedRunLetsGoOfDosers() {
+    stubs();
+
+    auto x = std::vector<float>({4.5, 4.5});
+    std::shared_ptr<ph::controller::PHReader> phReader = std::move(buildPHReader(x));
+    alk_measure::AlkMeasurementConfig alkMeasureConf = {};
+
+    auto publisherMock = buildPublisherMock();
+    std::shared_ptr<mqtt::Publisher> publisher(mockptrize(publisherMock));
+    auto timeClient = std::make_shared<buff_time::TimeWrapper>();
+
+    std::shared_ptr<doser::BuffDosers> buffDosers = buildMockDosers();
+    buff::alk_measure::AlkMeasurer measurer(buffDosers, alkMeasureConf, phReader);
+
+    auto first = std::make_unique<alk_measure::MeasurementStepResult<1>>(measurer.begin<1>(0, 0, "first"));
+    first->nextAction = alk_measure::MEASURE;
+    *first = measurer.measureAlk<1>(publisher, timeClient, *first);
+    TEST_ASSERT_NOT_NULL(first->dosersHold);
+    TEST_ASSERT_TRUE(buffDosers->measuring());
+
+    // the hold's per run, a second one waits rather than sharing it
+    auto second = measurer.begin<1>(0, 0, "second");
+    second.nextAction = alk_measure::MEASURE;
+    second = measurer.measureAlk<1>(publisher, timeClient, second);
+    TEST_ASSERT_NULL(second.dosersHold);
+    TEST_ASSERT_EQUAL(alk_measure::STEP_INITIALIZE, second.nextMeasurementStepAction);
+
+    // eg a manual run that's replaced part way through
+    first.reset();
+    TEST_ASSERT_FALSE(buffDosers->measuring());
+    second = measurer.measureAlk<1>(publisher, timeClient, second);
+    TEST_ASSERT_NOT_NULL(second.dosersHold);
+    TEST_ASSERT_TRUE(buffDosers->measuring());
+}
+
+void testResumeFromCheckpoint() {
+    stubs();
+
+    auto x = std::vector<float>({4.5});
+    std::shared_ptr<ph::controller::PHReader> phReader = std::move(buildPHReader(x));
+    alk_measure::AlkMeasurementConfig alkMeasureConf = {};
+    buff::alk_measure::AlkMeasurer measurer(buildMockDosers(), alkMeasureConf, phReader);
+
+    alk_measure::MeasurementCheckpoint checkpoint;
+    checkpoint.title = "resumed";
+    checkpoint.tankWaterVolumeML = 200;
+    checkpoint.reagentVolumeML = 4.3;
+
+    checkpoint.nextAction = alk_measure::CLEAN_AND_FILL;
+    auto resumed = alk_measure::resumeFromCheckpoint<1>(measurer, checkpoint, FAKED_MILLIS, FAKED_MILLIS);
+    TEST_ASSERT_EQUAL(alk_measure::CLEAN_AND_FILL, resumed.nextAction);
+    TEST_ASSERT_EQUAL_FLOAT(0, resumed.alkReading.reagentVolumeML);
+    TEST_ASSERT_EQUAL_STRING("resumed", resumed.alkReading.title.c_str());
+
+    // interrupted between doses, so the reagent volume is known
+    checkpoint.nextAction = alk_measure::MEASURE;
+    checkpoint.nextMeasurementStepAction = alk_measure::MEASURE_PH;
+    resumed = alk_measure::resumeFromCheckpoint<1>(measurer, checkpoint, FAKED_MILLIS, FAKED_MILLIS);
+    TEST_ASSERT_EQUAL(alk_measure::MEASURE, resumed.nextAction);
+    TEST_ASSERT_EQUAL(alk_measure::STEP_INITIALIZE, resumed.nextMeasurementStepAction);
+    TEST_ASSERT_EQUAL_FLOAT(200, resumed.alkReading.tankWaterVolumeML);
+    TEST_ASSERT_EQUAL_FLOAT(4.3, resumed.alkReading.reagentVolumeML);
+
+    // possibly interrupted mid-dose
+    checkpoint.nextMeasurementStepAction = alk_measure::DOSE;
+    resumed = alk_measure::resumeFromCheckpoint<1>(measurer, checkpoint, FAKED_MILLIS, FAKED_MILLIS);
+    TEST_ASSERT_EQUAL(alk_measure::ABORT_CLEANUP, resumed.nextAction);
+
+    checkpoint.nextAction = alk_measure::CLEANUP;
+    resumed = alk_measure::resumeFromCheckpoint<1>(measurer, checkpoint, FAKED_MILLIS, FAKED_MILLIS);
+    TEST_ASSERT_EQUAL(alk_measure::ABORT_CLEANUP, resumed.nextAction);
+}
+
+void testAbortCleanupDoesNotPublish() {
+    stubs();
+
+    auto x = std::vector<float>({4.5});
+    std::shared_ptr<ph::controller::PHReader> phReader = std::move(buildPHReader(x));
+    alk_measure::AlkMeasurementConfig alkMeasureConf = {};
+
+    auto publisherMock = buildPublisherMock();
+    std::shared_ptr<mqtt::Publisher> publisher(mockptrize(publisherMock));
+    auto timeClient = std::make_shared<buff_time::TimeWrapper>();
+
+    buff::alk_measure::AlkMeasurer measurer(buildMockDosers(), alkMeasureConf, phReader);
+
+    auto step = measurer.begin<1>(0, 0, "test");
+    step.nextAction = alk_measure::ABORT_CLEANUP;
+    step = measurer.measureAlk<1>(publisher, timeClient, step);
+    TEST_ASSERT_EQUAL(alk_measure::MEASURE_DONE, step.nextAction);
+    Verify(Method((*publisherMock), publishAlkReading)).Never();
+}
+
+void testCheckpointsOnlyAroundDoses() {
+    alk_measure::MeasurementStepResult<1> prev;
+    prev.nextAction = alk_measure::MEASURE;
+    prev.nextMeasurementStepAction = alk_measure::STEP_INITIALIZE;
+    auto next = prev;
+
+    next.nextMeasurementStepAction = alk_measure::MEASURE_PH;
+    TEST_ASSERT_FALSE(alk_measure::shouldCheckpoint(prev, next));
+
+    prev = next;
+    TEST_ASSERT_FALSE(alk_measure::shouldCheckpoint(prev, next));
+
+    next.nextMeasurementStepAction = alk_measure::DOSE;
+    TEST_ASSERT_TRUE(alk_measure::shouldCheckpoint(prev, next));
+
+    prev = next;
+    next.nextMeasurementStepAction = alk_measure::STEP_INITIALIZE;
+    TEST_ASSERT_TRUE(alk_measure::shouldCheckpoint(prev, next));
+
+    prev = next;
+    next.nextAction = alk_measure::CLEANUP;
+    TEST_ASSERT_TRUE(alk_measure::shouldCheckpoint(prev, next));
+}
+
 }  // namespace test_alk_measure
 
 void runAlkMeasureTests() {
     RUN_TEST(test_alk_measure::testBeginStartsEmpty);
     RUN_TEST(test_alk_measure::testSequenceWithSingleDose);
     RUN_TEST(test_alk_measure::testPublishResultIsReadable);
+    RUN_TEST(test_alk_measure::testSampleSourceRoutesFill);
+    RUN_TEST(test_alk_measure::testSampleSourcesRoundRobin);
+    RUN_TEST(test_alk_measure::testSampleSourceWithoutDoserIsRejected);
+    RUN_TEST(test_alk_measure::testSampleSourcesCapped);
+    RUN_TEST(test_alk_measure::testDoserHolds);
+    RUN_TEST(test_alk_measure::testMeasurementWaitsForDoses);
+    RUN_TEST(test_alk_measure::testAbandonedRunLetsGoOfDosers);
+    RUN_TEST(test_alk_measure::testResumeFromCheckpoint);
+    RUN_TEST(test_alk_measure::testAbortCleanupDoesNotPublish);
+    RUN_TEST(test_alk_measure::testCheckpointsOnlyAroundDoses);
 }
@@ -0,0 +1,142 @@
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "concurrency/deadline-scheduler.h"
+
+namespace test_deadline_scheduler {
+using namespace buff;
+
+/*******************************
+ * Stands in for a task: sleeps (jumps the clock) straight to the next
+ * deadline, or to the next I/O event if that comes first.
+ *******************************/
+class VirtualClockTask {
+   public:
+    concurrency::DeadlineScheduler scheduler;
+    uint64_t nowMS = 0;
+    unsigned int wakeups = 0;
+
+    void runUntil(const uint64_t endMS) {
+        while (true) {
+            scheduler.runDue(nowMS);
+            const uint64_t nextMS = scheduler.nextDeadlineMS();
+            if (nextMS > endMS) break;
+            nowMS = nextMS;
+            wakeups++;
+        }
+        nowMS = endMS;
+    }
+};
+
+void testRunsInDeadlineOrder() {
+    VirtualClockTask task;
+    std::vector<std::string> ran;
+    task.scheduler.add("a", [&](const uint64_t nowMS) {
+        ran.push_back("a@" + std::to_string(nowMS));
+        return 30ul;
+    });
+    task.scheduler.add("b", [&](const uint64_t nowMS) {
+        ran.push_back("b@" + std::to_string(nowMS));
+        return 20ul;
+    });
+
+    task.runUntil(60);
+    const std::vector<std::string> expected = {"a@0", "b@0", "b@20", "a@30", "b@40", "a@60", "b@60"};
+    TEST_ASSERT_EQUAL(expected.size(), ran.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_EQUAL_STRING(expected[i].c_str(), ran[i].c_str());
+    }
+    // only woke up when something was due, not every ms
+    TEST_ASSERT_EQUAL(4, task.wakeups);
+}
+
+void testSleepsUntilNextDeadline() {
+    concurrency::DeadlineScheduler scheduler;
+    TEST_ASSERT_TRUE(scheduler.nextDeadlineMS() == UINT64_MAX);
+    TEST_ASSERT_EQUAL(1000, scheduler.msUntilNextDeadline(0, 1000));
+
+    scheduler.add("slow", [](const uint64_t nowMS) { return 5000ul; }, 100);
+    TEST_ASSERT_EQUAL(60, scheduler.msUntilNextDeadline(40, 1000));
+    TEST_ASSERT_EQUAL(0, scheduler.msUntilNextDeadline(100, 1000));
+
+    scheduler.runDue(100);
+    // capped, the task still wakes up now & then
+    TEST_ASSERT_EQUAL(1000, scheduler.msUntilNextDeadline(100, 1000));
+    TEST_ASSERT_TRUE(scheduler.nextDeadlineMS() == 5100);
+}
+
+void testWakePullsJobForward() {
+    VirtualClockTask task;
+    std::vector<uint64_t> ran;
+    const size_t job = task.scheduler.add("commands", [&](const uint64_t nowMS) {
+        ran.push_back(nowMS);
+        return 1000ul;
+    });
+
+    task.runUntil(250);
+    // a message arrives at 250
+    task.scheduler.wake(job, task.nowMS);
+    // waking for later than it's already due doesn't push it back
+    task.scheduler.wake(job, 5000);
+    task.runUntil(2000);
+
+    const std::vector<uint64_t> expected = {0, 250, 1250};
+    TEST_ASSERT_EQUAL(expected.size(), ran.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_TRUE(expected[i] == ran[i]);
+    }
+}
+
+void testBusyJobDoesNotStarveOthers() {
+    concurrency::DeadlineScheduler scheduler;
+    unsigned int busyRuns = 0;
+    unsigned int otherRuns = 0;
+    scheduler.add("busy", [&](const uint64_t nowMS) {
+        busyRuns++;
+        return 0ul;
+    });
+    scheduler.add("other", [&](const uint64_t nowMS) {
+        otherRuns++;
+        return 10ul;
+    });
+
+    TEST_ASSERT_EQUAL(2, scheduler.runDue(0));
+    TEST_ASSERT_EQUAL(1, scheduler.runDue(0));
+    TEST_ASSERT_EQUAL(2, scheduler.runDue(10));
+    TEST_ASSERT_EQUAL(3, busyRuns);
+    TEST_ASSERT_EQUAL(2, otherRuns);
+}
+
+void testLateRunsAreNotBunchedUp() {
+    concurrency::DeadlineScheduler scheduler;
+    std::vector<uint64_t> ran;
+    scheduler.add("step", [&](const uint64_t nowMS) {
+        ran.push_back(nowMS);
+        return 1000ul;
+    });
+
+    scheduler.runDue(0);
+    // the task was held up well past the deadline, eg by a long dose
+    scheduler.runDue(3500);
+    scheduler.runDue(4000);
+    scheduler.runDue(4500);
+
+    // runs once when it gets the chance, then 1s after that
+    const std::vector<uint64_t> expected = {0, 3500, 4500};
+    TEST_ASSERT_EQUAL(expected.size(), ran.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_TRUE(expected[i] == ran[i]);
+    }
+}
+
+}  // namespace test_deadline_scheduler
+
+void runDeadlineSchedulerTests() {
+    RUN_TEST(test_deadline_scheduler::testRunsInDeadlineOrder);
+    RUN_TEST(test_deadline_scheduler::testSleepsUntilNextDeadline);
+    RUN_TEST(test_deadline_scheduler::testWakePullsJobForward);
+    RUN_TEST(test_deadline_scheduler::testBusyJobDoesNotStarveOthers);
+    RUN_TEST(test_deadline_scheduler::testLateRunsAreNotBunchedUp);
+}
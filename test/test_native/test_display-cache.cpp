@@ -0,0 +1,51 @@
+#include <unity.h>
+
+#include "buff-displays/display-cache.h"
+
+namespace test_display_cache {
+using namespace buff;
+
+void testOnlyChangedFieldsRedraw() {
+    monitoring_display::TextCache texts(2);
+
+    TEST_ASSERT_TRUE(texts.changed(0, "ph: 8.1"));
+    TEST_ASSERT_TRUE(texts.changed(1, ""));
+    TEST_ASSERT_FALSE(texts.changed(0, "ph: 8.1"));
+    TEST_ASSERT_FALSE(texts.changed(1, ""));
+
+    TEST_ASSERT_TRUE(texts.changed(0, "ph: 8.2"));
+    TEST_ASSERT_EQUAL_STRING("ph: 8.2", texts.text(0).c_str());
+
+    texts.invalidate();
+    TEST_ASSERT_TRUE(texts.changed(0, "ph: 8.2"));
+}
+
+void testRefreshesAreCapped() {
+    monitoring_display::RefreshLimiter limiter(1000);
+
+    // nothing to draw
+    TEST_ASSERT_FALSE(limiter.shouldRefresh(0));
+
+    // the first draws straight away
+    limiter.markPending();
+    TEST_ASSERT_TRUE(limiter.shouldRefresh(5));
+    TEST_ASSERT_FALSE(limiter.pending());
+
+    // a burst is held
+    limiter.markPending();
+    TEST_ASSERT_FALSE(limiter.shouldRefresh(300));
+    limiter.markPending();
+    TEST_ASSERT_FALSE(limiter.shouldRefresh(900));
+    TEST_ASSERT_TRUE(limiter.pending());
+
+    // then drawn once
+    TEST_ASSERT_TRUE(limiter.shouldRefresh(1005));
+    TEST_ASSERT_FALSE(limiter.shouldRefresh(3000));
+}
+
+}  // namespace test_display_cache
+
+void runDisplayCacheTests() {
+    RUN_TEST(test_display_cache::testOnlyChangedFieldsRedraw);
+    RUN_TEST(test_display_cache::testRefreshesAreCapped);
+}
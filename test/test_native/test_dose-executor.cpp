@@ -0,0 +1,140 @@
+#include <unity.h>
+
+#include <memory>
+#include <vector>
+
+#include "doser/dose-executor.h"
+
+namespace test_dose_executor {
+using namespace buff;
+
+const DoserConfig FAKE_DOSER_CONFIG = {.mlPerFullRotation = 0.5, .motorRPM = 60, .microStepType = SIXTEENTH};
+
+// each runDose call outputs 0.01ml
+class FakeDoser : public doser::Doser {
+   private:
+    long _stepsRemaining = 0;
+    long _stepsDone = 0;
+
+   public:
+    FakeDoser() : Doser(FAKE_DOSER_CONFIG) {}
+
+    std::vector<float> starts;
+
+    void doseML(const float outputML, doser::Calibrator *aCalibrator = nullptr) override {}
+    void setup() override {}
+    void debugRotateDegrees(const int deg) override {}
+    void debugRotateSteps(const long steps) override {}
+
+    void startDoseML(const float outputML, doser::Calibrator *aCalibrator = nullptr) override {
+        starts.push_back(outputML);
+        _stepsRemaining = round(outputML * 100);
+        _stepsDone = 0;
+    }
+
+    bool runDose() override {
+        if (_stepsRemaining == 0) return false;
+        _stepsRemaining--;
+        _stepsDone++;
+        return _stepsRemaining > 0;
+    }
+
+    void stopDose() override { _stepsRemaining = 0; }
+
+    float dosedML() override { return _stepsDone / 100.0; }
+};
+
+void testDoseVolume() {
+    auto fake = std::make_shared<FakeDoser>();
+    doser::DoseExecutor executor(fake);
+
+    TEST_ASSERT_FALSE(executor.loop(0));
+    executor.doseVolume(0.5, 0);
+    TEST_ASSERT_TRUE(executor.loop(0));
+    TEST_ASSERT_EQUAL(1, fake->starts.size());
+
+    // one step per loop
+    for (int i = 0; i < 10; i++) executor.loop(i);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 0.1, executor.dosedML());
+
+    while (executor.loop(100)) {
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 0.5, executor.dosedML());
+    TEST_ASSERT_EQUAL(1, fake->starts.size());
+    TEST_ASSERT_FALSE(executor.active());
+}
+
+void testDoseOverTimeIsRateLimited() {
+    auto fake = std::make_shared<FakeDoser>();
+    doser::DoseExecutor executor(fake, 1000);
+
+    // 1ml over 10s
+    executor.doseVolumeOverTime(1.0, 10000, 0);
+    unsigned long now = 0;
+    for (; now < 5000; now += 10) {
+        executor.loop(now);
+    }
+    // never ahead of schedule, and at most a chunk behind
+    TEST_ASSERT_TRUE(executor.dosedML() <= 0.5 + 0.001);
+    TEST_ASSERT_TRUE(executor.dosedML() >= 0.4 - 0.001);
+
+    for (; now < 12000; now += 10) {
+        executor.loop(now);
+    }
+    TEST_ASSERT_FALSE(executor.active());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 1.0, executor.dosedML());
+    // chunked, one per interval
+    TEST_ASSERT_TRUE(fake->starts.size() >= 9);
+    TEST_ASSERT_TRUE(fake->starts.size() <= 11);
+}
+
+void testConstantFlowRate() {
+    auto fake = std::make_shared<FakeDoser>();
+    doser::DoseExecutor executor(fake, 1000);
+
+    // 3ml/min for 1 minute
+    executor.doseConstantFlowRate(3.0, 60000, 0);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 3.0, executor.requestedML());
+    for (unsigned long now = 0; now <= 61000; now += 10) {
+        executor.loop(now);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 3.0, executor.dosedML());
+}
+
+void testPauseResumeAndStop() {
+    auto fake = std::make_shared<FakeDoser>();
+    doser::DoseExecutor executor(fake);
+
+    executor.doseVolume(0.5, 0);
+    for (int i = 0; i < 11; i++) executor.loop(i);
+    executor.pause(20);
+    const float pausedAt = executor.dosedML();
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 0.1, pausedAt);
+
+    for (int i = 0; i < 50; i++) TEST_ASSERT_TRUE(executor.loop(30 + i));
+    TEST_ASSERT_EQUAL_FLOAT(pausedAt, executor.dosedML());
+
+    // picks up the remainder
+    executor.resume(100);
+    while (executor.loop(100)) {
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 0.5, executor.dosedML());
+    TEST_ASSERT_EQUAL(2, fake->starts.size());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 0.4, fake->starts[1]);
+
+    executor.doseContinuously(200);
+    for (int i = 0; i < 120; i++) executor.loop(200 + i);
+    TEST_ASSERT_TRUE(executor.active());
+    TEST_ASSERT_FLOAT_WITHIN(0.02, 1.2, executor.dosedML());
+    executor.stop();
+    TEST_ASSERT_FALSE(executor.loop(400));
+}
+
+}  // namespace test_dose_executor
+
+void runDoseExecutorTests() {
+    RUN_TEST(test_dose_executor::testDoseVolume);
+    RUN_TEST(test_dose_executor::testDoseOverTimeIsRateLimited);
+    RUN_TEST(test_dose_executor::testConstantFlowRate);
+    RUN_TEST(test_dose_executor::testPauseResumeAndStop);
+}
@@ -0,0 +1,92 @@
+#include <unity.h>
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrency/i2c-bus.h"
+
+namespace test_i2c_bus {
+using namespace buff;
+
+class FakeWire {
+   public:
+    std::vector<uint32_t> clocks;
+    void setClock(const uint32_t clockHz) { clocks.push_back(clockHz); }
+};
+
+typedef concurrency::I2CBus<FakeWire> FakeBus;
+
+void waitFor(FakeBus& bus, const concurrency::I2CPriority priority, const unsigned int count) {
+    while (bus.waiting(priority) < count) {
+        std::this_thread::yield();
+    }
+}
+
+void testClockOnlySwitchedWhenNeeded() {
+    FakeWire wire;
+    FakeBus bus(wire);
+
+    { FakeBus::Transaction sensor(bus, concurrency::I2C_HIGH_PRIORITY, 10000); }
+    { FakeBus::Transaction sensor(bus, concurrency::I2C_HIGH_PRIORITY, 10000); }
+    {
+        FakeBus::Transaction display(bus, concurrency::I2C_LOW_PRIORITY, 400000);
+        TEST_ASSERT_EQUAL(400000, bus.clockHz());
+    }
+
+    const std::vector<uint32_t> expected = {10000, 400000};
+    TEST_ASSERT_EQUAL(expected.size(), wire.clocks.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_EQUAL(expected[i], wire.clocks[i]);
+    }
+    TEST_ASSERT_EQUAL(3, bus.transactions());
+    TEST_ASSERT_EQUAL(0, bus.contended());
+}
+
+void testSensorGoesBeforeQueuedDisplay() {
+    FakeWire wire;
+    FakeBus bus(wire);
+    std::mutex ranMutex;
+    std::vector<std::string> ran;
+    auto record = [&](const char* name) {
+        std::lock_guard<std::mutex> lock(ranMutex);
+        ran.push_back(name);
+    };
+
+    std::thread display;
+    std::thread sensor;
+    {
+        // a display page is going out
+        FakeBus::Transaction page(bus, concurrency::I2C_LOW_PRIORITY, 400000);
+
+        // the next page queues up first
+        display = std::thread([&]() {
+            FakeBus::Transaction nextPage(bus, concurrency::I2C_LOW_PRIORITY, 400000);
+            record("display");
+        });
+        waitFor(bus, concurrency::I2C_LOW_PRIORITY, 1);
+
+        sensor = std::thread([&]() {
+            FakeBus::Transaction read(bus, concurrency::I2C_HIGH_PRIORITY, 10000);
+            record("sensor");
+        });
+        waitFor(bus, concurrency::I2C_HIGH_PRIORITY, 1);
+    }
+    display.join();
+    sensor.join();
+
+    TEST_ASSERT_EQUAL(2, ran.size());
+    TEST_ASSERT_EQUAL_STRING("sensor", ran[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("display", ran[1].c_str());
+    TEST_ASSERT_EQUAL(2, bus.contended());
+    // back up to speed for the display after the read
+    TEST_ASSERT_EQUAL(400000, bus.clockHz());
+}
+
+}  // namespace test_i2c_bus
+
+void runI2CBusTests() {
+    RUN_TEST(test_i2c_bus::testClockOnlySwitchedWhenNeeded);
+    RUN_TEST(test_i2c_bus::testSensorGoesBeforeQueuedDisplay);
+}
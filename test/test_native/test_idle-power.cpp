@@ -0,0 +1,134 @@
+#include <unity.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "power/idle-power.h"
+
+namespace test_idle_power {
+using namespace buff;
+
+class RecordingHooks : public power::PowerHooks {
+   public:
+    std::vector<std::string> calls;
+    int backlight = 255;
+    bool lowPower = false;
+    bool slowSampling = false;
+    unsigned int parks = 0;
+
+    void parkSteppers() override {
+        parks++;
+        calls.push_back("park");
+    }
+    void setBacklight(const uint8_t brightness) override {
+        backlight = brightness;
+        calls.push_back("backlight=" + std::to_string(brightness));
+    }
+    void setLowPower(const bool low) override {
+        lowPower = low;
+        calls.push_back(low ? "lowPower" : "fullPower");
+    }
+    void setSlowSampling(const bool slow) override {
+        slowSampling = slow;
+        calls.push_back(slow ? "slowSampling" : "fastSampling");
+    }
+};
+
+power::IdlePowerConfig testConfig() {
+    power::IdlePowerConfig config;
+    config.idleAfterMS = 1000;
+    config.blankAfterMS = 5000;
+    config.idleBrightness = 40;
+    config.idlePHReadIntervalMS = 10000;
+    return config;
+}
+
+void testWindsDownWhenQuiet() {
+    auto hooks = std::make_shared<RecordingHooks>();
+    power::IdlePowerManager manager(hooks, testConfig());
+
+    manager.loop(0, false);
+    manager.loop(999, false);
+    TEST_ASSERT_EQUAL(power::ACTIVE, manager.state());
+    TEST_ASSERT_EQUAL(0, hooks->calls.size());
+    TEST_ASSERT_EQUAL(1000, manager.phReadIntervalMS(1000));
+
+    manager.loop(1000, false);
+    TEST_ASSERT_EQUAL(power::IDLE, manager.state());
+    const std::vector<std::string> expected = {"park", "slowSampling", "lowPower", "backlight=40"};
+    TEST_ASSERT_EQUAL(expected.size(), hooks->calls.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_EQUAL_STRING(expected[i].c_str(), hooks->calls[i].c_str());
+    }
+    TEST_ASSERT_EQUAL(10000, manager.phReadIntervalMS(1000));
+
+    // blanking only touches the display
+    manager.loop(5000, false);
+    TEST_ASSERT_EQUAL(power::BLANKED, manager.state());
+    TEST_ASSERT_EQUAL(0, hooks->backlight);
+    TEST_ASSERT_EQUAL(1, hooks->parks);
+    TEST_ASSERT_EQUAL(5, hooks->calls.size());
+}
+
+void testWakesOnTouchAndCommands() {
+    auto hooks = std::make_shared<RecordingHooks>();
+    power::IdlePowerManager manager(hooks, testConfig());
+
+    manager.loop(6000, false);
+    TEST_ASSERT_EQUAL(power::BLANKED, manager.state());
+
+    manager.wake(power::WAKE_TOUCH);
+    manager.loop(6100, false);
+    TEST_ASSERT_EQUAL(power::ACTIVE, manager.state());
+    TEST_ASSERT_EQUAL(power::WAKE_TOUCH, manager.lastWakeSource());
+    TEST_ASSERT_EQUAL(255, hooks->backlight);
+    TEST_ASSERT_FALSE(hooks->lowPower);
+    TEST_ASSERT_FALSE(hooks->slowSampling);
+    TEST_ASSERT_EQUAL(1, manager.wakeCount());
+
+    // the quiet period restarts from the touch
+    manager.loop(7099, false);
+    TEST_ASSERT_EQUAL(power::ACTIVE, manager.state());
+    manager.loop(7100, false);
+    TEST_ASSERT_EQUAL(power::IDLE, manager.state());
+
+    manager.wake(power::WAKE_MQTT);
+    manager.loop(7200, false);
+    TEST_ASSERT_EQUAL(power::ACTIVE, manager.state());
+    TEST_ASSERT_EQUAL(power::WAKE_MQTT, manager.lastWakeSource());
+    TEST_ASSERT_EQUAL(2, manager.wakeCount());
+    // each wind down parks the steppers again
+    manager.loop(8200, false);
+    TEST_ASSERT_EQUAL(3, hooks->parks);
+}
+
+void testStaysActiveWhileMeasuring() {
+    auto hooks = std::make_shared<RecordingHooks>();
+    power::IdlePowerManager manager(hooks, testConfig());
+
+    manager.loop(2000, false);
+    TEST_ASSERT_EQUAL(power::IDLE, manager.state());
+
+    // a measurement started
+    for (uint64_t nowMS = 2500; nowMS <= 20000; nowMS += 500) {
+        manager.loop(nowMS, true);
+        TEST_ASSERT_EQUAL(power::ACTIVE, manager.state());
+    }
+    TEST_ASSERT_EQUAL(power::WAKE_MEASUREMENT, manager.lastWakeSource());
+    TEST_ASSERT_EQUAL(1, hooks->parks);
+
+    // and finished
+    manager.loop(20500, false);
+    TEST_ASSERT_EQUAL(power::ACTIVE, manager.state());
+    manager.loop(21000, false);
+    TEST_ASSERT_EQUAL(power::IDLE, manager.state());
+}
+
+}  // namespace test_idle_power
+
+void runIdlePowerTests() {
+    RUN_TEST(test_idle_power::testWindsDownWhenQuiet);
+    RUN_TEST(test_idle_power::testWakesOnTouchAndCommands);
+    RUN_TEST(test_idle_power::testStaysActiveWhileMeasuring);
+}
@@ -0,0 +1,130 @@
+#include <unity.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics/loop-profiler.h"
+#include "metrics/metrics.h"
+
+namespace test_metrics {
+using namespace buff;
+
+void testCountersFromManyThreads() {
+    metrics::Counter counter;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 1000; i++) counter.inc();
+        });
+    }
+    for (auto &thread : threads) thread.join();
+    TEST_ASSERT_EQUAL(4000, counter.value());
+}
+
+void testLatencyPercentiles() {
+    metrics::LatencyTracker latency;
+    TEST_ASSERT_EQUAL(0, latency.percentileUS(0.99));
+
+    // 98 fast loops, 2 slow ones
+    for (int i = 0; i < 98; i++) latency.record(100);
+    latency.record(50000);
+    latency.record(70000);
+
+    // bucket upper bounds
+    TEST_ASSERT_EQUAL(128, latency.percentileUS(0.5));
+    TEST_ASSERT_EQUAL(128, latency.percentileUS(0.9));
+    TEST_ASSERT_EQUAL(65536, latency.percentileUS(0.99));
+    TEST_ASSERT_EQUAL(70000, latency.maxUS());
+    TEST_ASSERT_EQUAL(100, latency.count());
+
+    // way past the last bucket, capped at the max
+    latency.record(10000000);
+    TEST_ASSERT_EQUAL(10000000, latency.percentileUS(1.0));
+}
+
+void testLatencyWindowForgetsOldSamples() {
+    metrics::LatencyTracker latency;
+    latency.record(70000);
+    for (uint32_t i = 0; i < 2 * metrics::LatencyTracker::WINDOW_SAMPLES; i++) latency.record(100);
+
+    // capped at the window's max
+    TEST_ASSERT_EQUAL(100, latency.percentileUS(0.99));
+    TEST_ASSERT_EQUAL(100, latency.maxUS());
+    TEST_ASSERT_EQUAL(2 * metrics::LatencyTracker::WINDOW_SAMPLES + 1, latency.count());
+}
+
+void testRender() {
+    metrics::Registry registry;
+    registry.counter("buff_test_total", "A counter").inc(3);
+    registry.gauge("buff_test_bytes", "A gauge").set(-5);
+    registry.latency("buff_test_us", "Latency", R"(task="a")").record(100);
+    registry.latency("buff_other_us", "Latency");
+    registry.latency("buff_test_us", "Latency", R"(task="b")");
+
+    std::string out;
+    registry.render(out);
+
+    const auto contains = [&](const char *text) { return out.find(text) != std::string::npos; };
+    TEST_ASSERT_TRUE(contains("# TYPE buff_test_total counter\nbuff_test_total 3\n"));
+    TEST_ASSERT_TRUE(contains("# TYPE buff_test_bytes gauge\nbuff_test_bytes -5\n"));
+    TEST_ASSERT_TRUE(contains("buff_test_us{task=\"a\",quantile=\"0.99\"} 100\n"));
+    TEST_ASSERT_TRUE(contains("buff_test_us_count{task=\"b\"} 0\n"));
+    // one header for both, with both under it
+    TEST_ASSERT_EQUAL(out.find("# TYPE buff_test_us summary"), out.rfind("# TYPE buff_test_us summary"));
+    TEST_ASSERT_TRUE(out.find("buff_test_us_count{task=\"b\"}") < out.find("# TYPE buff_other_us"));
+}
+
+void testLoopProfilerNamesCulprit() {
+    metrics::Registry registry;
+    metrics::LoopProfiler profiler("network", 10000, registry);
+    const auto ntp = profiler.addSection("ntp");
+    const auto mqtt = profiler.addSection("mqtt");
+
+    profiler.beginIteration(0);
+    profiler.recordSection(ntp, 0, 100);
+    profiler.recordSection(mqtt, 100, 300);
+    TEST_ASSERT_FALSE(profiler.endIteration(300));
+    TEST_ASSERT_NULL(profiler.culprit());
+
+    // ntp blocks on a round trip
+    profiler.beginIteration(1000);
+    profiler.recordSection(ntp, 1000, 51000);
+    profiler.recordSection(mqtt, 51000, 51200);
+    TEST_ASSERT_TRUE(profiler.endIteration(51200));
+    TEST_ASSERT_EQUAL(50200, profiler.lastIterationUS());
+    TEST_ASSERT_EQUAL_STRING("ntp", profiler.culprit()->name);
+    TEST_ASSERT_EQUAL(50000, profiler.culprit()->lastUS);
+
+    TEST_ASSERT_EQUAL(50000, profiler.section(ntp).latency->maxUS());
+    TEST_ASSERT_EQUAL(2, profiler.section(mqtt).latency->count());
+
+    std::string out;
+    registry.render(out);
+    TEST_ASSERT_TRUE(out.find("buff_loop_slow_iterations_total{loop=\"network\"} 1\n") != std::string::npos);
+    TEST_ASSERT_TRUE(out.find("buff_loop_section_duration_us{loop=\"network\",section=\"ntp\",quantile=\"1\"} 50000\n") != std::string::npos);
+}
+
+void testRegistryOverflow() {
+    metrics::Registry registry;
+    for (size_t i = 0; i < metrics::MAX_COUNTERS; i++) {
+        registry.counter("buff_test_total", "A counter");
+    }
+    auto &overflow = registry.counter("buff_overflow_total", "Doesn't fit");
+    overflow.inc();
+
+    std::string out;
+    registry.render(out);
+    TEST_ASSERT_EQUAL(std::string::npos, out.find("buff_overflow_total"));
+}
+
+}  // namespace test_metrics
+
+void runMetricsTests() {
+    RUN_TEST(test_metrics::testCountersFromManyThreads);
+    RUN_TEST(test_metrics::testLatencyPercentiles);
+    RUN_TEST(test_metrics::testLatencyWindowForgetsOldSamples);
+    RUN_TEST(test_metrics::testRender);
+    RUN_TEST(test_metrics::testRegistryOverflow);
+    RUN_TEST(test_metrics::testLoopProfilerNamesCulprit);
+}
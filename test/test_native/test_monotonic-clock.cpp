@@ -0,0 +1,113 @@
+#include <unity.h>
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "buff_time/monotonic-clock.h"
+#include "buff_time/time-common.h"
+#include "ph-mock.h"
+#include "readings/alk-measure.h"
+#include "sensors/sensor-registry.h"
+#include "web-server-renderers.h"
+
+namespace test_monotonic_clock {
+using namespace buff;
+
+// where a 32-bit millis() goes back to 0, ~49.7 days after boot
+const uint64_t WRAP_MS = 1ULL << 32;
+
+// stands in for esp_timer, fast-forwarded by the test
+class FakeClock : public buff_time::TimeWrapper {
+   public:
+    uint64_t nowMS;
+
+    FakeClock(const uint64_t startMS) : nowMS(startMS) {}
+
+    unsigned long getAdjustedTimeSeconds() override { return nowMS / 1000; }
+    uint64_t getMonotonicMS() override { return nowMS; }
+};
+
+void testMillisExtenderCrossesWrap() {
+    buff_time::MillisExtender extender;
+    TEST_ASSERT_TRUE(extender.extend(0xFFFFFF00) == 0xFFFFFF00);
+    TEST_ASSERT_TRUE(extender.extend(0xFFFFFFFF) == 0xFFFFFFFF);
+    TEST_ASSERT_TRUE(extender.extend(5) == WRAP_MS + 5);
+    TEST_ASSERT_TRUE(extender.extend(1000) == WRAP_MS + 1000);
+    // and the next one
+    TEST_ASSERT_TRUE(extender.extend(3) == 2 * WRAP_MS + 3);
+}
+
+void testPHReaderAcrossWrap() {
+    auto vals = std::vector<float>(10, 7.0);
+    auto reader = buildPHReader(vals);
+    ph::controller::PHReadingStats<4> stats;
+    FakeClock clock(WRAP_MS - 1500);
+
+    unsigned int reads = 0;
+    // 1s interval, so one read per second of fast-forwarding either side of the wrap
+    for (int i = 0; i < 40; i++) {
+        if (reader->readNewPHSignalIfTimeAndUpdate(stats, clock.getMonotonicMS()) != nullptr) {
+            reads++;
+            TEST_ASSERT_TRUE(stats.mostRecentReading().asOfMS == clock.nowMS);
+        }
+        clock.nowMS += 100;
+    }
+    TEST_ASSERT_EQUAL(4, reads);
+}
+
+void testStepSchedulerAcrossWrap() {
+    FakeClock clock(WRAP_MS - 2500);
+    alk_measure::MeasurementStepResult<4> step;
+    step.setTime(clock.getMonotonicMS(), clock.getAdjustedTimeSeconds());
+
+    unsigned int steps = 0;
+    for (int i = 0; i < 100; i++) {
+        clock.nowMS += 100;
+        if (step.nextStepDue(clock.getMonotonicMS(), 1000)) {
+            steps++;
+            step.setTime(clock.getMonotonicMS(), clock.getAdjustedTimeSeconds());
+        }
+    }
+    // neither stalled (asOf + interval wrapping past now) nor run every loop
+    TEST_ASSERT_EQUAL(10, steps);
+    TEST_ASSERT_TRUE(step.asOfMS > WRAP_MS);
+}
+
+void testSensorRegistryAcrossWrap() {
+    sensors::SensorRegistry registry;
+    unsigned int reads = 0;
+    registry.add(std::make_shared<sensors::FunctionSensor>(sensors::PH, "ph", [&]() {
+                     reads++;
+                     return 7.0f;
+                 }),
+                 1000);
+
+    uint64_t nowMS = WRAP_MS - 1500;
+    for (int i = 0; i < 30; i++) {
+        registry.loop(nowMS);
+        nowMS += 100;
+    }
+    TEST_ASSERT_EQUAL(3, reads);
+}
+
+void testUptimeRendersPastWrap() {
+    auto readings = std::vector<std::reference_wrapper<alk_measure::PersistedAlkReading>>();
+    std::set<std::string> recentTitles;
+    ph::PHReading phReading;
+    std::string out;
+    // 2^32ms is 1193:02:47
+    web_server::renderRoot(out, 0, web_server::TriggerVal::NA, 1111, WRAP_MS + 3600 * 1000, readings, recentTitles, phReading);
+    TEST_ASSERT_TRUE(out.find("Uptime: 1194:02:47") != std::string::npos);
+}
+
+}  // namespace test_monotonic_clock
+
+void runMonotonicClockTests() {
+    RUN_TEST(test_monotonic_clock::testMillisExtenderCrossesWrap);
+    RUN_TEST(test_monotonic_clock::testPHReaderAcrossWrap);
+    RUN_TEST(test_monotonic_clock::testStepSchedulerAcrossWrap);
+    RUN_TEST(test_monotonic_clock::testSensorRegistryAcrossWrap);
+    RUN_TEST(test_monotonic_clock::testUptimeRendersPastWrap);
+}
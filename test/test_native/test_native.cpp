@@ -2,6 +2,20 @@ extern void runPHTests();
 extern void runAlkMeasureTests();
 extern void runNumericTests();
 extern void runWebServerTests();
+extern void runStreamingFilterTests();
+extern void runSensorRegistryTests();
+extern void runRingTests();
+extern void runDoseExecutorTests();
+extern void runMetricsTests();
+extern void runSNTPClientTests();
+extern void runMonotonicClockTests();
+extern void runDeadlineSchedulerTests();
+extern void runIdlePowerTests();
+extern void runReadingListPoolTests();
+extern void runDisplayCacheTests();
+extern void runI2CBusTests();
+extern void runReadingSeriesTests();
+extern void runTouchSamplerTests();
 
 #include <unity.h>
 
@@ -20,5 +34,19 @@ int main(int argc, char **argv) {
     runNumericTests();
     runAlkMeasureTests();
     runWebServerTests();
+    runStreamingFilterTests();
+    runSensorRegistryTests();
+    runRingTests();
+    runDoseExecutorTests();
+    runMetricsTests();
+    runSNTPClientTests();
+    runMonotonicClockTests();
+    runDeadlineSchedulerTests();
+    runIdlePowerTests();
+    runReadingListPoolTests();
+    runDisplayCacheTests();
+    runI2CBusTests();
+    runReadingSeriesTests();
+    runTouchSamplerTests();
     return UNITY_END();
 }
@@ -34,9 +34,171 @@ void testPHCalibration() {
     TEST_ASSERT_EQUAL_FLOAT(7.0, signal.calibratedPH);
 }
 
+void testFixedPointWindowStats() {
+    stats::FixedPointWindow<4, 10000> window;
+    TEST_ASSERT_EQUAL(0, window.size());
+    TEST_ASSERT_EQUAL_FLOAT(0, window.mean());
+
+    for (auto v : {8.0, 8.1, 8.2, 8.3}) {
+        window.add(v);
+    }
+    TEST_ASSERT_TRUE(window.full());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 8.15, window.mean());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 8.0, window.min());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 8.3, window.max());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 0.0125, window.variance());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 0.1, window.slope());
+
+    // oldest samples drop out of every stat
+    window.add(7.9);
+    window.add(7.5);
+    TEST_ASSERT_EQUAL(4, window.size());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 7.975, window.mean());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 7.5, window.min());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 8.3, window.max());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 7.5, window.last());
+    // least squares over 8.2, 8.3, 7.9, 7.5
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, -0.25, window.slope());
+
+    window.add(7.4);
+    window.add(7.3);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 7.9, window.max());
+
+    window.reset();
+    TEST_ASSERT_EQUAL(0, window.size());
+}
+
+void testPHReadingStatsDerivesCalibrated() {
+    ph::PHCalibrator::CalibrationPoint highPoint = {.actualPH = 7.0, .readPH = 14.0};
+    ph::PHCalibrator::CalibrationPoint lowPoint = {.actualPH = 4.0, .readPH = 4.0};
+    ph::PHCalibrator calib(lowPoint, highPoint);
+
+    auto x = std::vector<float>({14.0, 12.0, 10.0});
+    auto reader = *buildPHReader(x, calib);
+
+    ph::controller::PHReadingStats<2> stats;
+    reader.readNewPHSignalWithStats(stats, 1000);
+    TEST_ASSERT_FALSE(stats.receivedMinReadings());
+    reader.readNewPHSignalWithStats(stats, 2000);
+    auto reading = reader.readNewPHSignalWithStats(stats, 3000);
+
+    TEST_ASSERT_TRUE(stats.receivedMinReadings());
+    TEST_ASSERT_EQUAL_FLOAT(10.0, reading.rawPH);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 11.0, reading.rawPH_mavg);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, calib.convert(11.0), reading.calibratedPH_mavg);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, -2.0 * 0.3, stats.calibratedPHSlope(calib));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 1.0 * 0.3 * 0.3, stats.calibratedPHVariance(calib));
+}
+
+void testMultiPointCalibration() {
+    // probe reads high near the endpoint, a 4/7 line would be off there
+    ph::PHCalibrator calib({{.actualPH = 7.0, .readPH = 7.2}, {.actualPH = 4.0, .readPH = 5.0}, {.actualPH = 4.5, .readPH = 5.5}});
+
+    TEST_ASSERT_EQUAL(3, calib.points().size());
+    TEST_ASSERT_EQUAL_FLOAT(4.0, calib.convert(5.0));
+    TEST_ASSERT_EQUAL_FLOAT(4.5, calib.convert(5.5));
+    TEST_ASSERT_EQUAL_FLOAT(7.0, calib.convert(7.2));
+
+    // within segments
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 4.25, calib.convert(5.25));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 5.75, calib.convert(6.35));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 1.0, calib.gainAt(5.2));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 2.5 / 1.7, calib.gainAt(6.0));
+
+    // extrapolates off the outer segments
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 3.0, calib.convert(4.0));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 7.0 + 2.5 / 1.7, calib.convert(8.2));
+}
+
+void testCalibrationWithPoint() {
+    ph::PHCalibrator calib({.actualPH = 4.0, .readPH = 4.0}, {.actualPH = 7.0, .readPH = 7.0});
+
+    // re-calibrating a buffer replaces its point
+    auto recalibrated = calib.withPoint({.actualPH = 4.0, .readPH = 4.2});
+    TEST_ASSERT_EQUAL(2, recalibrated.points().size());
+    TEST_ASSERT_EQUAL_FLOAT(4.0, recalibrated.convert(4.2));
+
+    auto added = recalibrated.withPoint({.actualPH = 10.0, .readPH = 9.8});
+    TEST_ASSERT_EQUAL(3, added.points().size());
+    TEST_ASSERT_EQUAL_FLOAT(10.0, added.convert(9.8));
+
+    // a single point only corrects the offset
+    ph::PHCalibrator offsetOnly(std::vector<ph::PHCalibrator::CalibrationPoint>({{.actualPH = 7.0, .readPH = 7.1}}));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 3.9, offsetOnly.convert(4.0));
+}
+
+void testCalibrationSameReadingKeepsLatest() {
+    ph::PHCalibrator calib({.actualPH = 4.0, .readPH = 4.0}, {.actualPH = 7.0, .readPH = 7.0});
+
+    // a different buffer that happens to read the same as the 7, the new one wins
+    auto recalibrated = calib.withPoint({.actualPH = 10.0, .readPH = 7.0});
+    TEST_ASSERT_EQUAL(2, recalibrated.points().size());
+    TEST_ASSERT_EQUAL_FLOAT(10.0, recalibrated.convert(7.0));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 2.0, recalibrated.gainAt(5.5));
+
+    // and again, whichever's latest
+    auto again = recalibrated.withPoint({.actualPH = 9.0, .readPH = 7.0});
+    TEST_ASSERT_EQUAL(2, again.points().size());
+    TEST_ASSERT_EQUAL_FLOAT(9.0, again.convert(7.0));
+}
+
+void testTemperatureCompensation() {
+    ph::PHCalibrator calib({.actualPH = 4.0, .readPH = 4.0}, {.actualPH = 7.0, .readPH = 7.0}, 25.0);
+
+    TEST_ASSERT_EQUAL_FLOAT(4.0, calib.convert(4.0, NAN));
+    TEST_ASSERT_EQUAL_FLOAT(4.0, calib.convert(4.0, 25.0));
+    // pH 7 is the pivot
+    TEST_ASSERT_EQUAL_FLOAT(7.0, calib.convert(7.0, 15.0));
+    // colder electrode gives a smaller swing away from 7
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 7.0 - 3.0 * 298.15 / 288.15, calib.convert(4.0, 15.0));
+
+    auto x = std::vector<float>({4.0});
+    ph::PHReadConfig config = {.readIntervalMS = 1000, .phReadFunc = callable_iter(x), .temperatureReadFunc = []() { return 15.0f; }};
+    ph::controller::PHReader reader(config, calib);
+    auto reading = reader.readNewPHSignal(1000);
+    TEST_ASSERT_EQUAL_FLOAT(15.0, reading.temperatureC);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 7.0 - 3.0 * 298.15 / 288.15, reading.calibratedPH);
+}
+
+void testPHReadingStatsCompensateGain() {
+    ph::PHCalibrator calib({.actualPH = 4.0, .readPH = 4.0}, {.actualPH = 7.0, .readPH = 7.0}, 25.0);
+    const float compensation = 298.15 / 288.15;
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, compensation, calib.gainAt(5.0, 15.0));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 1.0, calib.gainAt(5.0, NAN));
+
+    auto x = std::vector<float>({6.0, 5.0});
+    ph::PHReadConfig config = {.readIntervalMS = 1000, .phReadFunc = callable_iter(x), .temperatureReadFunc = []() { return 15.0f; }};
+    ph::controller::PHReader reader(config, calib);
+    ph::controller::PHReadingStats<2> stats;
+    reader.readNewPHSignalWithStats(stats, 1000);
+    auto reading = reader.readNewPHSignalWithStats(stats, 2000);
+
+    // same scaling as the calibrated moving average got
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, calib.convert(6.0, 15.0) - calib.convert(5.0, 15.0), -stats.calibratedPHSlope(calib));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, calib.convert(5.5, 15.0), reading.calibratedPH_mavg);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, stats.rawPHStats().variance() * compensation * compensation, stats.calibratedPHVariance(calib));
+}
+
+void testReaderCalibrationUpdate() {
+    auto x = std::vector<float>({5.0, 5.0});
+    auto reader = *buildPHReader(x);
+    TEST_ASSERT_EQUAL_FLOAT(5.0, reader.readNewPHSignal(1000).calibratedPH);
+
+    reader.updateCalibrator(ph::PHCalibrator({.actualPH = 4.0, .readPH = 5.0}, {.actualPH = 7.0, .readPH = 8.0}));
+    TEST_ASSERT_EQUAL_FLOAT(4.0, reader.readNewPHSignal(2000).calibratedPH);
+}
+
 }  // namespace test_ph
 
 void runPHTests() {
     RUN_TEST(test_ph::testPHReaderHelper);
     RUN_TEST(test_ph::testPHCalibration);
+    RUN_TEST(test_ph::testFixedPointWindowStats);
+    RUN_TEST(test_ph::testPHReadingStatsDerivesCalibrated);
+    RUN_TEST(test_ph::testMultiPointCalibration);
+    RUN_TEST(test_ph::testCalibrationWithPoint);
+    RUN_TEST(test_ph::testCalibrationSameReadingKeepsLatest);
+    RUN_TEST(test_ph::testTemperatureCompensation);
+    RUN_TEST(test_ph::testPHReadingStatsCompensateGain);
+    RUN_TEST(test_ph::testReaderCalibrationUpdate);
 }
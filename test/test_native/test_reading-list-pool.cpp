@@ -0,0 +1,127 @@
+#include <unity.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "buff-displays/reading-list-pool.h"
+
+namespace test_reading_list_pool {
+using namespace buff;
+
+// lays the slots out like a flex column would
+class RecordingRows : public monitoring_display::RowWidgets {
+   public:
+    std::vector<size_t> onScreen;
+    std::vector<std::string> text;
+    std::vector<bool> visible;
+    unsigned int textSets = 0;
+    unsigned int moves = 0;
+
+    RecordingRows(const size_t slots) : text(slots), visible(slots, false) {
+        for (size_t i = 0; i < slots; i++) {
+            onScreen.push_back(i);
+        }
+    }
+
+    void moveToTop(const size_t slot) override {
+        moves++;
+        onScreen.erase(std::find(onScreen.begin(), onScreen.end(), slot));
+        onScreen.insert(onScreen.begin(), slot);
+    }
+    void setText(const size_t slot, const std::string& newText) override {
+        textSets++;
+        text[slot] = newText;
+    }
+    void setVisible(const size_t slot, const bool isVisible) override {
+        visible[slot] = isVisible;
+    }
+
+    std::vector<std::string> shownRows() const {
+        std::vector<std::string> rows;
+        for (const auto slot : onScreen) {
+            if (visible[slot]) rows.push_back(text[slot]);
+        }
+        return rows;
+    }
+};
+
+void assertShows(const std::vector<std::string>& expected, const RecordingRows& rows) {
+    const auto shown = rows.shownRows();
+    TEST_ASSERT_EQUAL(expected.size(), shown.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_EQUAL_STRING(expected[i].c_str(), shown[i].c_str());
+    }
+}
+
+void testNewReadingOnlyTouchesOneRow() {
+    monitoring_display::ReadingListPool pool(3);
+    RecordingRows rows(3);
+
+    pool.update({"c", "b", "a"}, 3, 80, rows);
+    assertShows({"c", "b", "a"}, rows);
+    TEST_ASSERT_EQUAL(3, rows.textSets);
+
+    pool.update({"d", "c", "b"}, 4, 80, rows);
+    assertShows({"d", "c", "b"}, rows);
+    // the old bottom widget was recycled to the top, nothing else changed
+    TEST_ASSERT_EQUAL(4, rows.textSets);
+    TEST_ASSERT_EQUAL(1, rows.moves);
+
+    // unchanged, nothing to do
+    pool.update({"d", "c", "b"}, 4, 80, rows);
+    TEST_ASSERT_EQUAL(4, rows.textSets);
+    TEST_ASSERT_EQUAL(1, rows.moves);
+}
+
+void testTipIndexWrapsAround() {
+    monitoring_display::ReadingListPool pool(3);
+    RecordingRows rows(3);
+
+    pool.update({"c", "b", "a"}, 79, 80, rows);
+    pool.update({"e", "d", "c"}, 1, 80, rows);
+    assertShows({"e", "d", "c"}, rows);
+    TEST_ASSERT_EQUAL(5, rows.textSets);
+    TEST_ASSERT_EQUAL(2, rows.moves);
+}
+
+void testFewerReadingsThanRows() {
+    monitoring_display::ReadingListPool pool(3);
+    RecordingRows rows(3);
+
+    pool.update({"a"}, 1, 80, rows);
+    assertShows({"a"}, rows);
+
+    pool.update({"b", "a"}, 2, 80, rows);
+    assertShows({"b", "a"}, rows);
+    TEST_ASSERT_EQUAL(2, rows.textSets);
+}
+
+void testStoreReloadFallsBackToTextDiff() {
+    monitoring_display::ReadingListPool pool(3);
+    RecordingRows rows(3);
+
+    pool.update({"c", "b", "a"}, 3, 80, rows);
+    // the tip moved without new readings in front, eg the store was reloaded
+    pool.update({"z", "y", "x"}, 40, 80, rows);
+    assertShows({"z", "y", "x"}, rows);
+    TEST_ASSERT_EQUAL(0, rows.moves);
+}
+
+void testOptionsOnlyChangeOnce() {
+    monitoring_display::ChangedOptions options;
+    TEST_ASSERT_TRUE(options.update(""));
+    TEST_ASSERT_TRUE(options.update("a\nb"));
+    TEST_ASSERT_FALSE(options.update("a\nb"));
+    TEST_ASSERT_TRUE(options.update("a\nb\nc"));
+}
+
+}  // namespace test_reading_list_pool
+
+void runReadingListPoolTests() {
+    RUN_TEST(test_reading_list_pool::testNewReadingOnlyTouchesOneRow);
+    RUN_TEST(test_reading_list_pool::testTipIndexWrapsAround);
+    RUN_TEST(test_reading_list_pool::testFewerReadingsThanRows);
+    RUN_TEST(test_reading_list_pool::testStoreReloadFallsBackToTextDiff);
+    RUN_TEST(test_reading_list_pool::testOptionsOnlyChangeOnce);
+}
@@ -0,0 +1,94 @@
+#include <unity.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "readings/reading-series.h"
+
+namespace test_reading_series {
+using namespace buff;
+
+typedef std::vector<std::reference_wrapper<alk_measure::PersistedAlkReading>> Readings;
+
+void assertSeries(const std::vector<int16_t>& expected, const std::vector<int16_t>& actual) {
+    TEST_ASSERT_EQUAL(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_EQUAL(expected[i], actual[i]);
+    }
+}
+
+void testTitleSeriesIsOldestFirst() {
+    std::vector<alk_measure::PersistedAlkReading> store = {
+        {300, 8.2, "tank"},
+        {200, 7.0, "sump "},
+        {100, 8.0, "tank"},
+        // never written
+        {0, 0.0, ""}};
+    Readings newestFirst{store.begin(), store.end()};
+
+    assertSeries({800, 820}, reading_store::decimatedTitleSeries(newestFirst, "tank", 10));
+    // titles are trimmed, like the roller's
+    assertSeries({700}, reading_store::decimatedTitleSeries(newestFirst, "sump", 10));
+    assertSeries({}, reading_store::decimatedTitleSeries(newestFirst, "", 10));
+}
+
+void testTitleSeriesIsDecimated() {
+    std::vector<alk_measure::PersistedAlkReading> store;
+    for (unsigned long i = 8; i > 0; i--) {
+        store.push_back({i * 100, (float)i, "tank"});
+    }
+    Readings newestFirst{store.begin(), store.end()};
+
+    // pairs averaged
+    assertSeries({150, 350, 550, 750}, reading_store::decimatedTitleSeries(newestFirst, "tank", 4));
+    assertSeries({250, 650}, reading_store::decimatedTitleSeries(newestFirst, "tank", 2));
+    // uneven buckets still cover every reading
+    assertSeries({150, 400, 700}, reading_store::decimatedTitleSeries(newestFirst, "tank", 3));
+}
+
+void testAppendedPoints() {
+    // still filling up
+    TEST_ASSERT_EQUAL(2, reading_store::appendedPoints({}, {1, 2}));
+    TEST_ASSERT_EQUAL(1, reading_store::appendedPoints({1, 2}, {1, 2, 3}));
+    TEST_ASSERT_EQUAL(0, reading_store::appendedPoints({1, 2, 3}, {1, 2, 3}));
+
+    // full, the oldest scrolled off
+    TEST_ASSERT_EQUAL(1, reading_store::appendedPoints({1, 2, 3}, {2, 3, 4}));
+    TEST_ASSERT_EQUAL(2, reading_store::appendedPoints({1, 2, 3}, {3, 4, 5}));
+
+    // changed underneath, redraw
+    TEST_ASSERT_EQUAL(-1, reading_store::appendedPoints({1, 2, 3}, {4, 5, 6}));
+    TEST_ASSERT_EQUAL(-1, reading_store::appendedPoints({1, 2, 3}, {1, 9}));
+}
+
+void testTitrationCurveRuns() {
+    reading_store::TitrationCurve curve(3);
+
+    TEST_ASSERT_TRUE(curve.add({1000, 0.5, 8.1}));
+    TEST_ASSERT_FALSE(curve.add({1000, 1.0, 7.2}));
+    TEST_ASSERT_EQUAL(2, curve.points().size());
+    TEST_ASSERT_EQUAL(100, curve.points()[1].reagentML);
+    TEST_ASSERT_EQUAL(720, curve.points()[1].pH);
+
+    // only the last 3 are kept
+    curve.add({1000, 1.5, 6.0});
+    curve.add({1000, 2.25, 4.4});
+    TEST_ASSERT_EQUAL(3, curve.points().size());
+    TEST_ASSERT_EQUAL(100, curve.points()[0].reagentML);
+    TEST_ASSERT_EQUAL(225, curve.maxReagentML());
+
+    // the next measurement starts over
+    TEST_ASSERT_TRUE(curve.add({9000, 0.5, 8.3}));
+    TEST_ASSERT_EQUAL(1, curve.points().size());
+    TEST_ASSERT_EQUAL(50, curve.maxReagentML());
+}
+
+}  // namespace test_reading_series
+
+void runReadingSeriesTests() {
+    RUN_TEST(test_reading_series::testTitleSeriesIsOldestFirst);
+    RUN_TEST(test_reading_series::testTitleSeriesIsDecimated);
+    RUN_TEST(test_reading_series::testAppendedPoints);
+    RUN_TEST(test_reading_series::testTitrationCurveRuns);
+}
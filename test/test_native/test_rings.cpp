@@ -0,0 +1,210 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "concurrency/rings.h"
+
+namespace test_rings {
+using namespace buff;
+
+struct Item {
+    int producer;
+    int sequence;
+};
+
+void testSPSCFullAndEmpty() {
+    concurrency::SPSCRing<int, 4> ring;
+    int value = -1;
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_FALSE(ring.tryPop(value));
+
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(ring.tryPush(i));
+    }
+    TEST_ASSERT_FALSE(ring.tryPush(4));
+    TEST_ASSERT_EQUAL(4, ring.size());
+
+    // keep going round so the indexes wrap the buffer a few times
+    for (int i = 0; i < 20; i++) {
+        TEST_ASSERT_TRUE(ring.tryPop(value));
+        TEST_ASSERT_EQUAL(i, value);
+        TEST_ASSERT_TRUE(ring.tryPush(i + 4));
+    }
+    TEST_ASSERT_EQUAL(4, ring.size());
+}
+
+void testMPSCFullAndEmpty() {
+    concurrency::MPSCRing<int, 4> ring;
+    int value = -1;
+    TEST_ASSERT_FALSE(ring.tryPop(value));
+
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(ring.tryPush(i));
+    }
+    TEST_ASSERT_FALSE(ring.tryPush(4));
+
+    for (int i = 0; i < 20; i++) {
+        TEST_ASSERT_TRUE(ring.tryPop(value));
+        TEST_ASSERT_EQUAL(i, value);
+        TEST_ASSERT_TRUE(ring.tryPush(i + 4));
+    }
+    for (int i = 20; i < 24; i++) {
+        TEST_ASSERT_TRUE(ring.tryPop(value));
+        TEST_ASSERT_EQUAL(i, value);
+    }
+    TEST_ASSERT_FALSE(ring.tryPop(value));
+}
+
+void testSPSCAcrossThreads() {
+    const int COUNT = 100000;
+    concurrency::SPSCRing<int, 64> ring;
+
+    std::thread producer([&ring]() {
+        for (int i = 0; i < COUNT; i++) {
+            while (!ring.tryPush(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int expected = 0;
+    bool inOrder = true;
+    int value;
+    while (expected < COUNT) {
+        if (ring.tryPop(value)) {
+            inOrder = inOrder && value == expected;
+            expected++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    TEST_ASSERT_TRUE(inOrder);
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+void testMPSCAcrossThreads() {
+    const int PRODUCERS = 4;
+    const int COUNT = 25000;
+    concurrency::MPSCRing<Item, 64> ring;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; p++) {
+        producers.emplace_back([&ring, p]() {
+            for (int i = 0; i < COUNT; i++) {
+                while (!ring.tryPush({p, i})) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // each producer's items come out in the order it pushed them
+    std::vector<int> nextSequence(PRODUCERS, 0);
+    bool inOrder = true;
+    int received = 0;
+    Item item;
+    while (received < PRODUCERS * COUNT) {
+        if (ring.tryPop(item)) {
+            inOrder = inOrder && item.sequence == nextSequence[item.producer];
+            nextSequence[item.producer]++;
+            received++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    for (auto &producer : producers) {
+        producer.join();
+    }
+
+    TEST_ASSERT_TRUE(inOrder);
+    for (int p = 0; p < PRODUCERS; p++) {
+        TEST_ASSERT_EQUAL(COUNT, nextSequence[p]);
+    }
+    TEST_ASSERT_FALSE(ring.tryPop(item));
+}
+
+/************
+ * Handoff benchmark against a locked std::queue, reported rather than asserted
+ ***********/
+class LockedQueue {
+   private:
+    std::mutex _mutex;
+    std::queue<int> _queue;
+
+   public:
+    bool tryPush(const int &item) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_queue.size() >= 64) {
+            return false;
+        }
+        _queue.push(item);
+        return true;
+    }
+
+    bool tryPop(int &item) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_queue.empty()) {
+            return false;
+        }
+        item = _queue.front();
+        _queue.pop();
+        return true;
+    }
+};
+
+template <typename Queue>
+void benchmark(const char *name, Queue &queue) {
+    const int COUNT = 200000;
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread producer([&queue]() {
+        for (int i = 0; i < COUNT; i++) {
+            while (!queue.tryPush(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    long long sink = 0;
+    int value;
+    for (int received = 0; received < COUNT;) {
+        if (queue.tryPop(value)) {
+            sink += value;
+            received++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%s: %.1f ns/item (%lld)", name, (double)elapsed / COUNT, sink);
+    TEST_MESSAGE(msg);
+}
+
+void benchmarkHandoff() {
+    concurrency::SPSCRing<int, 64> spsc;
+    concurrency::MPSCRing<int, 64> mpsc;
+    LockedQueue locked;
+
+    benchmark("spsc ring<64>", spsc);
+    benchmark("mpsc ring<64>", mpsc);
+    benchmark("mutex + std::queue", locked);
+}
+
+}  // namespace test_rings
+
+void runRingTests() {
+    RUN_TEST(test_rings::testSPSCFullAndEmpty);
+    RUN_TEST(test_rings::testMPSCFullAndEmpty);
+    RUN_TEST(test_rings::testSPSCAcrossThreads);
+    RUN_TEST(test_rings::testMPSCAcrossThreads);
+    RUN_TEST(test_rings::benchmarkHandoff);
+}
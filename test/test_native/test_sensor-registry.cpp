@@ -0,0 +1,170 @@
+#include <unity.h>
+
+#include <memory>
+#include <vector>
+
+#include "sensors/sensor-registry.h"
+
+namespace test_sensor_registry {
+using namespace buff;
+
+// takes delayMS between beginRead and the value being ready
+class FakeBusSensor : public sensors::Sensor {
+   private:
+    const unsigned long _delayMS;
+    unsigned long _startedAtMS = 0;
+
+   protected:
+    bool startRead(const unsigned long nowMS) override {
+        _startedAtMS = nowMS;
+        starts.push_back(nowMS);
+        return true;
+    }
+
+    sensors::ReadStatus continueRead(const unsigned long nowMS, float &value) override {
+        if (nowMS - _startedAtMS < _delayMS) {
+            return sensors::READ_IN_PROGRESS;
+        }
+        if (failNext) {
+            failNext = false;
+            return sensors::READ_FAILED;
+        }
+        value = nextValue;
+        return sensors::READ_DONE;
+    }
+
+   public:
+    FakeBusSensor(sensors::SensorKind kind, const std::string &name, unsigned long delayMS) : Sensor(kind, name), _delayMS(delayMS) {}
+
+    std::vector<unsigned long> starts;
+    float nextValue = 0;
+    bool failNext = false;
+};
+
+void testBusReadsNeverOverlap() {
+    auto ph = std::make_shared<FakeBusSensor>(sensors::PH, "ph", 20);
+    auto conductivity = std::make_shared<FakeBusSensor>(sensors::CONDUCTIVITY_US, "cond", 20);
+
+    sensors::SensorRegistry registry;
+    registry.add(ph, 100);
+    registry.add(conductivity, 100);
+
+    // both due, only one gets the bus
+    registry.loop(0);
+    TEST_ASSERT_EQUAL(1, ph->starts.size());
+    TEST_ASSERT_EQUAL(0, conductivity->starts.size());
+    TEST_ASSERT_TRUE(registry.busInFlight());
+
+    registry.loop(10);
+    TEST_ASSERT_EQUAL(0, conductivity->starts.size());
+
+    // ph finishes, conductivity starts on the same pass
+    ph->nextValue = 8.1;
+    registry.loop(20);
+    TEST_ASSERT_TRUE(ph->hasReading());
+    TEST_ASSERT_EQUAL_FLOAT(8.1, ph->lastValue());
+    TEST_ASSERT_EQUAL(20, ph->stats().lastLatencyMS);
+    TEST_ASSERT_EQUAL(1, conductivity->starts.size());
+    TEST_ASSERT_EQUAL(20, conductivity->starts[0]);
+
+    registry.loop(40);
+    TEST_ASSERT_TRUE(conductivity->hasReading());
+    TEST_ASSERT_FALSE(registry.busInFlight());
+
+    // next ph read is due on its own cadence
+    registry.loop(99);
+    TEST_ASSERT_EQUAL(1, ph->starts.size());
+    registry.loop(100);
+    TEST_ASSERT_EQUAL(2, ph->starts.size());
+}
+
+void testMostOverdueGoesFirst() {
+    auto fast = std::make_shared<FakeBusSensor>(sensors::PH, "fast", 0);
+    auto slow = std::make_shared<FakeBusSensor>(sensors::TEMPERATURE_C, "slow", 50);
+
+    sensors::SensorRegistry registry;
+    registry.add(slow, 1000);
+    registry.add(fast, 10);
+
+    registry.loop(0);
+    TEST_ASSERT_EQUAL(1, slow->starts.size());
+    // fast is starved while slow holds the bus
+    registry.loop(30);
+    TEST_ASSERT_EQUAL(0, fast->starts.size());
+
+    registry.loop(50);
+    TEST_ASSERT_EQUAL(1, fast->starts.size());
+    TEST_ASSERT_EQUAL(1, slow->starts.size());
+}
+
+void testFailedReadsKeepLastValue() {
+    auto ph = std::make_shared<FakeBusSensor>(sensors::PH, "ph", 0);
+    sensors::SensorRegistry registry;
+    registry.add(ph, 100);
+
+    ph->nextValue = 8.0;
+    registry.loop(0);
+    registry.loop(1);
+    TEST_ASSERT_EQUAL_FLOAT(8.0, ph->lastValue());
+
+    ph->failNext = true;
+    ph->nextValue = 9.0;
+    registry.loop(100);
+    registry.loop(101);
+    TEST_ASSERT_EQUAL_FLOAT(8.0, ph->lastValue());
+    TEST_ASSERT_EQUAL(1, ph->stats().errorCount);
+    TEST_ASSERT_EQUAL(1, ph->stats().readCount);
+
+    auto phFunc = registry.latestValueFunc(sensors::PH);
+    TEST_ASSERT_EQUAL_FLOAT(8.0, phFunc());
+    TEST_ASSERT_TRUE(registry.latestValueFunc(sensors::TEMPERATURE_C) == nullptr);
+}
+
+void testOffBusSensorsReadInline() {
+    float temp = 25.5;
+    auto tempSensor = std::make_shared<sensors::FunctionSensor>(sensors::TEMPERATURE_C, "temp", [&temp]() { return temp; });
+    auto ph = std::make_shared<FakeBusSensor>(sensors::PH, "ph", 20);
+
+    sensors::SensorRegistry registry;
+    registry.add(ph, 100);
+    registry.add(tempSensor, 100);
+
+    registry.loop(0);
+    TEST_ASSERT_TRUE(registry.busInFlight());
+    TEST_ASSERT_TRUE(registry.hasReading(sensors::TEMPERATURE_C));
+    TEST_ASSERT_EQUAL_FLOAT(25.5, registry.find("temp")->lastValue());
+}
+
+void testReadIntervalChangesFromLastRead() {
+    auto ph = std::make_shared<FakeBusSensor>(sensors::PH, "ph", 0);
+    sensors::SensorRegistry registry;
+    registry.add(ph, 100);
+
+    registry.loop(0);
+    TEST_ASSERT_EQUAL(1, ph->starts.size());
+
+    // slowed down, the next read moves out
+    registry.setReadIntervalMS(sensors::PH, 1000);
+    TEST_ASSERT_EQUAL(1000, registry.readIntervalMS(sensors::PH));
+    registry.loop(100);
+    registry.loop(999);
+    TEST_ASSERT_EQUAL(1, ph->starts.size());
+    registry.loop(1000);
+    TEST_ASSERT_EQUAL(2, ph->starts.size());
+
+    // sped back up, a read that's now overdue happens on the next pass
+    registry.setReadIntervalMS(sensors::PH, 100);
+    registry.loop(1200);
+    TEST_ASSERT_EQUAL(3, ph->starts.size());
+    TEST_ASSERT_EQUAL(0, registry.readIntervalMS(sensors::TEMPERATURE_C));
+}
+
+}  // namespace test_sensor_registry
+
+void runSensorRegistryTests() {
+    RUN_TEST(test_sensor_registry::testBusReadsNeverOverlap);
+    RUN_TEST(test_sensor_registry::testMostOverdueGoesFirst);
+    RUN_TEST(test_sensor_registry::testFailedReadsKeepLastValue);
+    RUN_TEST(test_sensor_registry::testOffBusSensorsReadInline);
+    RUN_TEST(test_sensor_registry::testReadIntervalChangesFromLastRead);
+}
@@ -0,0 +1,183 @@
+#include <unity.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "buff_time/sntp-client.h"
+
+namespace test_sntp_client {
+using namespace buff;
+
+const uint64_t NTP_UNIX_OFFSET_SEC = buff_time::NTP_UNIX_OFFSET_SEC;
+
+/*******************************
+ * Stands in for the UDP socket & the server behind it: requests are
+ * answered with serverTimeMS once the test calls respond().
+ *******************************/
+class LocalServerTransport : public buff_time::SNTPTransport {
+   public:
+    bool online = true;
+    std::vector<std::vector<uint8_t>> requests;
+    std::deque<std::vector<uint8_t>> responses;
+
+    bool send(const uint8_t *packet, const size_t len) override {
+        if (!online) return false;
+        requests.emplace_back(packet, packet + len);
+        return true;
+    }
+
+    size_t receive(uint8_t *packet, const size_t maxLen) override {
+        if (responses.empty()) return 0;
+        auto response = responses.front();
+        responses.pop_front();
+        const size_t len = std::min(maxLen, response.size());
+        memcpy(packet, response.data(), len);
+        return len;
+    }
+
+    static void writeUint32(uint8_t *bytes, const uint32_t value) {
+        bytes[0] = value >> 24;
+        bytes[1] = value >> 16;
+        bytes[2] = value >> 8;
+        bytes[3] = value;
+    }
+
+    std::vector<uint8_t> buildResponse(const uint64_t serverTimeMS, const uint8_t firstByte = 0b00100100, const uint8_t stratum = 2) {
+        std::vector<uint8_t> response(buff_time::SNTP_PACKET_SIZE, 0);
+        response[0] = firstByte;
+        response[1] = stratum;
+        // originate = the request's transmit timestamp
+        memcpy(response.data() + 24, requests.back().data() + 40, 8);
+        writeUint32(response.data() + 40, serverTimeMS / 1000 + NTP_UNIX_OFFSET_SEC);
+        writeUint32(response.data() + 44, (uint32_t)(((serverTimeMS % 1000) << 32) / 1000));
+        return response;
+    }
+
+    void respond(const uint64_t serverTimeMS) {
+        responses.push_back(buildResponse(serverTimeMS));
+    }
+};
+
+const uint64_t SERVER_EPOCH_MS = 1700000000000ULL;
+
+buff_time::SNTPConfig testConfig() {
+    buff_time::SNTPConfig config;
+    config.syncIntervalMS = 60000;
+    config.retryIntervalMS = 1000;
+    config.responseTimeoutMS = 500;
+    config.driftSmoothing = 1.0;
+    return config;
+}
+
+void testSyncsWithoutBlocking() {
+    auto transport = std::make_shared<LocalServerTransport>();
+    buff_time::AsyncSNTPClock clock(transport, testConfig());
+
+    // boot time until synced
+    TEST_ASSERT_FALSE(clock.synced());
+    TEST_ASSERT_EQUAL(1234, clock.adjustedTimeMS(1234));
+
+    clock.loop(1000);
+    TEST_ASSERT_EQUAL(1, transport->requests.size());
+    TEST_ASSERT_EQUAL(0b00100011, transport->requests[0][0]);
+
+    // nothing back yet, loop keeps returning
+    clock.loop(1010);
+    TEST_ASSERT_FALSE(clock.synced());
+    TEST_ASSERT_EQUAL(1, transport->requests.size());
+
+    // server stamped its reply 20ms into a 40ms round trip
+    transport->respond(SERVER_EPOCH_MS + 20);
+    clock.loop(1040);
+    TEST_ASSERT_TRUE(clock.synced());
+    TEST_ASSERT_EQUAL(40, clock.lastRoundTripMS());
+    TEST_ASSERT_EQUAL(SERVER_EPOCH_MS + 40, clock.adjustedTimeMS(1040));
+    TEST_ASSERT_EQUAL(SERVER_EPOCH_MS + 5040, clock.adjustedTimeMS(6040));
+
+    // not due again until the sync interval is up
+    clock.loop(30000);
+    TEST_ASSERT_EQUAL(1, transport->requests.size());
+    clock.loop(61040);
+    TEST_ASSERT_EQUAL(2, transport->requests.size());
+}
+
+void testEstimatesDrift() {
+    auto transport = std::make_shared<LocalServerTransport>();
+    buff_time::AsyncSNTPClock clock(transport, testConfig());
+
+    clock.loop(0);
+    transport->respond(SERVER_EPOCH_MS);
+    clock.loop(0);
+
+    // millis() runs 1000ppm slow: 60.06s of wall time shows up as 60s
+    clock.loop(60000);
+    transport->respond(SERVER_EPOCH_MS + 60060);
+    clock.loop(60000);
+    TEST_ASSERT_EQUAL(2, clock.syncCount());
+    TEST_ASSERT_FLOAT_WITHIN(1, 1000, clock.driftPPM());
+
+    // and gets corrected for between syncs
+    TEST_ASSERT_INT_WITHIN(2, SERVER_EPOCH_MS + 120120, clock.adjustedTimeMS(120000));
+}
+
+void testTimesOutAndRetries() {
+    auto transport = std::make_shared<LocalServerTransport>();
+    buff_time::AsyncSNTPClock clock(transport, testConfig());
+
+    clock.loop(0);
+    clock.loop(499);
+    TEST_ASSERT_EQUAL(0, clock.failureCount());
+    clock.loop(500);
+    TEST_ASSERT_EQUAL(1, clock.failureCount());
+
+    // retried after retryIntervalMS
+    clock.loop(1000);
+    TEST_ASSERT_EQUAL(1, transport->requests.size());
+    clock.loop(1500);
+    TEST_ASSERT_EQUAL(2, transport->requests.size());
+
+    // network down, keeps trying without blocking
+    transport->online = false;
+    clock.loop(2000);
+    clock.loop(3000);
+    clock.loop(4000);
+    TEST_ASSERT_EQUAL(2, transport->requests.size());
+    transport->online = true;
+    clock.loop(5000);
+    TEST_ASSERT_EQUAL(3, transport->requests.size());
+}
+
+void testIgnoresBadResponses() {
+    auto transport = std::make_shared<LocalServerTransport>();
+    buff_time::AsyncSNTPClock clock(transport, testConfig());
+
+    clock.loop(0);
+    // too short
+    transport->responses.push_back(std::vector<uint8_t>(12, 0));
+    // kiss-o'-death
+    transport->responses.push_back(transport->buildResponse(SERVER_EPOCH_MS, 0b00100100, 0));
+    // unsynchronized server
+    transport->responses.push_back(transport->buildResponse(SERVER_EPOCH_MS, 0b11100100));
+    // reply to some other request
+    auto stale = transport->buildResponse(SERVER_EPOCH_MS);
+    stale[31] ^= 0xff;
+    transport->responses.push_back(stale);
+    clock.loop(10);
+    TEST_ASSERT_FALSE(clock.synced());
+
+    transport->respond(SERVER_EPOCH_MS);
+    clock.loop(20);
+    TEST_ASSERT_TRUE(clock.synced());
+}
+
+}  // namespace test_sntp_client
+
+void runSNTPClientTests() {
+    RUN_TEST(test_sntp_client::testSyncsWithoutBlocking);
+    RUN_TEST(test_sntp_client::testEstimatesDrift);
+    RUN_TEST(test_sntp_client::testTimesOutAndRetries);
+    RUN_TEST(test_sntp_client::testIgnoresBadResponses);
+}
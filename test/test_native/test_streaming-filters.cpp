@@ -0,0 +1,158 @@
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ph-controller.h"
+#include "ph-mock.h"
+#include "streaming-filters.h"
+
+namespace test_streaming_filters {
+using namespace buff;
+
+void testBoxcar() {
+    stats::BoxcarFilter<3> filter;
+    TEST_ASSERT_EQUAL_FLOAT(0, filter.get());
+    TEST_ASSERT_EQUAL_FLOAT(1, filter.add(1));
+    TEST_ASSERT_EQUAL_FLOAT(1.5, filter.add(2));
+    TEST_ASSERT_EQUAL_FLOAT(2, filter.add(3));
+    TEST_ASSERT_EQUAL_FLOAT(3, filter.add(4));
+    TEST_ASSERT_EQUAL(3, filter.size());
+}
+
+void testEMA() {
+    stats::EMAFilter<3> filter;
+    TEST_ASSERT_EQUAL_FLOAT(8, filter.add(8));
+    // alpha = 0.5
+    TEST_ASSERT_EQUAL_FLOAT(9, filter.add(10));
+    TEST_ASSERT_EQUAL_FLOAT(9.5, filter.add(10));
+
+    filter.reset();
+    TEST_ASSERT_EQUAL(0, filter.size());
+    TEST_ASSERT_EQUAL_FLOAT(4, filter.add(4));
+}
+
+void testMedianRejectsSpikes() {
+    stats::RollingMedianFilter<5> filter;
+    TEST_ASSERT_EQUAL_FLOAT(8.0, filter.add(8.0));
+    TEST_ASSERT_EQUAL_FLOAT(8.05, filter.add(8.1));
+    TEST_ASSERT_EQUAL_FLOAT(8.1, filter.add(8.2));
+
+    // a bubble
+    TEST_ASSERT_EQUAL_FLOAT(8.15, filter.add(12.0));
+    TEST_ASSERT_EQUAL_FLOAT(8.1, filter.add(8.1));
+    TEST_ASSERT_EQUAL_FLOAT(8.1, filter.add(8.0));
+    TEST_ASSERT_EQUAL(5, filter.size());
+}
+
+void testMedianMatchesSorted() {
+    const size_t N = 7;
+    stats::RollingMedianFilter<N> filter;
+    std::vector<float> window;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(4, 9);
+    std::vector<float> all;
+    for (int i = 0; i < 500; i++) {
+        // plenty of duplicates, to exercise ties between the heaps
+        all.push_back(round(dist(rng) * 4) / 4);
+    }
+
+    for (size_t i = 0; i < all.size(); i++) {
+        auto median = filter.add(all[i]);
+
+        window.assign(all.begin() + (i + 1 > N ? i + 1 - N : 0), all.begin() + i + 1);
+        std::sort(window.begin(), window.end());
+        auto mid = window.size() / 2;
+        auto expected = window.size() % 2 ? window[mid] : (window[mid - 1] + window[mid]) / 2;
+        TEST_ASSERT_EQUAL_FLOAT(expected, median);
+    }
+}
+
+void testKalmanConverges() {
+    stats::KalmanFilter1D filter(0.0001, 0.01);
+    std::mt19937 rng(7);
+    std::normal_distribution<float> noise(0, 0.1);
+
+    TEST_ASSERT_EQUAL_FLOAT(8.2, filter.add(8.2));
+    for (int i = 0; i < 200; i++) {
+        filter.add(8.0 + noise(rng));
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 8.0, filter.get());
+    TEST_ASSERT_TRUE(filter.errorCovariance() < 0.01);
+}
+
+void testPHReadingStatsPreFilter() {
+    auto x = std::vector<float>({8.0, 8.0, 12.0, 8.0});
+    auto reader = *buildPHReader(x);
+
+    ph::controller::PHReadingStats<4, stats::RollingMedianFilter<3>> phStats;
+    ph::PHReading reading;
+    for (int i = 0; i < 4; i++) {
+        reading = reader.readNewPHSignalWithStats(phStats, 1000 * i);
+    }
+
+    // the spike is still reported as the raw reading, but never enters the window
+    TEST_ASSERT_EQUAL_FLOAT(8.0, reading.rawPH);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 8.0, phStats.rawPHStats().max());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 8.0, reading.rawPH_mavg);
+}
+
+/************
+ * Microbenchmarks, reported rather than asserted
+ ***********/
+template <typename Filter>
+void benchmark(const char *name, Filter &filter, const std::vector<float> &samples) {
+    float sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto s : samples) {
+        sink += filter.add(s);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%s: %.1f ns/sample (%f)", name, (double)elapsed / samples.size(), sink / samples.size());
+    TEST_MESSAGE(msg);
+}
+
+void benchmarkFilters() {
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(8.0, 0.1);
+    std::vector<float> samples(200000);
+    for (auto &s : samples) s = noise(rng);
+
+    stats::BoxcarFilter<15> boxcar;
+    stats::EMAFilter<15> ema;
+    stats::RollingMedianFilter<15> median;
+    stats::RollingMedianFilter<255> wideMedian;
+    stats::KalmanFilter1D kalman;
+    stats::FixedPointWindow<15, 10000> window;
+
+    benchmark("boxcar<15>", boxcar, samples);
+    benchmark("ema<15>", ema, samples);
+    benchmark("median<15>", median, samples);
+    benchmark("median<255>", wideMedian, samples);
+    benchmark("kalman", kalman, samples);
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto s : samples) window.add(s);
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    char msg[96];
+    snprintf(msg, sizeof(msg), "fixed-point window<15>: %.1f ns/sample (%f)", (double)elapsed / samples.size(), window.slope());
+    TEST_MESSAGE(msg);
+}
+
+}  // namespace test_streaming_filters
+
+void runStreamingFilterTests() {
+    RUN_TEST(test_streaming_filters::testBoxcar);
+    RUN_TEST(test_streaming_filters::testEMA);
+    RUN_TEST(test_streaming_filters::testMedianRejectsSpikes);
+    RUN_TEST(test_streaming_filters::testMedianMatchesSorted);
+    RUN_TEST(test_streaming_filters::testKalmanConverges);
+    RUN_TEST(test_streaming_filters::testPHReadingStatsPreFilter);
+    RUN_TEST(test_streaming_filters::benchmarkFilters);
+}
@@ -0,0 +1,107 @@
+#include <unity.h>
+
+#include "buff-displays/touch-sampler.h"
+
+namespace test_touch_sampler {
+using namespace buff;
+
+// what the controller would say if it was read
+class FakePanel {
+   public:
+    bool pressed = false;
+    uint16_t x = 0;
+    uint16_t y = 0;
+    unsigned int reads = 0;
+
+    monitoring_display::TouchSampler::ReadFunc readFunc() {
+        return [this](uint16_t& readX, uint16_t& readY) {
+            reads++;
+            readX = x;
+            readY = y;
+            return pressed;
+        };
+    }
+};
+
+void testIdleWithIRQDoesNotRead() {
+    FakePanel panel;
+    monitoring_display::TouchSampler sampler;
+
+    // LVGL polling every 30ms for a minute
+    for (uint64_t nowMS = 0; nowMS < 60000; nowMS += 30) {
+        TEST_ASSERT_FALSE(sampler.sample(nowMS, false, panel.readFunc()).pressed);
+    }
+    TEST_ASSERT_EQUAL(0, panel.reads);
+}
+
+void testIdlePollingIsRateLimited() {
+    FakePanel panel;
+    monitoring_display::TouchSampler sampler;
+
+    for (uint64_t nowMS = 0; nowMS < 1000; nowMS += 30) {
+        sampler.sample(nowMS, true, panel.readFunc());
+    }
+    // every 100ms, not every 30
+    TEST_ASSERT_EQUAL(9, panel.reads);
+    TEST_ASSERT_EQUAL(9, sampler.reads());
+}
+
+void testPressIsDebounced() {
+    FakePanel panel;
+    monitoring_display::TouchSampler sampler;
+
+    // a single noisy read doesn't press anything
+    panel.pressed = true;
+    panel.x = 100;
+    panel.y = 200;
+    TEST_ASSERT_FALSE(sampler.sample(0, true, panel.readFunc()).pressed);
+    panel.pressed = false;
+    TEST_ASSERT_FALSE(sampler.sample(20, true, panel.readFunc()).pressed);
+
+    // a real one does, read at the faster pressed rate
+    panel.pressed = true;
+    sampler.sample(120, true, panel.readFunc());
+    panel.x = 110;
+    panel.y = 210;
+    const auto& touch = sampler.sample(140, true, panel.readFunc());
+    TEST_ASSERT_TRUE(touch.pressed);
+    // smoothed
+    TEST_ASSERT_EQUAL(105, touch.x);
+    TEST_ASSERT_EQUAL(205, touch.y);
+
+    // cached between reads
+    const unsigned int reads = panel.reads;
+    TEST_ASSERT_TRUE(sampler.sample(150, true, panel.readFunc()).pressed);
+    TEST_ASSERT_EQUAL(reads, panel.reads);
+}
+
+void testReleaseFromIRQ() {
+    FakePanel panel;
+    monitoring_display::TouchSampler sampler;
+
+    panel.pressed = true;
+    panel.x = 50;
+    panel.y = 60;
+    sampler.sample(0, true, panel.readFunc());
+    sampler.sample(20, true, panel.readFunc());
+    TEST_ASSERT_TRUE(sampler.current().pressed);
+
+    // the IRQ line goes up, released without reading
+    const unsigned int reads = panel.reads;
+    TEST_ASSERT_TRUE(sampler.sample(50, false, panel.readFunc()).pressed);
+    const auto& touch = sampler.sample(80, false, panel.readFunc());
+    TEST_ASSERT_FALSE(touch.pressed);
+    TEST_ASSERT_EQUAL(reads, panel.reads);
+    // LVGL gets the last position with the release
+    TEST_ASSERT_EQUAL(50, touch.x);
+    TEST_ASSERT_EQUAL(60, touch.y);
+}
+
+}  // namespace test_touch_sampler
+
+void runTouchSamplerTests() {
+    RUN_TEST(test_touch_sampler::testIdleWithIRQDoesNotRead);
+    RUN_TEST(test_touch_sampler::testIdlePollingIsRateLimited);
+    RUN_TEST(test_touch_sampler::testPressIsDebounced);
+    RUN_TEST(test_touch_sampler::testReleaseFromIRQ);
+}